@@ -1,10 +1,16 @@
 #**********************
 # Gather Sources
 #**********************
+set(SHARED_AUDIO_PIPELINE_DIR ${CMAKE_CURRENT_LIST_DIR}/../../shared/audio_pipeline)
+
 file(GLOB_RECURSE APP_SOURCES ${CMAKE_CURRENT_LIST_DIR}/src/*.c )
+list(APPEND APP_SOURCES
+    ${SHARED_AUDIO_PIPELINE_DIR}/gain_ramp.c
+)
 set(APP_INCLUDES
     ${CMAKE_CURRENT_LIST_DIR}/src
     ${CMAKE_CURRENT_LIST_DIR}/src/audio_pipeline
+    ${SHARED_AUDIO_PIPELINE_DIR}
     ${CMAKE_CURRENT_LIST_DIR}/src/platform
     ${CMAKE_CURRENT_LIST_DIR}/src/misc
     ${CMAKE_CURRENT_LIST_DIR}/src/demos
@@ -8,11 +8,13 @@
 #define appconfAUDIO_FRAME_LENGTH            	MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME
 #define appconfMIC_COUNT                        MIC_ARRAY_CONFIG_MIC_COUNT
 #define appconfFRAMES_IN_ALL_CHANS              (appconfAUDIO_FRAME_LENGTH * appconfMIC_COUNT)
+#define appconfI2S_CHANNELS                     2 /* Output channel c is mic (c % appconfMIC_COUNT) */
 #define appconfEXP                              -31
 #define appconfINITIAL_GAIN                     20
 #define appconfAUDIO_PIPELINE_MAX_GAIN          60
 #define appconfAUDIO_PIPELINE_MIN_GAIN          0
 #define appconfAUDIO_PIPELINE_GAIN_STEP         4
+#define appconfAUDIO_PIPELINE_GAIN_RAMP_SAMPLES 160
 #define appconfPOWER_THRESHOLD                  (float)0.00001
 #define appconfAUDIO_CLOCK_FREQUENCY            24576000
 #define appconfPDM_CLOCK_FREQUENCY              3072000
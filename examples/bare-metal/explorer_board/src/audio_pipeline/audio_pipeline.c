@@ -15,6 +15,7 @@
 /* App headers */
 #include "app_conf.h"
 #include "audio_pipeline.h"
+#include "gain_ramp.h"
 
 //#include <hwtimer.h>
 void ap_stage_a(chanend_t c_input, chanend_t c_output) {
@@ -40,12 +41,17 @@ void ap_stage_a(chanend_t c_input, chanend_t c_output) {
 void ap_stage_b(chanend_t c_input, chanend_t c_output, chanend_t c_from_gpio) {
     // initialise the array which will hold the data
     int32_t DWORD_ALIGNED output[appconfMIC_COUNT][appconfAUDIO_FRAME_LENGTH];
-    // initialise block floating point structures for both channels
-    bfp_s32_t ch0, ch1;
-    bfp_s32_init(&ch0, output[0], appconfEXP, appconfAUDIO_FRAME_LENGTH, 0);
-    bfp_s32_init(&ch1, output[1], appconfEXP, appconfAUDIO_FRAME_LENGTH, 0);
+    // initialise block floating point structures for every channel
+    bfp_s32_t ch[appconfMIC_COUNT];
+    for(int c = 0; c < appconfMIC_COUNT; c ++){
+        bfp_s32_init(&ch[c], output[c], appconfEXP, appconfAUDIO_FRAME_LENGTH, 0);
+    }
 
     int gain_db = appconfINITIAL_GAIN;
+    // the gain ramps to each new setting over several frames
+    gain_ramp_t gain;
+    int32_t DWORD_ALIGNED ramp_gains[appconfAUDIO_FRAME_LENGTH];
+    gain_ramp_init(&gain, ramp_gains, appconfAUDIO_FRAME_LENGTH, appconfAUDIO_PIPELINE_GAIN_RAMP_SAMPLES, gain_db);
 
     triggerable_disable_all();
     // initialise events
@@ -64,18 +70,16 @@ void ap_stage_b(chanend_t c_input, chanend_t c_output, chanend_t c_from_gpio) {
                 // recieve frame over the channel
                 s_chan_in_buf_word(c_input, (uint32_t*) output, appconfFRAMES_IN_ALL_CHANS);
                 // calculate the headroom of the new frames
-                bfp_s32_headroom(&ch0);
-                bfp_s32_headroom(&ch1);
-                // update the gain
-                float power = (float)gain_db / 20.0;
-                float gain_fl = powf(10.0, power);
-                float_s32_t gain = f32_to_float_s32(gain_fl);
-                // scale both channels 
-                bfp_s32_scale(&ch0, &ch0, gain);
-                bfp_s32_scale(&ch1, &ch1, gain);
+                for(int c = 0; c < appconfMIC_COUNT; c ++){
+                    bfp_s32_headroom(&ch[c]);
+                }
+                // ramp to the gain if it has changed, and scale every channel
+                gain_ramp_set_db(&gain, gain_db);
+                gain_ramp_apply(&gain, ch, appconfMIC_COUNT);
                 // normalise exponent
-                bfp_s32_use_exponent(&ch0, appconfEXP);
-                bfp_s32_use_exponent(&ch1, appconfEXP);
+                for(int c = 0; c < appconfMIC_COUNT; c ++){
+                    bfp_s32_use_exponent(&ch[c], appconfEXP);
+                }
                 // send frame over the channel
                 s_chan_out_buf_word(c_output, (uint32_t*) output, appconfFRAMES_IN_ALL_CHANS);
             }
@@ -106,11 +110,12 @@ void ap_stage_b(chanend_t c_input, chanend_t c_output, chanend_t c_from_gpio) {
 void ap_stage_c(chanend_t c_input, chanend_t c_output, chanend_t c_to_gpio) {
 
     int32_t DWORD_ALIGNED input[appconfMIC_COUNT][appconfAUDIO_FRAME_LENGTH];
-    int32_t DWORD_ALIGNED output[appconfAUDIO_FRAME_LENGTH][appconfMIC_COUNT];
-    // initialise block floating point structures for both channels
-    bfp_s32_t ch0, ch1;
-    bfp_s32_init(&ch0, input[0], appconfEXP, appconfAUDIO_FRAME_LENGTH, 0);
-    bfp_s32_init(&ch1, input[1], appconfEXP, appconfAUDIO_FRAME_LENGTH, 0);
+    int32_t DWORD_ALIGNED output[appconfAUDIO_FRAME_LENGTH][appconfI2S_CHANNELS];
+    // initialise block floating point structures for every channel
+    bfp_s32_t in_ch[appconfMIC_COUNT];
+    for(int c = 0; c < appconfMIC_COUNT; c ++){
+        bfp_s32_init(&in_ch[c], input[c], appconfEXP, appconfAUDIO_FRAME_LENGTH, 0);
+    }
 
     triggerable_disable_all();
     // initialise event
@@ -127,28 +132,26 @@ void ap_stage_c(chanend_t c_input, chanend_t c_output, chanend_t c_to_gpio) {
                 uint8_t led_byte = 0;
                 // recieve frame over the channel
                 s_chan_in_buf_word(c_input, (uint32_t*) input, appconfFRAMES_IN_ALL_CHANS);
-                // calculate the headroom of the new frames
-                bfp_s32_headroom(&ch0);
-                bfp_s32_headroom(&ch1);
-                // calculate the frame energy
-                float_s32_t frame_energy_ch0 = float_s64_to_float_s32(bfp_s32_energy(&ch0));
-                float_s32_t frame_energy_ch1 = float_s64_to_float_s32(bfp_s32_energy(&ch1));
-                // calculate the frame power
-                float frame_pow0 = float_s32_to_float(frame_energy_ch0) / (float)appconfAUDIO_FRAME_LENGTH;
-                float frame_pow1 = float_s32_to_float(frame_energy_ch1) / (float)appconfAUDIO_FRAME_LENGTH;
-                if((frame_pow0 > appconfPOWER_THRESHOLD) || (frame_pow1 > appconfPOWER_THRESHOLD)){
-                    led_byte = 1;
+                // calculate the headroom, energy and power of each channel
+                for(int c = 0; c < appconfMIC_COUNT; c ++){
+                    bfp_s32_headroom(&in_ch[c]);
+                    float_s32_t frame_energy = float_s64_to_float_s32(bfp_s32_energy(&in_ch[c]));
+                    float frame_pow = float_s32_to_float(frame_energy) / (float)appconfAUDIO_FRAME_LENGTH;
+                    if(frame_pow > appconfPOWER_THRESHOLD){
+                        led_byte = 1;
+                    }
                 }
                 // send led value to gpio
                 chanend_out_byte(c_to_gpio, led_byte);
-                // change the array format to [sample][channel]
-                for(int ch = 0; ch < appconfMIC_COUNT; ch ++){
+                // change the array format to [sample][channel], with output
+                // channel ch taken from mic (ch % appconfMIC_COUNT)
+                for(int ch = 0; ch < appconfI2S_CHANNELS; ch ++){
                     for(int smp = 0; smp < appconfAUDIO_FRAME_LENGTH; smp ++){
-                        output[smp][ch] = input[ch][smp];
+                        output[smp][ch] = input[ch % appconfMIC_COUNT][smp];
                     }
                 }
                 // send frame over the channel
-                s_chan_out_buf_word(c_output, (uint32_t*) output, appconfFRAMES_IN_ALL_CHANS);
+                s_chan_out_buf_word(c_output, (uint32_t*) output, appconfAUDIO_FRAME_LENGTH * appconfI2S_CHANNELS);
             }
             continue;
         }
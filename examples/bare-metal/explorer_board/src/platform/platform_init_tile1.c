@@ -72,7 +72,7 @@ static void i2s_receive(chanend_t *input_c, size_t num_in, const int32_t *i2s_sa
 I2S_CALLBACK_ATTR
 static void i2s_send(chanend_t *input_c, size_t num_out, int32_t *i2s_sample_buf)
 {
-    s_chan_in_buf_word(*input_c, (uint32_t*)i2s_sample_buf, MIC_ARRAY_CONFIG_MIC_COUNT);
+    s_chan_in_buf_word(*input_c, (uint32_t*)i2s_sample_buf, num_out);
 }
 
 static void tile1_i2s_init(void)
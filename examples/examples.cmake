@@ -28,6 +28,7 @@ else()
 
     add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/freertos/device_control/host)
     add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/freertos/tracealyzer/host)
+    add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/freertos/xscope_fileio/host)
     add_subdirectory(modules/xscope_fileio/xscope_fileio/host)
     install(TARGETS xscope_host_endpoint DESTINATION ${HOST_INSTALL_DIR})
 endif()
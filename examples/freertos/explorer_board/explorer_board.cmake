@@ -1,8 +1,17 @@
 #**********************
 # Gather Sources
 #**********************
+set(SHARED_AUDIO_PIPELINE_DIR ${CMAKE_CURRENT_LIST_DIR}/../../shared/audio_pipeline)
+
 file(GLOB_RECURSE APP_SOURCES ${CMAKE_CURRENT_LIST_DIR}/src/*.c)
-set(APP_INCLUDES ${CMAKE_CURRENT_LIST_DIR}/src)
+list(APPEND APP_SOURCES
+    ${SHARED_AUDIO_PIPELINE_DIR}/frame_pool.c
+    ${SHARED_AUDIO_PIPELINE_DIR}/gain_ramp.c
+)
+set(APP_INCLUDES
+    ${CMAKE_CURRENT_LIST_DIR}/src
+    ${SHARED_AUDIO_PIPELINE_DIR}
+)
 
 #**********************
 # Flags
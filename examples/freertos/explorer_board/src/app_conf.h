@@ -32,13 +32,36 @@
 #define appconfAUDIO_PIPELINE_MAX_GAIN          60
 #define appconfAUDIO_PIPELINE_MIN_GAIN          0
 #define appconfAUDIO_PIPELINE_GAIN_STEP         4
+#define appconfAUDIO_PIPELINE_GAIN_RAMP_SAMPLES 160
 #define appconfAUDIO_FRAME_LENGTH            	MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME
 #define appconfMIC_COUNT                        MIC_ARRAY_CONFIG_MIC_COUNT
 #define appconfPRINT_AUDIO_FRAME_POWER          0
 #define appconfFRAMES_IN_ALL_CHANS              (appconfAUDIO_FRAME_LENGTH * appconfMIC_COUNT)
+#define appconfI2S_CHANNELS                     2 /* Output channel c is mic (c % appconfMIC_COUNT) */
 #define appconfPOWER_THRESHOLD                  (float)0.00001
 #define appconfEXP                              -31
 
+/* Set to 1 to take the pipeline frames from a pool of
+ * appconfAUDIO_PIPELINE_POOL_FRAMES frames, which must be a power of two and
+ * more than the frames the pipeline can hold at once. Set to 0 to allocate
+ * each frame from the heap. */
+#define appconfAUDIO_PIPELINE_FRAME_POOL        1
+#define appconfAUDIO_PIPELINE_POOL_FRAMES       4
+
+/* Set to 1 to print the heap usage, and the per frame cost of allocating,
+ * freeing and interleaving the pipeline frames for I2S, every
+ * appconfAUDIO_PIPELINE_SOAK_REPORT_MS */
+#define appconfAUDIO_PIPELINE_SOAK_BENCHMARK    0
+#define appconfAUDIO_PIPELINE_SOAK_REPORT_MS    10000
+
+/* Set to 1 to time stage0's gain and stage1's metering of a frame, at
+ * startup */
+#define appconfAUDIO_PIPELINE_KERNEL_BENCHMARK  0
+
+/* Set to 1 to time the pipeline's processing of each frame for 1 to 8
+ * channels, at startup */
+#define appconfAUDIO_PIPELINE_SCALING_BENCHMARK 0
+
 /* UART Configuration */
 #define appconfUART_BAUD_RATE                   806400
 
@@ -54,5 +77,6 @@
 #define appconfSPI_MASTER_TASK_PRIORITY         ( configMAX_PRIORITIES - 1 )
 #define appconfQSPI_FLASH_TASK_PRIORITY         ( configMAX_PRIORITIES - 1 )
 #define appconfUART_RX_TASK_PRIORITY            ( configMAX_PRIORITIES - 1 )
+#define appconfAUDIO_PIPELINE_SOAK_TASK_PRIORITY ( configMAX_PRIORITIES - 5 )
 
 #endif /* APP_CONF_H_ */
@@ -0,0 +1,93 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* STD headers */
+#include <string.h>
+#include <stdint.h>
+#include <xcore/hwtimer.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+
+/* Library headers */
+#include "rtos_printf.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "example_pipeline.h"
+#include "gain_ramp.h"
+#include "example_stages.h"
+
+#if appconfAUDIO_PIPELINE_KERNEL_BENCHMARK
+
+#define BENCH_ITERATIONS    1000
+
+typedef struct {
+    uint32_t total;
+    uint32_t max;
+} bench_result_t;
+
+static void bench_record(bench_result_t *result, uint32_t ticks)
+{
+    result->total += ticks;
+    if (ticks > result->max) {
+        result->max = ticks;
+    }
+}
+
+static void bench_report(const char *name, const bench_result_t *result)
+{
+    rtos_printf("%s: %u ticks per frame (max %u)\n",
+                name,
+                result->total / BENCH_ITERATIONS,
+                result->max);
+}
+
+/* Times stage0's gain and exponent normalisation, and stage1's metering, of
+ * every channel of a frame, first at a constant gain and then with the gain
+ * ramping throughout. Each frame is refilled from the same input before it
+ * is timed. */
+void example_pipeline_kernel_benchmark(void)
+{
+    static int32_t input[appconfFRAMES_IN_ALL_CHANS];
+    static int32_t frame[appconfFRAMES_IN_ALL_CHANS];
+    static int32_t frame_gains[appconfAUDIO_FRAME_LENGTH];
+    gain_ramp_t ramp;
+    uint32_t start;
+    volatile float power;
+
+    /* A pseudo-random sequence of up to a quarter of full scale */
+    for (int i = 0; i < appconfFRAMES_IN_ALL_CHANS; i++) {
+        input[i] = ((i * 7919) % 1024 - 512) << 20;
+    }
+
+    for (int ramping = 0; ramping < 2; ramping++) {
+        bench_result_t gain = {0};
+        bench_result_t meter = {0};
+
+        /* A ramp long enough to last the whole benchmark */
+        unsigned ramp_samples = ramping ? 2 * BENCH_ITERATIONS * appconfAUDIO_FRAME_LENGTH : 1;
+
+        gain_ramp_init(&ramp, frame_gains, appconfAUDIO_FRAME_LENGTH, ramp_samples, 0);
+        gain_ramp_set_db(&ramp, appconfAUDIO_PIPELINE_STAGE_ZERO_GAIN);
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            memcpy(frame, input, sizeof(frame));
+            start = get_reference_time();
+            stage_gain(frame, appconfMIC_COUNT, &ramp);
+            bench_record(&gain, get_reference_time() - start);
+
+            start = get_reference_time();
+            power = stage_max_power(frame, appconfMIC_COUNT);
+            bench_record(&meter, get_reference_time() - start);
+        }
+        (void) power;
+
+        rtos_printf("Gain and metering of %d channels of %d samples, %s gain:\n",
+                    appconfMIC_COUNT, appconfAUDIO_FRAME_LENGTH,
+                    ramping ? "ramping" : "constant");
+        bench_report("\tstage_gain", &gain);
+        bench_report("\tstage_max_power", &meter);
+    }
+}
+
+#endif /* appconfAUDIO_PIPELINE_KERNEL_BENCHMARK */
@@ -1,6 +1,10 @@
 // Copyright 2020-2022 XMOS LIMITED.
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
 
+/* STD headers */
+#include <stdint.h>
+#include <xcore/hwtimer.h>
+
 /* FreeRTOS headers */
 #include "FreeRTOS.h"
 #include "task.h"
@@ -11,13 +15,148 @@
 #include "app_conf.h"
 #include "generic_pipeline.h"
 #include "example_pipeline.h"
+#include "frame_pool.h"
+#include "frame_interleave.h"
+#include "gain_ramp.h"
+#include "example_stages.h"
 #include "platform/driver_instances.h"
 
-#if appconfMIC_COUNT != 2
-#error appconfMIC_COUNT must be 2
+static BaseType_t xStage0_Gain = appconfAUDIO_PIPELINE_STAGE_ZERO_GAIN;
+
+/* Only used by stage0 once the pipeline is running */
+static gain_ramp_t stage0_gain;
+static int32_t stage0_frame_gains[appconfAUDIO_FRAME_LENGTH];
+
+#if appconfAUDIO_PIPELINE_FRAME_POOL
+static frame_pool_t frame_pool;
+static int32_t FRAME_INTERLEAVE_ALIGNED frame_pool_frames[appconfAUDIO_PIPELINE_POOL_FRAMES][appconfFRAMES_IN_ALL_CHANS];
+static void *frame_pool_ring[appconfAUDIO_PIPELINE_POOL_FRAMES];
 #endif
 
-static BaseType_t xStage0_Gain = appconfAUDIO_PIPELINE_STAGE_ZERO_GAIN;
+#if appconfAUDIO_PIPELINE_SOAK_BENCHMARK
+typedef struct {
+    volatile uint32_t frames;
+    volatile uint32_t ticks;
+    volatile uint32_t max;
+} soak_count_t;
+
+/* Each is only written by one pipeline task, the input or the output */
+static soak_count_t soak_alloc;
+static soak_count_t soak_free;
+static soak_count_t soak_interleave;
+
+static void soak_record(soak_count_t *count, uint32_t ticks)
+{
+    count->ticks += ticks;
+    count->frames++;
+    if (ticks > count->max) {
+        count->max = ticks;
+    }
+}
+#endif
+
+static int32_t *frame_alloc(void)
+{
+    int32_t *frame;
+#if appconfAUDIO_PIPELINE_SOAK_BENCHMARK
+    uint32_t start = get_reference_time();
+#endif
+
+#if appconfAUDIO_PIPELINE_FRAME_POOL
+    /* The mic array paces the input, so the pool is only empty if the
+     * output has fallen behind */
+    while ((frame = frame_pool_get(&frame_pool)) == NULL) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+#else
+    frame = pvPortMalloc(appconfFRAMES_IN_ALL_CHANS * sizeof(int32_t));
+#endif
+
+#if appconfAUDIO_PIPELINE_SOAK_BENCHMARK
+    soak_record(&soak_alloc, get_reference_time() - start);
+#endif
+    return frame;
+}
+
+static void frame_free(int32_t *frame)
+{
+#if appconfAUDIO_PIPELINE_SOAK_BENCHMARK
+    uint32_t start = get_reference_time();
+#endif
+
+#if appconfAUDIO_PIPELINE_FRAME_POOL
+    frame_pool_put(&frame_pool, frame);
+#else
+    vPortFree(frame);
+#endif
+
+#if appconfAUDIO_PIPELINE_SOAK_BENCHMARK
+    soak_record(&soak_free, get_reference_time() - start);
+#endif
+}
+
+#if appconfAUDIO_PIPELINE_SOAK_BENCHMARK
+static uint32_t soak_average(uint32_t ticks, uint32_t frames)
+{
+    return frames ? ticks / frames : 0;
+}
+
+/* Reports the heap, the frame allocation cost and the cost of interleaving
+ * each frame for I2S over each period, for runs of hours or days. The free
+ * heap should stay flat once the pipeline is running. The counts are read
+ * while the pipeline updates them, so a report may be off by a frame. */
+static void example_pipeline_soak(void *arg)
+{
+    (void) arg;
+    soak_count_t last_alloc = {0};
+    soak_count_t last_free = {0};
+    soak_count_t last_interleave = {0};
+    uint32_t reports = 0;
+
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(appconfAUDIO_PIPELINE_SOAK_REPORT_MS));
+
+        uint32_t alloc_frames = soak_alloc.frames;
+        uint32_t alloc_ticks = soak_alloc.ticks;
+        uint32_t free_frames = soak_free.frames;
+        uint32_t free_ticks = soak_free.ticks;
+        uint32_t interleave_frames = soak_interleave.frames;
+        uint32_t interleave_ticks = soak_interleave.ticks;
+
+        rtos_printf("Pipeline soak %u, %s, %u frames:\n"
+                    "\talloc: %u ticks per frame (max %u)\n"
+                    "\tfree: %u ticks per frame (max %u)\n"
+                    "\tinterleave: %u ticks per frame (max %u)\n"
+                    "\tMinimum heap free: %d\n"
+                    "\tCurrent heap free: %d\n",
+                    ++reports,
+                    appconfAUDIO_PIPELINE_FRAME_POOL ? "frame pool" : "heap",
+                    free_frames - last_free.frames,
+                    soak_average(alloc_ticks - last_alloc.ticks, alloc_frames - last_alloc.frames),
+                    soak_alloc.max,
+                    soak_average(free_ticks - last_free.ticks, free_frames - last_free.frames),
+                    soak_free.max,
+                    soak_average(interleave_ticks - last_interleave.ticks, interleave_frames - last_interleave.frames),
+                    soak_interleave.max,
+                    xPortGetMinimumEverFreeHeapSize(),
+                    xPortGetFreeHeapSize());
+#if appconfAUDIO_PIPELINE_FRAME_POOL
+        rtos_printf("\tFrame pool: %u of %u in use, peak %u, empty %u times\n",
+                    frame_pool_in_use(&frame_pool),
+                    frame_pool.count,
+                    frame_pool.peak_in_use,
+                    frame_pool.empty_count);
+#endif
+
+        last_alloc.frames = alloc_frames;
+        last_alloc.ticks = alloc_ticks;
+        last_free.frames = free_frames;
+        last_free.ticks = free_ticks;
+        last_interleave.frames = interleave_frames;
+        last_interleave.ticks = interleave_ticks;
+    }
+}
+#endif
 
 BaseType_t audiopipeline_get_stage1_gain( void )
 {
@@ -37,7 +176,7 @@ void *example_pipeline_input(void *data)
 
     int32_t * audio_frame;
 
-    audio_frame = pvPortMalloc(appconfFRAMES_IN_ALL_CHANS * sizeof(int32_t));
+    audio_frame = frame_alloc();
 
     rtos_mic_array_rx(
             mic_array_ctx,
@@ -51,13 +190,16 @@ void *example_pipeline_input(void *data)
 int example_pipeline_output(void *audio_frame, void *data)
 {
     (void) data;
-    int32_t * chan_samp = audio_frame;
-    int32_t samp_chan [appconfFRAMES_IN_ALL_CHANS];
-    // i2s drivers currently don't support [channel][sample] format so need to restructure it here
-    for(int i = 0; i < appconfAUDIO_FRAME_LENGTH; i++){
-        samp_chan[2 * i] = chan_samp[i];
-        samp_chan[2 * i + 1] = chan_samp[i + appconfAUDIO_FRAME_LENGTH];
-    }
+    int32_t FRAME_INTERLEAVE_ALIGNED samp_chan [appconfAUDIO_FRAME_LENGTH * appconfI2S_CHANNELS];
+#if appconfAUDIO_PIPELINE_SOAK_BENCHMARK
+    uint32_t start = get_reference_time();
+#endif
+    // i2s drivers currently don't support [channel][sample] format so need to restructure it here,
+    // which also picks the mic channels sent to each i2s channel
+    frame_interleave(samp_chan, appconfI2S_CHANNELS, audio_frame, appconfMIC_COUNT, appconfAUDIO_FRAME_LENGTH);
+#if appconfAUDIO_PIPELINE_SOAK_BENCHMARK
+    soak_record(&soak_interleave, get_reference_time() - start);
+#endif
 
     rtos_i2s_tx(
             i2s_ctx,
@@ -65,51 +207,38 @@ int example_pipeline_output(void *audio_frame, void *data)
             appconfAUDIO_FRAME_LENGTH,
             portMAX_DELAY);
 
-    vPortFree(audio_frame);
+    frame_free(audio_frame);
 
     return 0;
 }
 
 void stage1(int32_t * audio_frame)
 {
-    bfp_s32_t ch0, ch1;
-    bfp_s32_init(&ch0, audio_frame, appconfEXP, appconfAUDIO_FRAME_LENGTH, 1);
-    bfp_s32_init(&ch1, &audio_frame[appconfAUDIO_FRAME_LENGTH], appconfEXP, appconfAUDIO_FRAME_LENGTH, 1);
-    // calculate the frame energy
-    float_s32_t frame_energy_ch0 = float_s64_to_float_s32(bfp_s32_energy(&ch0));
-    float_s32_t frame_energy_ch1 = float_s64_to_float_s32(bfp_s32_energy(&ch1));
-    // calculate the frame power
-    float frame_pow0 = float_s32_to_float(frame_energy_ch0) / (float)appconfAUDIO_FRAME_LENGTH;
-    float frame_pow1 = float_s32_to_float(frame_energy_ch1) / (float)appconfAUDIO_FRAME_LENGTH;
+    // calculate the highest frame power
+    float frame_pow_max = stage_max_power(audio_frame, appconfMIC_COUNT);
     // get the led_port and mask out LED 0 and 1
     const rtos_gpio_port_id_t led_port = rtos_gpio_port(PORT_LEDS);
     uint32_t led_val = rtos_gpio_port_in(gpio_ctx_t0, led_port);
     led_val &= 0x3;
-    // if the frame power exeedes the threshold turn on LED 2
-    if((frame_pow0 > appconfPOWER_THRESHOLD) || (frame_pow1 > appconfPOWER_THRESHOLD)){
+    // if the power of any channel exeedes the threshold turn on LED 2
+    if(frame_pow_max > appconfPOWER_THRESHOLD){
         led_val |= 0x4;
     }
     rtos_gpio_port_out(gpio_ctx_t0, led_port, led_val);
 #if appconfPRINT_AUDIO_FRAME_POWER
-    rtos_printf("Mic power:\nch0: %f\nch1: %f\n", frame_pow0, frame_pow1);
+    rtos_printf("Mic power:\n");
+    for(int ch = 0; ch < appconfMIC_COUNT; ch++){
+        rtos_printf("ch%d: %f\n", ch, stage_power(&audio_frame[ch * appconfAUDIO_FRAME_LENGTH]));
+    }
 #endif
 }
 
 void stage0(int32_t * audio_frame)
 {
-    bfp_s32_t ch0, ch1;
-    bfp_s32_init(&ch0, &audio_frame[0], appconfEXP, appconfAUDIO_FRAME_LENGTH, 1);
-    bfp_s32_init(&ch1, &audio_frame[appconfAUDIO_FRAME_LENGTH], appconfEXP, appconfAUDIO_FRAME_LENGTH, 1);
-    // convert dB to amplitude
-    float power = (float)xStage0_Gain / 20.0;
-    float gain_fl = powf(10.0, power);
-    float_s32_t gain = f32_to_float_s32(gain_fl);
-    // scale both channels
-    bfp_s32_scale(&ch0, &ch0, gain);
-    bfp_s32_scale(&ch1, &ch1, gain);
-    // normalise exponent
-    bfp_s32_use_exponent(&ch0, appconfEXP);
-    bfp_s32_use_exponent(&ch1, appconfEXP);
+    // ramp to the gain if it has changed, then scale every channel and
+    // normalise the exponent
+    gain_ramp_set_db(&stage0_gain, xStage0_Gain);
+    stage_gain(audio_frame, appconfMIC_COUNT, &stage0_gain);
 }
 
 void example_pipeline_init(UBaseType_t priority)
@@ -117,6 +246,20 @@ void example_pipeline_init(UBaseType_t priority)
 	const int stage_count = 2;
     mic_array_ctx->format = RTOS_MIC_ARRAY_CHANNEL_SAMPLE;
 
+    gain_ramp_init(&stage0_gain,
+                   stage0_frame_gains,
+                   appconfAUDIO_FRAME_LENGTH,
+                   appconfAUDIO_PIPELINE_GAIN_RAMP_SAMPLES,
+                   xStage0_Gain);
+
+#if appconfAUDIO_PIPELINE_FRAME_POOL
+    frame_pool_init(&frame_pool,
+                    frame_pool_frames,
+                    sizeof(frame_pool_frames[0]),
+                    appconfAUDIO_PIPELINE_POOL_FRAMES,
+                    frame_pool_ring);
+#endif
+
 	const pipeline_stage_t stages[stage_count] = {
 			(pipeline_stage_t) stage0,
 			(pipeline_stage_t) stage1
@@ -129,13 +272,22 @@ void example_pipeline_init(UBaseType_t priority)
 
 	generic_pipeline_init(
 			example_pipeline_input,
-			example_pipeline_output,
+			(pipeline_output_t) example_pipeline_output,
             NULL,
             NULL,
 			stages,
 			(const size_t*) stage_stack_sizes,
 			priority,
 			stage_count);
+
+#if appconfAUDIO_PIPELINE_SOAK_BENCHMARK
+    xTaskCreate((TaskFunction_t) example_pipeline_soak,
+                "pipeline_soak",
+                RTOS_THREAD_STACK_SIZE(example_pipeline_soak),
+                NULL,
+                appconfAUDIO_PIPELINE_SOAK_TASK_PRIORITY,
+                NULL);
+#endif
 }
 
 #undef MIN
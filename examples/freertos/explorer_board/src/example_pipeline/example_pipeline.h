@@ -8,6 +8,8 @@
 #include "rtos_i2s.h"
 #include "xmath/xmath.h"
 
+#include "app_conf.h"
+
 enum {
     GET_GAIN_VAL = 1,
     SET_GAIN_VAL
@@ -18,4 +20,15 @@ void example_pipeline_init( UBaseType_t priority );
 BaseType_t audiopipeline_get_stage1_gain( void );
 BaseType_t audiopipeline_set_stage1_gain( BaseType_t xNewGain );
 
+#if appconfAUDIO_PIPELINE_KERNEL_BENCHMARK
+/* Prints the per frame cost of stage0's gain and of stage1's metering */
+void example_pipeline_kernel_benchmark( void );
+#endif
+
+#if appconfAUDIO_PIPELINE_SCALING_BENCHMARK
+/* Prints the per frame cost of the pipeline's processing for 1 to 8
+ * channels */
+void example_pipeline_scaling_benchmark( void );
+#endif
+
 #endif /* SRC_EXAMPLE_PIPELINE_H_ */
@@ -0,0 +1,86 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* STD headers */
+#include <string.h>
+#include <stdint.h>
+#include <xcore/hwtimer.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+
+/* Library headers */
+#include "rtos_printf.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "example_pipeline.h"
+#include "example_stages.h"
+#include "frame_interleave.h"
+
+#if appconfAUDIO_PIPELINE_SCALING_BENCHMARK
+
+#define BENCH_ITERATIONS    1000
+#define BENCH_MAX_CHANNELS  8
+
+static int32_t input[BENCH_MAX_CHANNELS * appconfAUDIO_FRAME_LENGTH];
+static int32_t FRAME_INTERLEAVE_ALIGNED frame[BENCH_MAX_CHANNELS * appconfAUDIO_FRAME_LENGTH];
+static int32_t FRAME_INTERLEAVE_ALIGNED samp_chan[appconfAUDIO_FRAME_LENGTH * appconfI2S_CHANNELS];
+static int32_t frame_gains[appconfAUDIO_FRAME_LENGTH];
+
+/* Times the work both pipeline stages and the output do on each frame, for
+ * a frame of the given number of channels. Always inlined, so that each call
+ * with a constant count is specialised for it, as the pipeline is for
+ * appconfMIC_COUNT. */
+__attribute__((always_inline))
+static inline void bench_channels(unsigned channels)
+{
+    gain_ramp_t ramp;
+    uint32_t total = 0;
+    uint32_t max = 0;
+    uint32_t start;
+    uint32_t ticks;
+    volatile float power;
+
+    gain_ramp_init(&ramp, frame_gains, appconfAUDIO_FRAME_LENGTH, 1, appconfAUDIO_PIPELINE_STAGE_ZERO_GAIN);
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        memcpy(frame, input, channels * appconfAUDIO_FRAME_LENGTH * sizeof(int32_t));
+        start = get_reference_time();
+        stage_gain(frame, channels, &ramp);
+        power = stage_max_power(frame, channels);
+        frame_interleave(samp_chan, appconfI2S_CHANNELS, frame, channels, appconfAUDIO_FRAME_LENGTH);
+        ticks = get_reference_time() - start;
+
+        total += ticks;
+        if (ticks > max) {
+            max = ticks;
+        }
+    }
+    (void) power;
+
+    rtos_printf("\t%u channels: %u ticks per frame, %u per channel (max %u)\n",
+                channels,
+                total / BENCH_ITERATIONS,
+                total / BENCH_ITERATIONS / channels,
+                max);
+}
+
+/* Prints the per frame cost of the pipeline's processing against the number
+ * of channels, at a constant gain */
+void example_pipeline_scaling_benchmark(void)
+{
+    for (int i = 0; i < BENCH_MAX_CHANNELS * appconfAUDIO_FRAME_LENGTH; i++) {
+        input[i] = ((i * 7919) % 1024 - 512) << 20;
+    }
+
+    rtos_printf("Pipeline processing of %d sample frames, against channel count:\n",
+                appconfAUDIO_FRAME_LENGTH);
+    bench_channels(1);
+    bench_channels(2);
+    bench_channels(4);
+    bench_channels(6);
+    bench_channels(8);
+}
+
+#endif /* appconfAUDIO_PIPELINE_SCALING_BENCHMARK */
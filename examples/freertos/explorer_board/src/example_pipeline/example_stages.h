@@ -0,0 +1,72 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef EXAMPLE_STAGES_H_
+#define EXAMPLE_STAGES_H_
+
+#include <stdint.h>
+
+#include "xmath/xmath.h"
+
+#include "app_conf.h"
+#include "gain_ramp.h"
+
+/*
+ * The per frame work of the pipeline stages, for frames of any number of
+ * channels of appconfAUDIO_FRAME_LENGTH samples each, [channel][sample].
+ * These are inline, so each caller with a constant channel count gets loops
+ * specialised for that count.
+ */
+
+/* Applies the gain to each channel and leaves it at exponent appconfEXP */
+static inline void stage_gain(int32_t *samples,
+                              unsigned channels,
+                              gain_ramp_t *ramp)
+{
+    float_s32_t gain;
+    const int32_t *gains = gain_ramp_next(ramp, &gain);
+    bfp_s32_t ramp_gains;
+
+    if (gains != NULL) {
+        bfp_s32_init(&ramp_gains, (int32_t *) gains, gain.exp, appconfAUDIO_FRAME_LENGTH, 1);
+    }
+
+    for (unsigned c = 0; c < channels; c++) {
+        bfp_s32_t ch;
+
+        bfp_s32_init(&ch, &samples[c * appconfAUDIO_FRAME_LENGTH], appconfEXP, appconfAUDIO_FRAME_LENGTH, 1);
+        if (gains != NULL) {
+            bfp_s32_mul(&ch, &ch, &ramp_gains);
+        } else {
+            bfp_s32_scale(&ch, &ch, gain);
+        }
+        bfp_s32_use_exponent(&ch, appconfEXP);
+    }
+}
+
+/* Returns the power of one channel of samples at exponent appconfEXP */
+static inline float stage_power(int32_t *channel)
+{
+    bfp_s32_t ch;
+
+    bfp_s32_init(&ch, channel, appconfEXP, appconfAUDIO_FRAME_LENGTH, 1);
+    return float_s32_to_float(float_s64_to_float_s32(bfp_s32_energy(&ch))) / (float)appconfAUDIO_FRAME_LENGTH;
+}
+
+/* Returns the highest power of any channel */
+static inline float stage_max_power(int32_t *samples, unsigned channels)
+{
+    float max_power = 0;
+
+    for (unsigned c = 0; c < channels; c++) {
+        float power = stage_power(&samples[c * appconfAUDIO_FRAME_LENGTH]);
+
+        if (power > max_power) {
+            max_power = power;
+        }
+    }
+
+    return max_power;
+}
+
+#endif /* EXAMPLE_STAGES_H_ */
@@ -0,0 +1,54 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame_interleave.h"
+
+/* Two consecutive samples of one channel, or one sample of two channels. The
+ * frames are declared as words, so this type may alias them. */
+typedef uint64_t __attribute__((may_alias)) dword_t;
+
+/* Each pair of samples of each channel is loaded with a single double word
+ * load, and each interleaved pair stored with a single double word store.
+ * The words are moved between the register pairs without any other work. */
+static void interleave_stereo(dword_t *dst,
+                              const dword_t *left,
+                              const dword_t *right,
+                              size_t pairs)
+{
+    for (size_t i = 0; i < pairs; i++) {
+        dword_t l = left[i];
+        dword_t r = right[i];
+
+        dst[2 * i] = (l & 0xffffffff) | (r << 32);
+        dst[2 * i + 1] = (l >> 32) | (r & 0xffffffff00000000);
+    }
+}
+
+void frame_interleave(int32_t *dst,
+                      unsigned dst_channels,
+                      const int32_t *src,
+                      unsigned src_channels,
+                      size_t samples)
+{
+    if (dst_channels == 2 &&
+        src_channels >= 2 &&
+        (samples & 1) == 0 &&
+        (((uintptr_t) dst | (uintptr_t) src) & 7) == 0) {
+        interleave_stereo((dword_t *) dst,
+                          (const dword_t *) src,
+                          (const dword_t *) &src[samples],
+                          samples / 2);
+        return;
+    }
+
+    for (unsigned ch = 0; ch < dst_channels; ch++) {
+        const int32_t *src_ch = &src[(ch % src_channels) * samples];
+
+        for (size_t t = 0; t < samples; t++) {
+            dst[t * dst_channels + ch] = src_ch[t];
+        }
+    }
+}
@@ -0,0 +1,32 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef FRAME_INTERLEAVE_H_
+#define FRAME_INTERLEAVE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Frames passed to frame_interleave() take the fast path when they are
+ * double word aligned */
+#define FRAME_INTERLEAVE_ALIGNED __attribute__((aligned(8)))
+
+/*
+ * Interleaves a [channel][sample] frame, as the pipeline stages use, into the
+ * [sample][channel] order the I2S driver takes. Each of the dst_channels
+ * output channels is taken from channel (c % src_channels) of src, so a
+ * frame with more channels than the output has its first channels output,
+ * and a mono frame is output on every channel.
+ *
+ * Stereo output from two or more channels, with an even number of samples,
+ * at double word aligned addresses, is interleaved two samples at a time
+ * with double word loads and stores. Any other frame is interleaved a word
+ * at a time.
+ */
+void frame_interleave(int32_t *dst,
+                      unsigned dst_channels,
+                      const int32_t *src,
+                      unsigned src_channels,
+                      size_t samples);
+
+#endif /* FRAME_INTERLEAVE_H_ */
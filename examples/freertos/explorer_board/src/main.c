@@ -51,6 +51,13 @@ void startup_task(void *arg)
     /* Create the gpio control task */
     gpio_ctrl_create(appconfGPIO_TASK_PRIORITY);
 
+#if appconfAUDIO_PIPELINE_KERNEL_BENCHMARK
+    example_pipeline_kernel_benchmark();
+#endif
+#if appconfAUDIO_PIPELINE_SCALING_BENCHMARK
+    example_pipeline_scaling_benchmark();
+#endif
+
     /* Create audio pipeline */
     example_pipeline_init(appconfAUDIO_PIPELINE_TASK_PRIORITY);
 
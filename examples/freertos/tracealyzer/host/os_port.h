@@ -0,0 +1,209 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef OS_PORT_H_
+#define OS_PORT_H_
+
+/*
+ * Minimal threading abstraction so that the host tools can run on POSIX
+ * hosts as well as Windows.
+ */
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+
+typedef HANDLE os_thread_t;
+typedef CRITICAL_SECTION os_mutex_t;
+typedef CONDITION_VARIABLE os_cond_t;
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef pthread_t os_thread_t;
+typedef pthread_mutex_t os_mutex_t;
+typedef pthread_cond_t os_cond_t;
+#endif
+
+typedef void (*os_thread_fn_t)(void *arg);
+
+typedef struct os_thread_start {
+    os_thread_fn_t fn;
+    void *arg;
+} os_thread_start_t;
+
+#if defined(_WIN32)
+static inline DWORD WINAPI os_thread_trampoline(LPVOID param)
+#else
+static inline void *os_thread_trampoline(void *param)
+#endif
+{
+    os_thread_start_t start = *(os_thread_start_t *)param;
+    free(param);
+    start.fn(start.arg);
+    return 0;
+}
+
+static inline int os_thread_create(os_thread_t *thread, os_thread_fn_t fn,
+                                   void *arg)
+{
+    os_thread_start_t *start = malloc(sizeof(os_thread_start_t));
+
+    if (start == NULL)
+        return -1;
+
+    start->fn = fn;
+    start->arg = arg;
+
+#if defined(_WIN32)
+    *thread = CreateThread(NULL, 0, os_thread_trampoline, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return -1;
+    }
+#else
+    if (pthread_create(thread, NULL, os_thread_trampoline, start) != 0) {
+        free(start);
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+static inline void os_thread_join(os_thread_t thread)
+{
+#if defined(_WIN32)
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+static inline void os_mutex_init(os_mutex_t *mutex)
+{
+#if defined(_WIN32)
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+static inline void os_mutex_destroy(os_mutex_t *mutex)
+{
+#if defined(_WIN32)
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+static inline void os_mutex_lock(os_mutex_t *mutex)
+{
+#if defined(_WIN32)
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+static inline void os_mutex_unlock(os_mutex_t *mutex)
+{
+#if defined(_WIN32)
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+static inline void os_cond_init(os_cond_t *cond)
+{
+#if defined(_WIN32)
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+static inline void os_cond_destroy(os_cond_t *cond)
+{
+#if defined(_WIN32)
+    (void)cond;
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+static inline void os_cond_wait(os_cond_t *cond, os_mutex_t *mutex)
+{
+#if defined(_WIN32)
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+static inline void os_cond_broadcast(os_cond_t *cond)
+{
+#if defined(_WIN32)
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+/*
+ * Acquire/release accessors for values shared between threads without a
+ * lock, such as the indices of a single producer/single consumer queue.
+ */
+static inline size_t os_atomic_load_acquire(size_t *ptr)
+{
+#if defined(_MSC_VER)
+    /* Loads already have acquire semantics on x86/x64; only compiler
+     * reordering needs to be prevented. */
+    size_t value = *(volatile size_t *)ptr;
+    _ReadWriteBarrier();
+    return value;
+#else
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void os_atomic_store_release(size_t *ptr, size_t value)
+{
+#if defined(_MSC_VER)
+    _ReadWriteBarrier();
+    *(volatile size_t *)ptr = value;
+#else
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+/* A monotonic time in milliseconds, for measuring intervals. */
+static inline long long os_time_ms(void)
+{
+#if defined(_WIN32)
+    return (long long)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((long long)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+#endif
+}
+
+static inline int os_cpu_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+#endif
+}
+
+#endif /* OS_PORT_H_ */
@@ -0,0 +1,494 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdlib.h>
+#include <string.h>
+#include "psf_analysis.h"
+
+/*
+ * PSF event IDs, as defined by the Tracealyzer recorder's FreeRTOS kernel
+ * port (trcKernelPort.h).
+ */
+#define PSF_EVENT_OBJ_NAME      0x03
+#define PSF_EVENT_TASK_READY    0x30
+#define PSF_EVENT_ISR_BEGIN     0x33
+#define PSF_EVENT_ISR_RESUME    0x34
+#define PSF_EVENT_TS_BEGIN      0x35
+#define PSF_EVENT_TS_RESUME     0x36
+#define PSF_EVENT_TASK_ACTIVATE 0x37
+#define PSF_EVENT_MUTEX_GIVE    0x52
+#define PSF_EVENT_MUTEX_TAKE    0x62
+
+#define EVENT_HEADER_BYTES      8
+#define EVENT_ID_MASK           0x0FFF
+#define EVENT_PARAM_COUNT_SHIFT 12
+#define EVENT_CORE_ID_OFFSET    3
+
+#define IDLE_TASK_PREFIX        "IDLE"
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void histogram_add(psf_histogram_t *hist, uint64_t ticks,
+                          uint32_t frequency)
+{
+    uint64_t us = (ticks * 1000000) / frequency;
+    int bucket = 0;
+
+    while (bucket < PSF_HISTOGRAM_BUCKETS - 1 && us >= (1ull << bucket))
+        bucket++;
+
+    if (hist->count == 0 || ticks < hist->min)
+        hist->min = ticks;
+    if (ticks > hist->max)
+        hist->max = ticks;
+
+    hist->count++;
+    hist->total += ticks;
+    hist->buckets[bucket]++;
+}
+
+static size_t hash_handle(uint32_t handle, size_t size)
+{
+    // Handles are word aligned addresses
+    return ((handle >> 2) * 2654435761u) & (size - 1);
+}
+
+static bool lookup_grow(psf_analysis_t *analysis)
+{
+    size_t size = (analysis->lookup_size > 0) ? analysis->lookup_size * 2 : 64;
+    int32_t *lookup = malloc(size * sizeof(int32_t));
+
+    if (lookup == NULL)
+        return false;
+
+    memset(lookup, 0xFF, size * sizeof(int32_t));
+
+    for (size_t i = 0; i < analysis->num_objects; i++) {
+        size_t slot = hash_handle(analysis->objects[i].handle, size);
+
+        while (lookup[slot] >= 0)
+            slot = (slot + 1) & (size - 1);
+
+        lookup[slot] = (int32_t)i;
+    }
+
+    free(analysis->lookup);
+    analysis->lookup = lookup;
+    analysis->lookup_size = size;
+    return true;
+}
+
+/*
+ * Returns the object with the given handle, creating it if necessary, or
+ * NULL if out of memory.
+ */
+static psf_object_t *find_object(psf_analysis_t *analysis, uint32_t handle)
+{
+    size_t slot = 0;
+
+    if (analysis->lookup_size > 0) {
+        slot = hash_handle(handle, analysis->lookup_size);
+
+        while (analysis->lookup[slot] >= 0) {
+            psf_object_t *obj = &analysis->objects[analysis->lookup[slot]];
+
+            if (obj->handle == handle)
+                return obj;
+
+            slot = (slot + 1) & (analysis->lookup_size - 1);
+        }
+    }
+
+    // Keep the hash table at most half full
+    if ((analysis->num_objects + 1) * 2 > analysis->lookup_size) {
+        if (!lookup_grow(analysis))
+            return NULL;
+
+        slot = hash_handle(handle, analysis->lookup_size);
+        while (analysis->lookup[slot] >= 0)
+            slot = (slot + 1) & (analysis->lookup_size - 1);
+    }
+
+    if (analysis->num_objects == analysis->cap_objects) {
+        size_t cap = (analysis->cap_objects > 0) ?
+                     analysis->cap_objects * 2 : 32;
+        psf_object_t *objects = realloc(analysis->objects,
+                                        cap * sizeof(psf_object_t));
+
+        if (objects == NULL)
+            return NULL;
+
+        analysis->objects = objects;
+        analysis->cap_objects = cap;
+    }
+
+    psf_object_t *obj = &analysis->objects[analysis->num_objects];
+
+    memset(obj, 0, sizeof(*obj));
+    obj->handle = handle;
+    snprintf(obj->name, sizeof(obj->name), "0x%08X", handle);
+    analysis->lookup[slot] = (int32_t)analysis->num_objects++;
+
+    return obj;
+}
+
+static void set_name(psf_object_t *obj, const uint8_t *name, size_t max_len)
+{
+    size_t len = 0;
+
+    while (len < max_len && len < sizeof(obj->name) - 1 && name[len] != '\0')
+        len++;
+
+    if (len > 0) {
+        memcpy(obj->name, name, len);
+        obj->name[len] = '\0';
+    }
+}
+
+static bool is_idle_task(const psf_object_t *obj)
+{
+    return strncmp(obj->name, IDLE_TASK_PREFIX,
+                   sizeof(IDLE_TASK_PREFIX) - 1) == 0;
+}
+
+/*
+ * Charges the time since the last change of context on this core to the
+ * context that was running.
+ */
+static void core_account(psf_analysis_t *analysis, psf_core_t *core)
+{
+    uint64_t now = analysis->time;
+    uint64_t delta;
+
+    if (!core->active) {
+        core->active = true;
+        core->first = now;
+        core->since = now;
+        return;
+    }
+
+    // Events from different cores may arrive slightly out of order
+    delta = (now > core->since) ? (now - core->since) : 0;
+    core->since = (now > core->since) ? now : core->since;
+
+    if (core->isr_depth > 0) {
+        core->isr_ticks += delta;
+    } else if (core->task >= 0) {
+        psf_object_t *task = &analysis->objects[core->task];
+
+        task->run_ticks += delta;
+
+        if (is_idle_task(task))
+            core->idle_ticks += delta;
+        else
+            core->task_ticks += delta;
+    }
+}
+
+static void task_running(psf_analysis_t *analysis, psf_core_t *core,
+                         psf_object_t *task, bool activated)
+{
+    core_account(analysis, core);
+    core->isr_depth = 0;
+    core->task = (int)(task - analysis->objects);
+
+    task->is_task = true;
+
+    if (activated)
+        task->activations++;
+
+    if (task->ready_pending) {
+        histogram_add(&task->ready_latency,
+                      analysis->time - task->ready_time, analysis->frequency);
+        task->ready_pending = false;
+    }
+}
+
+void psf_analysis_init(psf_analysis_t *analysis)
+{
+    memset(analysis, 0, sizeof(*analysis));
+    analysis->frequency = 1;
+}
+
+void psf_analysis_deinit(psf_analysis_t *analysis)
+{
+    free(analysis->cores);
+    free(analysis->objects);
+    free(analysis->lookup);
+    memset(analysis, 0, sizeof(*analysis));
+}
+
+int psf_analysis_header(psf_analysis_t *analysis, uint32_t num_cores)
+{
+    free(analysis->cores);
+    analysis->cores = calloc(num_cores > 0 ? num_cores : 1,
+                             sizeof(psf_core_t));
+
+    if (analysis->cores == NULL)
+        return -1;
+
+    analysis->num_cores = num_cores;
+
+    for (uint32_t i = 0; i < num_cores; i++)
+        analysis->cores[i].task = -1;
+
+    return 0;
+}
+
+void psf_analysis_timestamp(psf_analysis_t *analysis, uint32_t frequency)
+{
+    if (frequency > 0)
+        analysis->frequency = frequency;
+}
+
+void psf_analysis_entry(psf_analysis_t *analysis, const uint8_t *entry,
+                        int length, uint32_t state_count,
+                        uint32_t symbol_length)
+{
+    const size_t symbol_offset = (state_count + 2) * sizeof(uint32_t);
+    uint32_t handle;
+    psf_object_t *obj;
+
+    if (length < (int)(symbol_offset + symbol_length))
+        return;
+
+    handle = get_u32(entry);
+    if (handle == 0 || entry[symbol_offset] == '\0')
+        return;
+
+    obj = find_object(analysis, handle);
+    if (obj != NULL)
+        set_name(obj, &entry[symbol_offset], symbol_length);
+}
+
+void psf_analysis_event(psf_analysis_t *analysis, const uint8_t *event,
+                        int length)
+{
+    uint16_t id_word;
+    uint32_t raw_time;
+    uint32_t event_id;
+    uint32_t param_count;
+    uint32_t core_id;
+    uint32_t handle;
+    psf_core_t *core;
+    psf_object_t *obj;
+
+    if (length < EVENT_HEADER_BYTES)
+        return;
+
+    memcpy(&id_word, event, sizeof(id_word));
+    raw_time = get_u32(&event[4]);
+    event_id = id_word & EVENT_ID_MASK;
+    param_count = id_word >> EVENT_PARAM_COUNT_SHIFT;
+    core_id = event[EVENT_CORE_ID_OFFSET] >> 4;
+
+    // Extend the 32-bit timestamp, tolerating small reorderings
+    if (analysis->have_time) {
+        analysis->time += (int64_t)(int32_t)(raw_time - analysis->last_raw_time);
+    } else {
+        analysis->time = raw_time;
+        analysis->first_time = raw_time;
+        analysis->have_time = true;
+    }
+    analysis->last_raw_time = raw_time;
+    analysis->events++;
+
+    if (param_count == 0 ||
+        length < (int)(EVENT_HEADER_BYTES + param_count * sizeof(uint32_t)))
+        return;
+
+    handle = get_u32(&event[EVENT_HEADER_BYTES]);
+    core = (core_id < analysis->num_cores) ? &analysis->cores[core_id] : NULL;
+
+    switch (event_id) {
+    case PSF_EVENT_OBJ_NAME:
+        if ((obj = find_object(analysis, handle)) != NULL)
+            set_name(obj, &event[EVENT_HEADER_BYTES + sizeof(uint32_t)],
+                     (param_count - 1) * sizeof(uint32_t));
+        break;
+    case PSF_EVENT_TASK_READY:
+        if ((obj = find_object(analysis, handle)) != NULL &&
+            !obj->ready_pending) {
+            obj->is_task = true;
+            obj->ready_pending = true;
+            obj->ready_time = analysis->time;
+        }
+        break;
+    case PSF_EVENT_TASK_ACTIVATE:
+    case PSF_EVENT_TS_BEGIN:
+    case PSF_EVENT_TS_RESUME:
+        if (core != NULL && (obj = find_object(analysis, handle)) != NULL)
+            task_running(analysis, core, obj,
+                         event_id != PSF_EVENT_TS_RESUME);
+        break;
+    case PSF_EVENT_ISR_BEGIN:
+        if (core != NULL) {
+            core_account(analysis, core);
+            core->isr_depth++;
+        }
+        break;
+    case PSF_EVENT_ISR_RESUME:
+        // Returning from a nested ISR to the ISR it interrupted
+        if (core != NULL) {
+            core_account(analysis, core);
+            core->isr_depth = (core->isr_depth > 1) ? core->isr_depth - 1 : 1;
+        }
+        break;
+    case PSF_EVENT_MUTEX_TAKE:
+        if ((obj = find_object(analysis, handle)) != NULL) {
+            obj->is_mutex = true;
+            obj->held = true;
+            obj->take_time = analysis->time;
+        }
+        break;
+    case PSF_EVENT_MUTEX_GIVE:
+        if ((obj = find_object(analysis, handle)) != NULL && obj->held) {
+            histogram_add(&obj->hold_time, analysis->time - obj->take_time,
+                          analysis->frequency);
+            obj->held = false;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static double ticks_to_us(const psf_analysis_t *analysis, uint64_t ticks)
+{
+    return ((double)ticks * 1e6) / analysis->frequency;
+}
+
+static void write_json_string(FILE *file, const char *str)
+{
+    fputc('"', file);
+
+    for (; *str != '\0'; str++) {
+        unsigned char c = (unsigned char)*str;
+
+        if (c == '"' || c == '\\')
+            fprintf(file, "\\%c", c);
+        else if (c < 0x20 || c >= 0x7F)
+            fprintf(file, "\\u%04x", c);
+        else
+            fputc(c, file);
+    }
+
+    fputc('"', file);
+}
+
+static void write_json_histogram(const psf_analysis_t *analysis, FILE *file,
+                                 const char *key, const psf_histogram_t *hist,
+                                 const char *indent)
+{
+    fprintf(file, "%s\"%s\": {\n", indent, key);
+    fprintf(file, "%s  \"count\": %llu,\n", indent,
+            (unsigned long long)hist->count);
+    fprintf(file, "%s  \"min_us\": %.3f,\n", indent,
+            ticks_to_us(analysis, hist->min));
+    fprintf(file, "%s  \"mean_us\": %.3f,\n", indent,
+            (hist->count > 0) ?
+                ticks_to_us(analysis, hist->total) / hist->count : 0.0);
+    fprintf(file, "%s  \"max_us\": %.3f,\n", indent,
+            ticks_to_us(analysis, hist->max));
+    fprintf(file, "%s  \"bucket_upper_bounds_us\": [", indent);
+    for (int i = 0; i < PSF_HISTOGRAM_BUCKETS - 1; i++)
+        fprintf(file, "%s%llu", (i > 0) ? ", " : "", 1ull << i);
+    fprintf(file, "],\n");
+    fprintf(file, "%s  \"bucket_counts\": [", indent);
+    for (int i = 0; i < PSF_HISTOGRAM_BUCKETS; i++)
+        fprintf(file, "%s%llu", (i > 0) ? ", " : "",
+                (unsigned long long)hist->buckets[i]);
+    fprintf(file, "]\n");
+    fprintf(file, "%s}", indent);
+}
+
+int psf_analysis_write_json(psf_analysis_t *analysis, FILE *file)
+{
+    const uint64_t duration = analysis->time - analysis->first_time;
+    bool first;
+
+    for (uint32_t i = 0; i < analysis->num_cores; i++) {
+        if (analysis->cores[i].active)
+            core_account(analysis, &analysis->cores[i]);
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"timestamp_frequency_hz\": %u,\n", analysis->frequency);
+    fprintf(file, "  \"duration_us\": %.3f,\n", ticks_to_us(analysis, duration));
+    fprintf(file, "  \"events\": %llu,\n",
+            (unsigned long long)analysis->events);
+
+    fprintf(file, "  \"cores\": [");
+    for (uint32_t i = 0; i < analysis->num_cores; i++) {
+        const psf_core_t *core = &analysis->cores[i];
+        const uint64_t observed = core->active ? (core->since - core->first) : 0;
+        const uint64_t busy = core->task_ticks + core->isr_ticks;
+
+        fprintf(file, "%s\n    {\n", (i > 0) ? "," : "");
+        fprintf(file, "      \"core\": %u,\n", i);
+        fprintf(file, "      \"observed_us\": %.3f,\n",
+                ticks_to_us(analysis, observed));
+        fprintf(file, "      \"task_us\": %.3f,\n",
+                ticks_to_us(analysis, core->task_ticks));
+        fprintf(file, "      \"isr_us\": %.3f,\n",
+                ticks_to_us(analysis, core->isr_ticks));
+        fprintf(file, "      \"idle_us\": %.3f,\n",
+                ticks_to_us(analysis, core->idle_ticks));
+        fprintf(file, "      \"utilisation\": %.6f\n",
+                (observed > 0) ? (double)busy / observed : 0.0);
+        fprintf(file, "    }");
+    }
+    fprintf(file, "\n  ],\n");
+
+    fprintf(file, "  \"tasks\": [");
+    first = true;
+    for (size_t i = 0; i < analysis->num_objects; i++) {
+        const psf_object_t *task = &analysis->objects[i];
+
+        if (!task->is_task)
+            continue;
+
+        fprintf(file, "%s\n    {\n", first ? "" : ",");
+        fprintf(file, "      \"name\": ");
+        write_json_string(file, task->name);
+        fprintf(file, ",\n      \"handle\": \"0x%08X\",\n", task->handle);
+        fprintf(file, "      \"idle\": %s,\n",
+                is_idle_task(task) ? "true" : "false");
+        fprintf(file, "      \"run_time_us\": %.3f,\n",
+                ticks_to_us(analysis, task->run_ticks));
+        fprintf(file, "      \"activations\": %llu,\n",
+                (unsigned long long)task->activations);
+        write_json_histogram(analysis, file, "ready_latency",
+                             &task->ready_latency, "      ");
+        fprintf(file, "\n    }");
+        first = false;
+    }
+    fprintf(file, "\n  ],\n");
+
+    fprintf(file, "  \"mutexes\": [");
+    first = true;
+    for (size_t i = 0; i < analysis->num_objects; i++) {
+        const psf_object_t *mutex = &analysis->objects[i];
+
+        if (!mutex->is_mutex)
+            continue;
+
+        fprintf(file, "%s\n    {\n", first ? "" : ",");
+        fprintf(file, "      \"name\": ");
+        write_json_string(file, mutex->name);
+        fprintf(file, ",\n      \"handle\": \"0x%08X\",\n", mutex->handle);
+        write_json_histogram(analysis, file, "hold_time",
+                             &mutex->hold_time, "      ");
+        fprintf(file, "\n    }");
+        first = false;
+    }
+    fprintf(file, "\n  ]\n");
+    fprintf(file, "}\n");
+
+    return ferror(file) ? -1 : 0;
+}
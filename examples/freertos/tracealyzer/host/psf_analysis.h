@@ -0,0 +1,114 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef PSF_ANALYSIS_H_
+#define PSF_ANALYSIS_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Headless analysis of the Tracealyzer PSF stream, for use where the
+ * Tracealyzer GUI is not available (e.g. CI). The task switch, ISR, ready
+ * and mutex events are replayed to produce:
+ *
+ * - per-core utilisation (time not spent in an idle task),
+ * - per-task run time and activation count,
+ * - per-task ready to running latency histograms,
+ * - per-mutex hold time histograms.
+ *
+ * Histograms use power of two buckets in microseconds: bucket 0 counts values
+ * below 1 us, bucket k values below 2^k us, and the last bucket everything
+ * larger.
+ */
+
+#define PSF_HISTOGRAM_BUCKETS   22
+#define PSF_NAME_MAX_BYTES      32
+
+typedef struct psf_histogram {
+    uint64_t count;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[PSF_HISTOGRAM_BUCKETS];
+} psf_histogram_t;
+
+/*
+ * A traced object: a task, ISR or mutex, as identified by its handle.
+ */
+typedef struct psf_object {
+    uint32_t handle;
+    char name[PSF_NAME_MAX_BYTES];
+    bool is_task;
+    bool is_mutex;
+
+    // Task state
+    uint64_t run_ticks;
+    uint64_t activations;
+    bool ready_pending;
+    uint64_t ready_time;
+    psf_histogram_t ready_latency;
+
+    // Mutex state
+    bool held;
+    uint64_t take_time;
+    psf_histogram_t hold_time;
+} psf_object_t;
+
+typedef struct psf_core {
+    bool active;            /* The running context is known */
+    int task;               /* Index of the running task, or -1 */
+    uint32_t isr_depth;
+    uint64_t since;         /* When the running context was last accounted */
+    uint64_t first;
+    uint64_t idle_ticks;
+    uint64_t task_ticks;
+    uint64_t isr_ticks;
+} psf_core_t;
+
+typedef struct psf_analysis {
+    uint32_t frequency;
+    uint32_t num_cores;
+    psf_core_t *cores;
+
+    psf_object_t *objects;
+    size_t num_objects;
+    size_t cap_objects;
+    int32_t *lookup;        /* Open addressed hash of handle to object index */
+    size_t lookup_size;
+
+    bool have_time;
+    uint32_t last_raw_time;
+    uint64_t time;          /* Extended to 64 bits across wraparounds */
+    uint64_t first_time;
+    uint64_t events;
+} psf_analysis_t;
+
+void psf_analysis_init(psf_analysis_t *analysis);
+
+void psf_analysis_deinit(psf_analysis_t *analysis);
+
+/* Returns -1 if the per-core state could not be allocated. */
+int psf_analysis_header(psf_analysis_t *analysis, uint32_t num_cores);
+
+void psf_analysis_timestamp(psf_analysis_t *analysis, uint32_t frequency);
+
+/*
+ * Records the name of an entry table (symbol table) entry.
+ */
+void psf_analysis_entry(psf_analysis_t *analysis, const uint8_t *entry,
+                        int length, uint32_t state_count,
+                        uint32_t symbol_length);
+
+void psf_analysis_event(psf_analysis_t *analysis, const uint8_t *event,
+                        int length);
+
+/*
+ * Closes out the running contexts at the time of the last event and writes
+ * the report. Returns 0 on success or -1 on a write error.
+ */
+int psf_analysis_write_json(psf_analysis_t *analysis, FILE *file);
+
+#endif /* PSF_ANALYSIS_H_ */
@@ -0,0 +1,129 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdlib.h>
+#include <string.h>
+#include "os_port.h"
+#include "spsc_ring.h"
+
+/*
+ * Each record is stored as a 32-bit length followed by the payload, padded
+ * to keep the next length word aligned. A record never straddles the end of
+ * the buffer; if it does not fit, the remaining space is skipped using a
+ * wrap marker in place of the length.
+ */
+#define RECORD_HEADER_BYTES     sizeof(uint32_t)
+#define RECORD_WRAP_MARKER      0xFFFFFFFFu
+#define RECORD_SLOT_BYTES(len)  (RECORD_HEADER_BYTES + (((len) + 3) & ~3u))
+
+int spsc_ring_init(spsc_ring_t *ring, size_t capacity)
+{
+    size_t size = 1024;
+
+    while (size < capacity)
+        size <<= 1;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->buf = malloc(size);
+
+    if (ring->buf == NULL)
+        return -1;
+
+    ring->capacity = size;
+    return 0;
+}
+
+void spsc_ring_deinit(spsc_ring_t *ring)
+{
+    free(ring->buf);
+    memset(ring, 0, sizeof(*ring));
+}
+
+bool spsc_ring_push(spsc_ring_t *ring, const void *data, uint32_t length)
+{
+    return spsc_ring_push_parts(ring, NULL, 0, data, length);
+}
+
+bool spsc_ring_push_parts(spsc_ring_t *ring, const void *prefix,
+                          uint32_t prefix_length, const void *data,
+                          uint32_t data_length)
+{
+    const uint32_t wrap_marker = RECORD_WRAP_MARKER;
+    const uint32_t length = prefix_length + data_length;
+    const size_t slot = RECORD_SLOT_BYTES(length);
+    size_t head = ring->head;
+    size_t tail = os_atomic_load_acquire(&ring->tail);
+    size_t offset = head & (ring->capacity - 1);
+    size_t to_end = ring->capacity - offset;
+    size_t needed = (slot <= to_end) ? slot : (to_end + slot);
+
+    if (slot > (ring->capacity >> 1) ||
+        (ring->capacity - (head - tail)) < needed) {
+        ring->drops++;
+        ring->dropped_bytes += length;
+        return false;
+    }
+
+    if (slot > to_end) {
+        memcpy(&ring->buf[offset], &wrap_marker, RECORD_HEADER_BYTES);
+        head += to_end;
+        offset = 0;
+    }
+
+    memcpy(&ring->buf[offset], &length, RECORD_HEADER_BYTES);
+    if (prefix_length > 0)
+        memcpy(&ring->buf[offset + RECORD_HEADER_BYTES], prefix, prefix_length);
+    memcpy(&ring->buf[offset + RECORD_HEADER_BYTES + prefix_length], data,
+           data_length);
+    head += slot;
+
+    if ((head - tail) > ring->high_water)
+        ring->high_water = head - tail;
+
+    os_atomic_store_release(&ring->head, head);
+    return true;
+}
+
+uint8_t *spsc_ring_peek(spsc_ring_t *ring, uint32_t *length)
+{
+    size_t tail = ring->tail;
+    size_t head = os_atomic_load_acquire(&ring->head);
+    size_t offset = tail & (ring->capacity - 1);
+    uint32_t len;
+
+    if (tail == head)
+        return NULL;
+
+    memcpy(&len, &ring->buf[offset], RECORD_HEADER_BYTES);
+
+    if (len == RECORD_WRAP_MARKER) {
+        tail += ring->capacity - offset;
+        os_atomic_store_release(&ring->tail, tail);
+
+        if (tail == head)
+            return NULL;
+
+        offset = 0;
+        memcpy(&len, &ring->buf[offset], RECORD_HEADER_BYTES);
+    }
+
+    *length = len;
+    return &ring->buf[offset + RECORD_HEADER_BYTES];
+}
+
+void spsc_ring_pop(spsc_ring_t *ring)
+{
+    size_t tail = ring->tail;
+    uint32_t len;
+
+    memcpy(&len, &ring->buf[tail & (ring->capacity - 1)], RECORD_HEADER_BYTES);
+    os_atomic_store_release(&ring->tail, tail + RECORD_SLOT_BYTES(len));
+}
+
+size_t spsc_ring_used(spsc_ring_t *ring)
+{
+    size_t tail = os_atomic_load_acquire(&ring->tail);
+    size_t head = os_atomic_load_acquire(&ring->head);
+
+    return head - tail;
+}
@@ -0,0 +1,65 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A bounded, lock-free queue of variable length records for exactly one
+ * producer thread and one consumer thread.
+ *
+ * Records are stored contiguously, so the consumer may process a record in
+ * place (including modifying it) between spsc_ring_peek() and
+ * spsc_ring_pop().
+ */
+typedef struct spsc_ring {
+    uint8_t *buf;
+    size_t capacity;
+
+    size_t head;                    /* Written by the producer only */
+    size_t tail;                    /* Written by the consumer only */
+
+    /* Statistics, written by the producer only */
+    size_t high_water;
+    unsigned long long drops;
+    unsigned long long dropped_bytes;
+} spsc_ring_t;
+
+/*
+ * The capacity is rounded up to a power of two. Records larger than half of
+ * the capacity are always rejected.
+ */
+int spsc_ring_init(spsc_ring_t *ring, size_t capacity);
+
+void spsc_ring_deinit(spsc_ring_t *ring);
+
+/*
+ * Producer side. Copies a record into the ring. If there is not enough free
+ * space the record is dropped, counted, and false is returned.
+ */
+bool spsc_ring_push(spsc_ring_t *ring, const void *data, uint32_t length);
+
+/*
+ * As spsc_ring_push(), but the record is formed from a prefix followed by
+ * the data, avoiding an intermediate copy.
+ */
+bool spsc_ring_push_parts(spsc_ring_t *ring, const void *prefix,
+                          uint32_t prefix_length, const void *data,
+                          uint32_t data_length);
+
+/*
+ * Consumer side. Returns the oldest record, or NULL if the ring is empty.
+ * The record remains valid until spsc_ring_pop() is called.
+ */
+uint8_t *spsc_ring_peek(spsc_ring_t *ring, uint32_t *length);
+
+void spsc_ring_pop(spsc_ring_t *ring);
+
+/* The number of bytes currently queued. Safe to call from any thread. */
+size_t spsc_ring_used(spsc_ring_t *ring);
+
+#endif /* SPSC_RING_H_ */
@@ -0,0 +1,359 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdlib.h>
+#include <string.h>
+#include "trace_capture.h"
+
+#define CAPTURE_MAGIC           "XTRC"
+#define CAPTURE_FOOTER_MAGIC    "XTRE"
+#define CAPTURE_VERSION         1
+#define CAPTURE_HEADER_BYTES    16
+#define CAPTURE_FOOTER_BYTES    16
+#define CAPTURE_LENGTH_BYTES    4
+#define CAPTURE_RECORD_BYTES    (CAPTURE_LENGTH_BYTES + 8)
+#define CAPTURE_BLOCK_BYTES     16
+#define CAPTURE_ENTRY_BYTES     16
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void put_u64(uint8_t *p, uint64_t v)
+{
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static uint64_t get_u64(const uint8_t *p)
+{
+    return get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static int write_bytes(capture_writer_t *writer, const void *data, size_t len)
+{
+    if (fwrite(data, 1, len, writer->file) != len)
+        return -1;
+
+    writer->offset += len;
+    return 0;
+}
+
+static int write_index_block(capture_writer_t *writer)
+{
+    uint8_t buf[CAPTURE_LENGTH_BYTES + CAPTURE_BLOCK_BYTES +
+                CAPTURE_INDEX_BLOCK_ENTRIES * CAPTURE_ENTRY_BYTES];
+    uint32_t size = CAPTURE_BLOCK_BYTES +
+                    writer->num_entries * CAPTURE_ENTRY_BYTES;
+    uint64_t block_offset = writer->offset;
+    uint8_t *p = buf;
+
+    if (writer->num_entries == 0)
+        return 0;
+
+    put_u32(p, CAPTURE_INDEX_FLAG | size);
+    put_u64(p + 4, writer->last_index_offset);
+    put_u32(p + 12, writer->num_entries);
+    put_u32(p + 16, 0);
+    p += CAPTURE_LENGTH_BYTES + CAPTURE_BLOCK_BYTES;
+
+    for (uint32_t i = 0; i < writer->num_entries; i++) {
+        put_u64(p, writer->entries[i].timestamp);
+        put_u64(p + 8, writer->entries[i].offset);
+        p += CAPTURE_ENTRY_BYTES;
+    }
+
+    if (write_bytes(writer, buf, p - buf) != 0)
+        return -1;
+
+    writer->last_index_offset = block_offset;
+    writer->total_entries += writer->num_entries;
+    writer->num_entries = 0;
+    return 0;
+}
+
+int capture_writer_init(capture_writer_t *writer, FILE *file)
+{
+    uint8_t header[CAPTURE_HEADER_BYTES];
+
+    memset(writer, 0, sizeof(*writer));
+    writer->file = file;
+
+    memcpy(header, CAPTURE_MAGIC, 4);
+    put_u16(&header[4], CAPTURE_VERSION);
+    put_u16(&header[6], CAPTURE_HEADER_BYTES);
+    put_u32(&header[8], CAPTURE_INDEX_INTERVAL);
+    put_u32(&header[12], 0);
+
+    return write_bytes(writer, header, sizeof(header));
+}
+
+int capture_writer_write(capture_writer_t *writer, uint64_t timestamp,
+                         const uint8_t *data, uint32_t length)
+{
+    uint8_t header[CAPTURE_RECORD_BYTES];
+    uint64_t record_offset = writer->offset;
+
+    if (length & CAPTURE_INDEX_FLAG)
+        return -1;
+
+    put_u32(header, length);
+    put_u64(&header[4], timestamp);
+
+    if (write_bytes(writer, header, sizeof(header)) != 0 ||
+        write_bytes(writer, data, length) != 0)
+        return -1;
+
+    if ((writer->records++ % CAPTURE_INDEX_INTERVAL) == 0) {
+        capture_index_entry_t *entry = &writer->entries[writer->num_entries++];
+
+        entry->timestamp = timestamp;
+        entry->offset = record_offset;
+
+        if (writer->num_entries == CAPTURE_INDEX_BLOCK_ENTRIES)
+            return write_index_block(writer);
+    }
+
+    return 0;
+}
+
+int capture_writer_finish(capture_writer_t *writer)
+{
+    uint8_t footer[CAPTURE_FOOTER_BYTES];
+
+    if (write_index_block(writer) != 0)
+        return -1;
+
+    put_u64(footer, writer->last_index_offset);
+    put_u32(&footer[8], writer->total_entries);
+    memcpy(&footer[12], CAPTURE_FOOTER_MAGIC, 4);
+
+    return write_bytes(writer, footer, sizeof(footer));
+}
+
+bool capture_is_capture(const void *data, size_t size)
+{
+    return size >= CAPTURE_HEADER_BYTES &&
+           memcmp(data, CAPTURE_MAGIC, 4) == 0;
+}
+
+/*
+ * Loads the index by following the chain of index blocks back from the
+ * footer. Returns false if the footer or any block is inconsistent.
+ */
+static bool load_index_from_footer(capture_reader_t *reader, size_t size)
+{
+    const uint8_t *footer = &reader->data[size - CAPTURE_FOOTER_BYTES];
+    uint64_t offset = get_u64(footer);
+    size_t remaining = get_u32(&footer[8]);
+
+    if (memcmp(&footer[12], CAPTURE_FOOTER_MAGIC, 4) != 0)
+        return false;
+
+    reader->data_end = size - CAPTURE_FOOTER_BYTES;
+    reader->index_len = remaining;
+    reader->index = calloc(remaining > 0 ? remaining : 1,
+                           sizeof(capture_index_entry_t));
+
+    if (reader->index == NULL)
+        return false;
+
+    while (remaining > 0) {
+        const uint8_t *block;
+        uint32_t word;
+        uint32_t count;
+
+        if (offset < reader->data_begin ||
+            offset + CAPTURE_LENGTH_BYTES + CAPTURE_BLOCK_BYTES >
+                    reader->data_end)
+            return false;
+
+        block = &reader->data[offset];
+        word = get_u32(block);
+        count = get_u32(&block[12]);
+
+        if (!(word & CAPTURE_INDEX_FLAG) || count > remaining ||
+            (word & ~CAPTURE_INDEX_FLAG) !=
+                    CAPTURE_BLOCK_BYTES + count * CAPTURE_ENTRY_BYTES ||
+            offset + CAPTURE_LENGTH_BYTES + (word & ~CAPTURE_INDEX_FLAG) >
+                    reader->data_end)
+            return false;
+
+        remaining -= count;
+        block += CAPTURE_LENGTH_BYTES + CAPTURE_BLOCK_BYTES;
+
+        for (uint32_t i = 0; i < count; i++) {
+            reader->index[remaining + i].timestamp =
+                    get_u64(&block[i * CAPTURE_ENTRY_BYTES]);
+            reader->index[remaining + i].offset =
+                    get_u64(&block[i * CAPTURE_ENTRY_BYTES + 8]);
+        }
+
+        offset = get_u64(&reader->data[offset + 4]);
+    }
+
+    return true;
+}
+
+/*
+ * Loads the index by walking every record. Used when the footer is missing,
+ * in which case the capture ends at the last complete record.
+ */
+static bool load_index_by_scanning(capture_reader_t *reader, size_t size)
+{
+    size_t pos = reader->data_begin;
+    size_t cap = 0;
+
+    free(reader->index);
+    reader->index = NULL;
+    reader->index_len = 0;
+
+    while (pos + CAPTURE_LENGTH_BYTES <= size) {
+        uint32_t word = get_u32(&reader->data[pos]);
+        uint32_t len = word & ~CAPTURE_INDEX_FLAG;
+
+        if (!(word & CAPTURE_INDEX_FLAG)) {
+            if (pos + CAPTURE_RECORD_BYTES + len > size)
+                break;
+
+            pos += CAPTURE_RECORD_BYTES + len;
+            continue;
+        }
+
+        if (len < CAPTURE_BLOCK_BYTES ||
+            pos + CAPTURE_LENGTH_BYTES + len > size)
+            break;
+
+        const uint8_t *block = &reader->data[pos + CAPTURE_LENGTH_BYTES];
+        uint32_t count = get_u32(&block[8]);
+
+        if (CAPTURE_BLOCK_BYTES + (size_t)count * CAPTURE_ENTRY_BYTES > len)
+            break;
+
+        if (reader->index_len + count > cap) {
+            size_t new_cap = (cap > 0) ? cap * 2 : CAPTURE_INDEX_BLOCK_ENTRIES;
+            capture_index_entry_t *index;
+
+            while (new_cap < reader->index_len + count)
+                new_cap *= 2;
+
+            index = realloc(reader->index,
+                            new_cap * sizeof(capture_index_entry_t));
+            if (index == NULL)
+                return false;
+
+            reader->index = index;
+            cap = new_cap;
+        }
+
+        block += CAPTURE_BLOCK_BYTES;
+
+        for (uint32_t i = 0; i < count; i++) {
+            capture_index_entry_t *entry = &reader->index[reader->index_len++];
+
+            entry->timestamp = get_u64(&block[i * CAPTURE_ENTRY_BYTES]);
+            entry->offset = get_u64(&block[i * CAPTURE_ENTRY_BYTES + 8]);
+        }
+
+        pos += CAPTURE_LENGTH_BYTES + len;
+    }
+
+    reader->data_end = pos;
+    return true;
+}
+
+int capture_reader_open(capture_reader_t *reader, const void *data,
+                        size_t size)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->data = data;
+
+    if (!capture_is_capture(data, size) ||
+        get_u16(&reader->data[4]) != CAPTURE_VERSION ||
+        get_u16(&reader->data[6]) < CAPTURE_HEADER_BYTES ||
+        get_u16(&reader->data[6]) > size)
+        return -1;
+
+    reader->data_begin = get_u16(&reader->data[6]);
+    reader->pos = reader->data_begin;
+
+    if (size >= reader->data_begin + CAPTURE_FOOTER_BYTES &&
+        load_index_from_footer(reader, size))
+        return 0;
+
+    if (!load_index_by_scanning(reader, size)) {
+        capture_reader_close(reader);
+        return -1;
+    }
+
+    return 0;
+}
+
+void capture_reader_close(capture_reader_t *reader)
+{
+    free(reader->index);
+    memset(reader, 0, sizeof(*reader));
+}
+
+void capture_reader_seek(capture_reader_t *reader, uint64_t timestamp)
+{
+    size_t lo = 0;
+    size_t hi = reader->index_len;
+
+    /* Find the first entry at or after the requested timestamp; every record
+     * before the entry preceding it is then known to be too early. */
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+
+        if (reader->index[mid].timestamp < timestamp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    reader->pos = (lo > 0) ? (size_t)reader->index[lo - 1].offset :
+                             reader->data_begin;
+}
+
+bool capture_reader_next(capture_reader_t *reader, capture_record_t *record)
+{
+    while (reader->pos + CAPTURE_LENGTH_BYTES <= reader->data_end) {
+        const uint8_t *p = &reader->data[reader->pos];
+        uint32_t word = get_u32(p);
+        uint32_t len = word & ~CAPTURE_INDEX_FLAG;
+
+        if (word & CAPTURE_INDEX_FLAG) {
+            reader->pos += CAPTURE_LENGTH_BYTES + len;
+            continue;
+        }
+
+        if (reader->pos + CAPTURE_RECORD_BYTES + len > reader->data_end)
+            break;
+
+        record->timestamp = get_u64(&p[4]);
+        record->data = &p[CAPTURE_RECORD_BYTES];
+        record->length = len;
+        reader->pos += CAPTURE_RECORD_BYTES + len;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,120 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef TRACE_CAPTURE_H_
+#define TRACE_CAPTURE_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A compact binary capture of the raw Tracealyzer records received on the
+ * xscope probe, used in place of VCD for long captures.
+ *
+ * All values are little endian. The file starts with a 16 byte header:
+ *
+ *   "XTRC" | u16 version | u16 header size | u32 index interval | u32 0
+ *
+ * followed by records, each starting with a u32 length word:
+ *
+ *   data record:  u32 length | u64 timestamp | payload[length]
+ *   index block:  u32 (CAPTURE_INDEX_FLAG | size) | u64 previous block offset |
+ *                 u32 count | u32 0 | count * (u64 timestamp | u64 offset)
+ *
+ * Every `index interval` data records, the timestamp and file offset of the
+ * next data record are added to the index. Index blocks are written
+ * periodically, each pointing back at the one before it. A 16 byte footer
+ * locates the last index block so the whole index can be loaded without
+ * reading the data:
+ *
+ *   u64 last index block offset | u32 number of index entries | "XTRE"
+ *
+ * If the capture was interrupted the footer is missing and the index blocks
+ * are found by walking the records instead.
+ *
+ * Timestamps are those provided by the xscope endpoint, in nanoseconds.
+ */
+
+#define CAPTURE_INDEX_FLAG          0x80000000u
+
+/* The number of data records between index entries */
+#define CAPTURE_INDEX_INTERVAL      1024
+
+/* The number of index entries accumulated before an index block is written */
+#define CAPTURE_INDEX_BLOCK_ENTRIES 64
+
+typedef struct capture_index_entry {
+    uint64_t timestamp;
+    uint64_t offset;
+} capture_index_entry_t;
+
+typedef struct capture_writer {
+    FILE *file;
+    uint64_t offset;
+    uint64_t records;
+    uint64_t last_index_offset;
+    uint32_t total_entries;
+    uint32_t num_entries;
+    capture_index_entry_t entries[CAPTURE_INDEX_BLOCK_ENTRIES];
+} capture_writer_t;
+
+typedef struct capture_record {
+    uint64_t timestamp;
+    const uint8_t *data;
+    uint32_t length;
+} capture_record_t;
+
+/*
+ * A reader over a capture held in memory, such as a vcd_map_t of the file.
+ */
+typedef struct capture_reader {
+    const uint8_t *data;
+    size_t data_begin;
+    size_t data_end;
+    size_t pos;
+    capture_index_entry_t *index;
+    size_t index_len;
+} capture_reader_t;
+
+/*
+ * Writes the capture header to an open, empty file. Returns 0 on success or
+ * -1 on a write error.
+ */
+int capture_writer_init(capture_writer_t *writer, FILE *file);
+
+int capture_writer_write(capture_writer_t *writer, uint64_t timestamp,
+                         const uint8_t *data, uint32_t length);
+
+/*
+ * Writes any pending index entries and the footer. The file is not closed.
+ */
+int capture_writer_finish(capture_writer_t *writer);
+
+/* Returns true if the buffer starts with a capture header. */
+bool capture_is_capture(const void *data, size_t size);
+
+/*
+ * Validates the header and loads the index. Returns 0 on success or -1 if
+ * the data is not a capture or the index could not be allocated.
+ */
+int capture_reader_open(capture_reader_t *reader, const void *data,
+                        size_t size);
+
+void capture_reader_close(capture_reader_t *reader);
+
+/*
+ * Positions the reader at the last indexed record with a timestamp before the
+ * given one, so that the first record at or after the timestamp is reached by
+ * reading forward at most CAPTURE_INDEX_INTERVAL records.
+ */
+void capture_reader_seek(capture_reader_t *reader, uint64_t timestamp);
+
+/*
+ * Reads the next data record, skipping index blocks. Returns false at the end
+ * of the capture. The record data points into the capture buffer.
+ */
+bool capture_reader_next(capture_reader_t *reader, capture_record_t *record);
+
+#endif /* TRACE_CAPTURE_H_ */
@@ -0,0 +1,121 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+#include "trace_snapshot.h"
+
+#define SNAPSHOT_MAGIC              "XTSN"
+#define SNAPSHOT_VERSION            1
+#define SNAPSHOT_HEADER_BYTES       48
+#define SNAPSHOT_EVENT_HEADER_BYTES 8
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static bool parse_header(trace_snapshot_t *snapshot, const uint8_t *p,
+                         size_t avail)
+{
+    uint16_t header_size;
+
+    if (avail < SNAPSHOT_HEADER_BYTES || memcmp(p, SNAPSHOT_MAGIC, 4) != 0 ||
+        get_u16(&p[4]) != SNAPSHOT_VERSION)
+        return false;
+
+    header_size = get_u16(&p[6]);
+    snapshot->reason = get_u32(&p[8]);
+    snapshot->num_cores = get_u32(&p[12]);
+    snapshot->metadata_len = get_u32(&p[16]);
+    snapshot->events_len = get_u32(&p[20]);
+    snapshot->dropped_events = get_u32(&p[24]);
+    snapshot->overwritten_events = get_u32(&p[28]);
+    snapshot->dropped_metadata = get_u32(&p[32]);
+    snapshot->commits = get_u32(&p[36]);
+    snapshot->commit_ticks_max = get_u32(&p[40]);
+    snapshot->commit_ticks_mean = get_u32(&p[44]);
+
+    if (header_size < SNAPSHOT_HEADER_BYTES ||
+        snapshot->metadata_len > avail - header_size ||
+        snapshot->events_len > avail - header_size - snapshot->metadata_len)
+        return false;
+
+    snapshot->metadata = &p[header_size];
+    snapshot->events = &p[header_size + snapshot->metadata_len];
+    return true;
+}
+
+int snapshot_open(trace_snapshot_t *snapshot, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    for (size_t offset = 0; offset + SNAPSHOT_HEADER_BYTES <= size;
+         offset += SNAPSHOT_SECTOR_BYTES) {
+        if (parse_header(snapshot, &bytes[offset], size - offset)) {
+            snapshot->offset = offset;
+            return 0;
+        }
+    }
+
+    memset(snapshot, 0, sizeof(*snapshot));
+    return -1;
+}
+
+const char *snapshot_reason_name(uint32_t reason)
+{
+    switch (reason) {
+    case SNAPSHOT_REASON_ASSERT:
+        return "assert";
+    case SNAPSHOT_REASON_WATCHDOG:
+        return "watchdog";
+    case SNAPSHOT_REASON_USER:
+        return "user";
+    default:
+        return "unknown";
+    }
+}
+
+bool snapshot_next_metadata(const trace_snapshot_t *snapshot, size_t *pos,
+                            const uint8_t **record, uint32_t *length)
+{
+    uint32_t len;
+
+    if (*pos + 2 > snapshot->metadata_len)
+        return false;
+
+    len = get_u16(&snapshot->metadata[*pos]);
+    if (*pos + 2 + len > snapshot->metadata_len)
+        return false;
+
+    *record = &snapshot->metadata[*pos + 2];
+    *length = len;
+    *pos += 2 + len;
+    return true;
+}
+
+bool snapshot_next_event(const trace_snapshot_t *snapshot, size_t *pos,
+                         const uint8_t **event, uint32_t *length)
+{
+    uint32_t len;
+
+    if (*pos + SNAPSHOT_EVENT_HEADER_BYTES > snapshot->events_len)
+        return false;
+
+    // The top 4 bits of the event ID give the number of 32-bit parameters
+    len = SNAPSHOT_EVENT_HEADER_BYTES +
+          4 * (snapshot->events[*pos + 1] >> 4);
+    if (*pos + len > snapshot->events_len)
+        return false;
+
+    *event = &snapshot->events[*pos];
+    *length = len;
+    *pos += len;
+    return true;
+}
@@ -0,0 +1,72 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef TRACE_SNAPSHOT_H_
+#define TRACE_SNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A post-mortem snapshot of the most recent trace events, as written to QSPI
+ * flash by the target's stream port when TRC_CFG_STREAM_PORT_SNAPSHOT is
+ * enabled (see src/trcStreamPort.h). All values are little endian:
+ *
+ *   "XTSN" | u16 version | u16 header size | u32 reason | u32 num cores |
+ *   u32 metadata bytes | u32 event bytes | u32 dropped events |
+ *   u32 overwritten events | u32 dropped metadata | u32 commits |
+ *   u32 commit ticks max | u32 commit ticks mean
+ *
+ * followed by the metadata, as records of u16 length | bytes, and then the
+ * events, each an 8 byte PSF event header and its parameters.
+ *
+ * The snapshot may be read on its own or as part of a full flash image, in
+ * which case it is found at a sector aligned offset.
+ */
+
+#define SNAPSHOT_SECTOR_BYTES       4096
+
+#define SNAPSHOT_REASON_ASSERT      1
+#define SNAPSHOT_REASON_WATCHDOG    2
+#define SNAPSHOT_REASON_USER        3
+
+typedef struct trace_snapshot {
+    size_t offset;              /* Of the snapshot within the input */
+    uint32_t reason;
+    uint32_t num_cores;
+    uint32_t dropped_events;
+    uint32_t overwritten_events;
+    uint32_t dropped_metadata;
+    uint32_t commits;
+    uint32_t commit_ticks_max;
+    uint32_t commit_ticks_mean;
+    const uint8_t *metadata;
+    size_t metadata_len;
+    const uint8_t *events;
+    size_t events_len;
+} trace_snapshot_t;
+
+/*
+ * Finds the first valid snapshot at a sector aligned offset. Returns 0 on
+ * success or -1 if there is none.
+ */
+int snapshot_open(trace_snapshot_t *snapshot, const void *data, size_t size);
+
+const char *snapshot_reason_name(uint32_t reason);
+
+/*
+ * Reads the next metadata record. pos starts at 0. Returns false at the end
+ * of the metadata or if a record is truncated.
+ */
+bool snapshot_next_metadata(const trace_snapshot_t *snapshot, size_t *pos,
+                            const uint8_t **record, uint32_t *length);
+
+/*
+ * Reads the next event. pos starts at 0. Returns false at the end of the
+ * events or if an event is truncated.
+ */
+bool snapshot_next_event(const trace_snapshot_t *snapshot, size_t *pos,
+                         const uint8_t **event, uint32_t *length);
+
+#endif /* TRACE_SNAPSHOT_H_ */
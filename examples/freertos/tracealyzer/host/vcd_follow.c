@@ -0,0 +1,141 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdlib.h>
+#include <string.h>
+#include "vcd_follow.h"
+
+#if defined(__linux__)
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+/*
+ * The initial size of the read buffer. The buffer grows if a single line
+ * does not fit.
+ */
+#define FOLLOW_BUFFER_BYTES     (1024 * 1024)
+
+int vcd_follow_open(vcd_follow_t *follow, const char *filename)
+{
+    memset(follow, 0, sizeof(*follow));
+    follow->notify_fd = -1;
+
+    follow->file = fopen(filename, "rb");
+    if (follow->file == NULL)
+        return -1;
+
+    follow->buf = malloc(FOLLOW_BUFFER_BYTES);
+    if (follow->buf == NULL) {
+        fclose(follow->file);
+        follow->file = NULL;
+        return -1;
+    }
+    follow->cap = FOLLOW_BUFFER_BYTES;
+
+#if defined(__linux__)
+    /* The watch is registered before the first read, so a write that lands
+     * between reaching the end of the file and waiting is never missed. */
+    follow->notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (follow->notify_fd >= 0 &&
+        inotify_add_watch(follow->notify_fd, filename, IN_MODIFY) < 0) {
+        close(follow->notify_fd);
+        follow->notify_fd = -1;
+    }
+#endif
+
+    return 0;
+}
+
+void vcd_follow_close(vcd_follow_t *follow)
+{
+    /* Nothing is held unless vcd_follow_open() succeeded. */
+    if (follow->file == NULL)
+        return;
+
+#if defined(__linux__)
+    if (follow->notify_fd >= 0)
+        close(follow->notify_fd);
+#endif
+
+    fclose(follow->file);
+    free(follow->buf);
+    memset(follow, 0, sizeof(*follow));
+}
+
+bool vcd_follow_read(vcd_follow_t *follow, const char **begin,
+                     const char **end)
+{
+    size_t searched;
+    size_t bytes_read;
+    size_t eol;
+
+    /* Keep only the partial line left over from the previous call. */
+    if (follow->consumed > 0) {
+        follow->len -= follow->consumed;
+        memmove(follow->buf, &follow->buf[follow->consumed], follow->len);
+        follow->consumed = 0;
+    }
+
+    if (follow->len == follow->cap) {
+        char *buf = realloc(follow->buf, follow->cap * 2);
+
+        if (buf == NULL)
+            return false;
+
+        follow->buf = buf;
+        follow->cap *= 2;
+    }
+
+    /* The held back bytes are known not to contain a line ending. */
+    searched = follow->len;
+    bytes_read = fread(&follow->buf[follow->len], 1,
+                       follow->cap - follow->len, follow->file);
+
+    /* Clear the EOF indicator so that later reads pick up appended data. */
+    if (bytes_read < follow->cap - follow->len)
+        clearerr(follow->file);
+
+    follow->len += bytes_read;
+
+    for (eol = follow->len; eol > searched; eol--) {
+        if (follow->buf[eol - 1] == '\n')
+            break;
+    }
+
+    if (eol == searched)
+        return false;
+
+    follow->consumed = eol;
+    *begin = follow->buf;
+    *end = &follow->buf[eol];
+    return true;
+}
+
+bool vcd_follow_wait(vcd_follow_t *follow, int timeout_ms)
+{
+#if defined(__linux__)
+    struct pollfd pfd = { follow->notify_fd, POLLIN, 0 };
+    char events[4096];
+    ssize_t n;
+
+    if (follow->notify_fd < 0)
+        return false;
+
+    if (poll(&pfd, 1, timeout_ms) > 0) {
+        /* Only the wakeup matters, so discard the queued events. */
+        do {
+            n = read(follow->notify_fd, events, sizeof(events));
+        } while (n > 0 || (n < 0 && errno == EINTR));
+    }
+
+    return true;
+#else
+    (void)follow;
+    (void)timeout_ms;
+    return false;
+#endif
+}
@@ -0,0 +1,55 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef VCD_FOLLOW_H_
+#define VCD_FOLLOW_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Follows a VCD file that is still being written, in the manner of
+ * `tail -f`.
+ *
+ * Data is only ever handed out as whole lines. A line which has only been
+ * partially written is held back in the buffer until the remainder arrives,
+ * so it is never decoded in two halves or read from the file a second time.
+ *
+ * On Linux, inotify is used to wait for the file to be modified. On other
+ * hosts vcd_follow_wait() returns immediately and the caller is expected to
+ * sleep instead.
+ */
+typedef struct vcd_follow {
+    FILE *file;
+    char *buf;
+    size_t cap;
+    size_t len;         /* Bytes in buf, including any partial line */
+    size_t consumed;    /* Bytes at the start of buf already handed out */
+    int notify_fd;      /* -1 if file change notification is unavailable */
+} vcd_follow_t;
+
+/*
+ * Opens the file and, where supported, registers for change notifications.
+ * Returns 0 on success or -1 if the file could not be opened.
+ */
+int vcd_follow_open(vcd_follow_t *follow, const char *filename);
+
+/* Safe to call on a zero initialized, unopened vcd_follow_t. */
+void vcd_follow_close(vcd_follow_t *follow);
+
+/*
+ * Reads any data appended to the file since the last call and returns the
+ * complete lines available in [*begin, *end). Returns false if there are no
+ * new complete lines. The lines remain valid until the next call.
+ */
+bool vcd_follow_read(vcd_follow_t *follow, const char **begin,
+                     const char **end);
+
+/*
+ * Blocks until the file is modified or timeout_ms elapses. Returns false
+ * without blocking if change notifications are not available.
+ */
+bool vcd_follow_wait(vcd_follow_t *follow, int timeout_ms);
+
+#endif /* VCD_FOLLOW_H_ */
@@ -0,0 +1,291 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "os_port.h"
+#include "vcd_reader.h"
+#include "vcd_pipeline.h"
+
+/*
+ * The input is split into chunks of approximately this size. Chunk
+ * boundaries are moved forward to the next line start, so any worker can
+ * locate the bounds of any chunk without coordination.
+ */
+#define CHUNK_BYTES             (4 * 1024 * 1024)
+
+/*
+ * The number of chunks that may be decoded ahead of the writer, per worker.
+ * This bounds the memory used by decoded data that is waiting to be written.
+ */
+#define CHUNKS_IN_FLIGHT_PER_WORKER 2
+
+#define MAX_RECORD_BYTES        2048
+
+/*
+ * Decoded records are stored back to back in a chunk's output buffer, each
+ * preceded by this header. Payloads are padded to keep headers aligned.
+ */
+typedef struct record_header {
+    int32_t line;       /* Line number relative to the start of the chunk */
+    int32_t length;     /* Payload length, or -1 for a malformed record */
+} record_header_t;
+
+#define RECORD_PADDED_LEN(len)  (((len) + 3) & ~3)
+
+typedef struct chunk_slot {
+    bool done;
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    long long lines;
+} chunk_slot_t;
+
+typedef struct pipeline {
+    const char *begin;
+    const char *end;
+    unsigned int probe;
+    size_t num_chunks;
+    size_t num_slots;
+    chunk_slot_t *slots;
+
+    os_mutex_t lock;
+    os_cond_t chunk_done;
+    os_cond_t slot_free;
+    size_t next_chunk;      /* The next chunk to be claimed by a worker */
+    size_t write_chunk;     /* The next chunk to be consumed by the writer */
+    bool abort;
+} pipeline_t;
+
+static const char *chunk_boundary(const pipeline_t *p, size_t index)
+{
+    const size_t size = p->end - p->begin;
+    const char *pos;
+
+    if (index == 0)
+        return p->begin;
+
+    if (index >= p->num_chunks || (index * (size_t)CHUNK_BYTES) >= size)
+        return p->end;
+
+    /* Start searching from the last character of the previous chunk so that
+     * a chunk which already starts on a line boundary is left unchanged. */
+    pos = p->begin + (index * (size_t)CHUNK_BYTES) - 1;
+    pos = memchr(pos, '\n', p->end - pos);
+
+    return (pos != NULL) ? pos + 1 : p->end;
+}
+
+static bool slot_reserve(chunk_slot_t *slot, size_t bytes)
+{
+    if (slot->len + bytes <= slot->cap)
+        return true;
+
+    size_t cap = (slot->cap > 0) ? slot->cap : (CHUNK_BYTES / 2);
+    while (cap < slot->len + bytes)
+        cap <<= 1;
+
+    uint8_t *buf = realloc(slot->buf, cap);
+    if (buf == NULL)
+        return false;
+
+    slot->buf = buf;
+    slot->cap = cap;
+    return true;
+}
+
+static bool slot_append(chunk_slot_t *slot, int32_t line, int32_t length,
+                        const char *hex)
+{
+    record_header_t header = { line, length };
+    size_t payload = (length > 0) ? RECORD_PADDED_LEN(length) : 0;
+
+    if (!slot_reserve(slot, sizeof(header) + payload))
+        return false;
+
+    if (length > 0 &&
+        !vcd_hex_decode(&slot->buf[slot->len + sizeof(header)], hex, length))
+        header.length = -1;
+
+    memcpy(&slot->buf[slot->len], &header, sizeof(header));
+    slot->len += sizeof(header) + ((header.length > 0) ? payload : 0);
+    return true;
+}
+
+static bool decode_chunk(const pipeline_t *p, size_t index, chunk_slot_t *slot)
+{
+    const char *pos = chunk_boundary(p, index);
+    const char *end = chunk_boundary(p, index + 1);
+    int32_t line = 0;
+
+    slot->len = 0;
+
+    while (pos < end) {
+        vcd_record_t record;
+        vcd_line_type_t type = vcd_scan_line(&pos, end, &record);
+        bool ok = true;
+
+        line++;
+
+        if (type == VCD_LINE_MALFORMED) {
+            ok = slot_append(slot, line, -1, NULL);
+        } else if (type == VCD_LINE_RECORD && record.probe == p->probe) {
+            if (record.length < 0 || record.length > MAX_RECORD_BYTES)
+                record.length = -1;
+
+            ok = slot_append(slot, line, record.length, record.hex);
+        }
+
+        if (!ok)
+            return false;
+    }
+
+    slot->lines = line;
+    return true;
+}
+
+static void worker_thread(void *arg)
+{
+    pipeline_t *p = arg;
+
+    while (1) {
+        size_t index;
+        chunk_slot_t *slot;
+        bool ok;
+
+        os_mutex_lock(&p->lock);
+        while (!p->abort && p->next_chunk < p->num_chunks &&
+               (p->next_chunk - p->write_chunk) >= p->num_slots)
+            os_cond_wait(&p->slot_free, &p->lock);
+
+        if (p->abort || p->next_chunk >= p->num_chunks) {
+            os_mutex_unlock(&p->lock);
+            break;
+        }
+
+        index = p->next_chunk++;
+        os_mutex_unlock(&p->lock);
+
+        slot = &p->slots[index % p->num_slots];
+        ok = decode_chunk(p, index, slot);
+
+        os_mutex_lock(&p->lock);
+        if (ok)
+            slot->done = true;
+        else
+            p->abort = true;
+        os_cond_broadcast(&p->chunk_done);
+        os_mutex_unlock(&p->lock);
+    }
+}
+
+/*
+ * Runs on the calling thread, delivering the decoded records of each chunk
+ * in order as soon as that chunk is complete.
+ */
+static int write_chunks(pipeline_t *p, vcd_pipeline_record_cb_t record_cb,
+                        void *ctx, long long *line_count)
+{
+    int ret = 0;
+
+    for (size_t index = 0; index < p->num_chunks && ret == 0; index++) {
+        chunk_slot_t *slot = &p->slots[index % p->num_slots];
+        size_t offset = 0;
+
+        os_mutex_lock(&p->lock);
+        while (!slot->done && !p->abort)
+            os_cond_wait(&p->chunk_done, &p->lock);
+
+        if (!slot->done) {
+            os_mutex_unlock(&p->lock);
+            return -1;
+        }
+        os_mutex_unlock(&p->lock);
+
+        while (offset < slot->len && ret == 0) {
+            record_header_t header;
+
+            memcpy(&header, &slot->buf[offset], sizeof(header));
+            offset += sizeof(header);
+
+            ret = record_cb(ctx, &slot->buf[offset], header.length,
+                            *line_count + header.line);
+
+            if (header.length > 0)
+                offset += RECORD_PADDED_LEN(header.length);
+        }
+
+        *line_count += slot->lines;
+
+        os_mutex_lock(&p->lock);
+        slot->done = false;
+        p->write_chunk++;
+        os_cond_broadcast(&p->slot_free);
+        os_mutex_unlock(&p->lock);
+    }
+
+    return ret;
+}
+
+int vcd_pipeline_run(const char *begin, const char *end,
+                     unsigned int probe, int num_workers,
+                     vcd_pipeline_record_cb_t record_cb, void *ctx,
+                     long long *line_count)
+{
+    pipeline_t p;
+    os_thread_t *workers;
+    int num_started = 0;
+    int ret;
+
+    if (num_workers < 1)
+        num_workers = 1;
+
+    memset(&p, 0, sizeof(p));
+    p.begin = begin;
+    p.end = end;
+    p.probe = probe;
+    p.num_chunks = ((end - begin) + CHUNK_BYTES - 1) / CHUNK_BYTES;
+    p.num_slots = num_workers * CHUNKS_IN_FLIGHT_PER_WORKER;
+    p.slots = calloc(p.num_slots, sizeof(chunk_slot_t));
+    workers = calloc(num_workers, sizeof(os_thread_t));
+
+    if (p.slots == NULL || workers == NULL) {
+        free(p.slots);
+        free(workers);
+        return -1;
+    }
+
+    os_mutex_init(&p.lock);
+    os_cond_init(&p.chunk_done);
+    os_cond_init(&p.slot_free);
+
+    for (; num_started < num_workers; num_started++) {
+        if (os_thread_create(&workers[num_started], worker_thread, &p) != 0)
+            break;
+    }
+
+    ret = (num_started > 0) ? write_chunks(&p, record_cb, ctx, line_count) :
+                              -1;
+
+    /* Release any workers still waiting on a slot if the writer stopped
+     * early. */
+    os_mutex_lock(&p.lock);
+    p.abort = true;
+    os_cond_broadcast(&p.slot_free);
+    os_mutex_unlock(&p.lock);
+
+    for (int i = 0; i < num_started; i++)
+        os_thread_join(workers[i]);
+
+    for (size_t i = 0; i < p.num_slots; i++)
+        free(p.slots[i].buf);
+
+    os_cond_destroy(&p.slot_free);
+    os_cond_destroy(&p.chunk_done);
+    os_mutex_destroy(&p.lock);
+    free(p.slots);
+    free(workers);
+
+    return ret;
+}
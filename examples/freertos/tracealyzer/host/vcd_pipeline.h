@@ -0,0 +1,32 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef VCD_PIPELINE_H_
+#define VCD_PIPELINE_H_
+
+/*
+ * Called in file order for every record on the selected probe.
+ * A negative length indicates that the record on the given line could not
+ * be decoded. Returning non-zero stops the pipeline; the value is passed back
+ * to the caller of vcd_pipeline_run().
+ */
+typedef int (*vcd_pipeline_record_cb_t)(void *ctx, unsigned char *bytes,
+                                        int length, long long line);
+
+/*
+ * Decodes the VCD records in [begin, end) using num_workers threads while the
+ * calling thread invokes record_cb for each record in the original order.
+ *
+ * begin must point at the start of a line following the VCD header.
+ * *line_count holds the number of lines preceding begin on entry and the
+ * total number of lines processed on return.
+ *
+ * Returns 0 on success, -1 on resource allocation failure, or the non-zero
+ * value returned by record_cb.
+ */
+int vcd_pipeline_run(const char *begin, const char *end,
+                     unsigned int probe, int num_workers,
+                     vcd_pipeline_record_cb_t record_cb, void *ctx,
+                     long long *line_count);
+
+#endif /* VCD_PIPELINE_H_ */
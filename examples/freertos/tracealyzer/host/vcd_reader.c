@@ -0,0 +1,268 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vcd_reader.h"
+
+#if defined(_WIN32)
+#define VCD_MAP_USE_MMAP        0
+#else
+#define VCD_MAP_USE_MMAP        1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define VCD_HEX_USE_SSE2        1
+#include <emmintrin.h>
+#else
+#define VCD_HEX_USE_SSE2        0
+#endif
+
+/*
+ * Lookup table for converting a single hex character into its nibble value.
+ * Valid entries have bit 4 set so that invalid characters (0) can be detected
+ * without a second table.
+ */
+#define HEX_VALID               0x10
+#define HEX_NIBBLE_MASK         0x0F
+
+static const uint8_t hex_lut[256] = {
+    ['0'] = HEX_VALID | 0x0, ['1'] = HEX_VALID | 0x1, ['2'] = HEX_VALID | 0x2,
+    ['3'] = HEX_VALID | 0x3, ['4'] = HEX_VALID | 0x4, ['5'] = HEX_VALID | 0x5,
+    ['6'] = HEX_VALID | 0x6, ['7'] = HEX_VALID | 0x7, ['8'] = HEX_VALID | 0x8,
+    ['9'] = HEX_VALID | 0x9,
+    ['a'] = HEX_VALID | 0xA, ['b'] = HEX_VALID | 0xB, ['c'] = HEX_VALID | 0xC,
+    ['d'] = HEX_VALID | 0xD, ['e'] = HEX_VALID | 0xE, ['f'] = HEX_VALID | 0xF,
+    ['A'] = HEX_VALID | 0xA, ['B'] = HEX_VALID | 0xB, ['C'] = HEX_VALID | 0xC,
+    ['D'] = HEX_VALID | 0xD, ['E'] = HEX_VALID | 0xE, ['F'] = HEX_VALID | 0xF,
+};
+
+int vcd_map_open(vcd_map_t *map, const char *filename)
+{
+    memset(map, 0, sizeof(*map));
+
+#if VCD_MAP_USE_MMAP
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0)
+        return -1;
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    /* A zero length mapping is not permitted; an empty file is simply an
+     * empty view. */
+    if (st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        map->data = data;
+        map->size = st.st_size;
+    }
+
+    /* The mapping remains valid once the descriptor has been closed. */
+    close(fd);
+#else
+    FILE *f = fopen(filename, "rb");
+    long long size;
+    char *data;
+
+    if (f == NULL)
+        return -1;
+
+    _fseeki64(f, 0, SEEK_END);
+    size = _ftelli64(f);
+    _fseeki64(f, 0, SEEK_SET);
+
+    data = malloc((size > 0) ? (size_t)size : 1);
+    if (data == NULL || fread(data, 1, (size_t)size, f) != (size_t)size) {
+        free(data);
+        fclose(f);
+        return -1;
+    }
+
+    fclose(f);
+    map->data = data;
+    map->size = (size_t)size;
+    map->handle = data;
+#endif
+
+    return 0;
+}
+
+void vcd_map_close(vcd_map_t *map)
+{
+#if VCD_MAP_USE_MMAP
+    if (map->data != NULL)
+        munmap((void *)map->data, map->size);
+#else
+    free(map->handle);
+#endif
+
+    memset(map, 0, sizeof(*map));
+}
+
+static const char *next_line(const char *pos, const char *end,
+                             const char **eol)
+{
+    const char *nl = memchr(pos, '\n', end - pos);
+
+    if (nl == NULL) {
+        *eol = end;
+        return end;
+    }
+
+    *eol = nl;
+    return nl + 1;
+}
+
+const char *vcd_skip_header(const char *begin, const char *end,
+                            long long *line_count)
+{
+    const char end_of_header[] = "$enddefinitions";
+    const size_t end_of_header_len = sizeof(end_of_header) - 1;
+    const char *pos = begin;
+
+    while (pos < end) {
+        const char *eol;
+        const char *line = pos;
+
+        pos = next_line(pos, end, &eol);
+        (*line_count)++;
+
+        /* Match the first whitespace delimited token of the line. */
+        while (line < eol && (*line == ' ' || *line == '\r'))
+            line++;
+
+        if ((eol - line) >= (ptrdiff_t)end_of_header_len &&
+            memcmp(line, end_of_header, end_of_header_len) == 0) {
+            const char *tail = line + end_of_header_len;
+
+            if (tail == eol || *tail == ' ' || *tail == '\r')
+                return pos;
+        }
+    }
+
+    return NULL;
+}
+
+vcd_line_type_t vcd_scan_line(const char **pos, const char *end,
+                              vcd_record_t *record)
+{
+    const char *eol;
+    const char *p = *pos;
+    int length = 0;
+    int digits = 0;
+
+    *pos = next_line(p, end, &eol);
+
+    if (p == eol || *p != 'l')
+        return VCD_LINE_OTHER;
+
+    if (eol[-1] == '\r')
+        eol--;
+
+    // The first token indicates the length of the data that follows
+    for (p++; p < eol && *p >= '0' && *p <= '9'; p++, digits++)
+        length = (length * 10) + (*p - '0');
+
+    if (p == eol || *p != ' ')
+        return VCD_LINE_MALFORMED;
+
+    // The second token has the trace data that needs to be converted
+    while (p < eol && *p == ' ')
+        p++;
+
+    record->hex = p;
+    while (p < eol && *p != ' ')
+        p++;
+
+    if (p == record->hex || p == eol)
+        return VCD_LINE_MALFORMED;
+
+    record->length = (digits > 0 && (p - record->hex) == (length << 1)) ?
+                     length : -1;
+
+    // The third token indicates the probe ID
+    while (p < eol && *p == ' ')
+        p++;
+
+    if (p == eol)
+        return VCD_LINE_MALFORMED;
+
+    record->probe = 0;
+    for (; p < eol && *p != ' '; p++) {
+        if (*p < '0' || *p > '9') {
+            record->probe = ~0u;
+            break;
+        }
+
+        record->probe = (record->probe * 10) + (*p - '0');
+    }
+
+    return VCD_LINE_RECORD;
+}
+
+bool vcd_hex_decode(uint8_t *dst, const char *src, size_t num_bytes)
+{
+    size_t i = 0;
+
+#if VCD_HEX_USE_SSE2
+    /* Decode 16 characters (8 bytes) per iteration. */
+    const __m128i ascii_zero = _mm_set1_epi8('0');
+    const __m128i ascii_a = _mm_set1_epi8('a');
+    const __m128i lower_case = _mm_set1_epi8(0x20);
+    const __m128i max_digit = _mm_set1_epi8(9);
+    const __m128i max_alpha = _mm_set1_epi8(5);
+    const __m128i alpha_offset = _mm_set1_epi8(10);
+    const __m128i low_byte = _mm_set1_epi16(0x00FF);
+
+    for (; i + 8 <= num_bytes; i += 8) {
+        __m128i c = _mm_loadu_si128((const __m128i *)&src[i << 1]);
+        __m128i d = _mm_sub_epi8(c, ascii_zero);
+        __m128i a = _mm_sub_epi8(_mm_or_si128(c, lower_case), ascii_a);
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(d, max_digit), d);
+        __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(a, max_alpha), a);
+
+        if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) != 0xFFFF)
+            return false;
+
+        __m128i nibbles =
+                _mm_or_si128(_mm_and_si128(is_digit, d),
+                             _mm_and_si128(is_alpha,
+                                           _mm_add_epi8(a, alpha_offset)));
+
+        /* Each 16-bit lane holds the high nibble in its low byte. */
+        __m128i bytes = _mm_or_si128(
+                _mm_slli_epi16(_mm_and_si128(nibbles, low_byte), 4),
+                _mm_srli_epi16(nibbles, 8));
+
+        _mm_storel_epi64((__m128i *)&dst[i], _mm_packus_epi16(bytes, bytes));
+    }
+#endif
+
+    for (; i < num_bytes; i++) {
+        uint8_t hi = hex_lut[(uint8_t)src[i << 1]];
+        uint8_t lo = hex_lut[(uint8_t)src[(i << 1) + 1]];
+
+        if (!(hi & lo & HEX_VALID))
+            return false;
+
+        dst[i] = ((hi & HEX_NIBBLE_MASK) << 4) | (lo & HEX_NIBBLE_MASK);
+    }
+
+    return true;
+}
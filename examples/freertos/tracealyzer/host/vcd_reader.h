@@ -0,0 +1,65 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef VCD_READER_H_
+#define VCD_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A read-only view of an entire VCD file. On POSIX hosts the file is memory
+ * mapped; on other hosts it is read into a heap buffer in one go.
+ */
+typedef struct vcd_map {
+    const char *data;
+    size_t size;
+    void *handle;
+} vcd_map_t;
+
+/*
+ * The result of scanning a single line of VCD data.
+ */
+typedef enum vcd_line_type {
+    VCD_LINE_OTHER,     /* Not an 'l' record (timestamps, comments, etc) */
+    VCD_LINE_RECORD,    /* A well formed 'l<len> <hex> <probe>' record */
+    VCD_LINE_MALFORMED  /* An 'l' record that could not be decoded */
+} vcd_line_type_t;
+
+/*
+ * A record located by vcd_scan_line(). The hex string is not copied; it points
+ * into the buffer that was scanned.
+ */
+typedef struct vcd_record {
+    const char *hex;
+    int length;
+    unsigned int probe;
+} vcd_record_t;
+
+int vcd_map_open(vcd_map_t *map, const char *filename);
+
+void vcd_map_close(vcd_map_t *map);
+
+/*
+ * Advances past the VCD header. Returns a pointer to the first line following
+ * the "$enddefinitions" line, or NULL if the end of the header was not found.
+ * The number of lines consumed is added to *line_count.
+ */
+const char *vcd_skip_header(const char *begin, const char *end,
+                            long long *line_count);
+
+/*
+ * Scans the line starting at *pos and advances *pos to the start of the next
+ * line. Lines are terminated by '\n'; a trailing '\r' is ignored.
+ */
+vcd_line_type_t vcd_scan_line(const char **pos, const char *end,
+                              vcd_record_t *record);
+
+/*
+ * Converts 2 * num_bytes hex characters into num_bytes bytes.
+ * Returns false if a non-hex character is encountered.
+ */
+bool vcd_hex_decode(uint8_t *dst, const char *src, size_t num_bytes);
+
+#endif /* VCD_READER_H_ */
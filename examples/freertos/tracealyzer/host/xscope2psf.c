@@ -1,14 +1,24 @@
 // Copyright 2022 XMOS LIMITED.
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
 
+#include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdarg.h>
 #include "xscope_endpoint.h"
+#include "os_port.h"
+#include "psf_analysis.h"
+#include "spsc_ring.h"
+#include "trace_capture.h"
+#include "trace_snapshot.h"
+#include "vcd_follow.h"
+#include "vcd_pipeline.h"
+#include "vcd_reader.h"
 
-#define VERSION "1.0.1"
+#define VERSION "1.1.0"
 
 // Abstraction for sleep portability
 #if defined(__GNUC__) || defined(__MINGW32__)
@@ -32,6 +42,31 @@
 
 #define MAX_LINE_BUFFER_BYTES   4096
 
+/*
+ * The size of the header (ID, event count and timestamp) at the start of each
+ * PSF event.
+ */
+#define PSF_EVENT_HEADER_BYTES  8
+
+/*
+ * The stdio buffer size used for the output PSF file. PSF records are small so
+ * a large buffer keeps the number of write system calls low.
+ */
+#define OUTPUT_BUFFER_BYTES     (1024 * 1024)
+
+/*
+ * When using `--in-port`, records are queued by the xscope callback and
+ * written to the PSF file by a separate thread. This is the default size of
+ * that queue, which absorbs file system stalls without blocking the xscope
+ * endpoint.
+ */
+#define DEFAULT_QUEUE_MB        64
+
+/*
+ * The time the PSF writer thread sleeps when the record queue is empty.
+ */
+#define WRITER_IDLE_SLEEP_MS    1
+
 /*
  * Enables additional informational logging while processing the PSF data.
  * This is mainly for development purposes.
@@ -57,7 +92,9 @@ typedef enum error_code {
     ERROR_INCOMPATIBLE_VCD,
     ERROR_DATA_TOO_SHORT,
     ERROR_FILE_SYSTEM,
-    ERROR_OUT_OF_RESOURCES
+    ERROR_OUT_OF_RESOURCES,
+    ERROR_INCOMPATIBLE_CAPTURE,
+    ERROR_INCOMPATIBLE_SNAPSHOT
 } error_code_t;
 
 typedef enum log_level {
@@ -125,6 +162,12 @@ static const char *delay_arg[] = {"-d", "--delay"};
 static const char *input_file_arg[] = {"-i", "--in-file"};
 static const char *input_port_arg[] = {"-I", "--in-port"};
 static const char *output_file_arg[] = {"-o", "--out-file"};
+static const char *jobs_arg[] = {"-j", "--jobs"};
+static const char *queue_size_arg[] = {"-q", "--queue-size"};
+static const char *capture_arg[] = {"-c", "--capture"};
+static const char *from_arg[] = {"--from"};
+static const char *to_arg[] = {"--to"};
+static const char *analyze_arg[] = {"-a", "--analyze"};
 
 static bool running = true;
 static int event_count = 0;
@@ -134,6 +177,10 @@ static TraceEntryTableHeader_t psf_evt_table;
 static uint32_t psf_evt_entry = 0;
 static uint16_t *event_cnts = NULL;
 static uint16_t num_cores;
+static spsc_ring_t record_queue;
+static size_t writer_stop = 0;
+static capture_writer_t capture;
+static psf_analysis_t analysis;
 
 /*
  * Variables set by command line arguments.
@@ -144,21 +191,32 @@ static bool show_version = false;
 static bool stream_mode = false;
 static bool print_endpoint = false;
 static int sleep_ms = 1000;
+static int num_jobs = 0;
+static int queue_mb = DEFAULT_QUEUE_MB;
+static bool capture_mode = false;
+static double window_from_s = -1.0;
+static double window_to_s = -1.0;
 static char *input_host = NULL;
 static char *input_port = NULL;
 static char *input_filename = NULL;
 static char *output_filename = NULL;
+static char *analysis_filename = NULL;
 static FILE *out_file = NULL;
 
 static void print_help(char *arg0)
 {
     printf("Usage:\n");
     printf("    %s [-h] [--version]\n\n", arg0);
-    printf("    %s [-v] [-s] [-d <DELAY_MS>] -i <IN_FILE> -o <OUT_FILE>\n\n",
+    printf("    %s [-v] [-s] [-d <DELAY_MS>] [-j <NUM_JOBS>] -i <IN_FILE> -o <OUT_FILE>\n\n",
+           arg0);
+    printf("    %s [-v] [-j <NUM_JOBS>] [--from <SEC>] [--to <SEC>] -i <IN_FILE> -o <OUT_FILE>\n\n",
            arg0);
-    printf("    %s [-v] [-p] -I <HOST>:<PORT> -o <OUT_FILE>\n\n", arg0);
+    printf("    %s [-v] [-j <NUM_JOBS>] -i <IN_FILE> -a <JSON_FILE> [-o <OUT_FILE>]\n\n",
+           arg0);
+    printf("    %s [-v] [-p] [-q <QUEUE_MB>] [-c] -I <HOST>:<PORT> -o <OUT_FILE>\n\n", arg0);
     printf("Generate a Percepio Streaming Format (PSF) file based on Tracealyzer data received\n"
-           "via an xscope Value Change Dump (VCD) file or an xscope endpoint socket connection.\n\n");
+           "via an xscope Value Change Dump (VCD) file, a binary capture file, a snapshot read\n"
+           "back from flash or an xscope endpoint socket connection.\n\n");
     printf("Options:\n");
     printf("    -h, --help                  This help menu.\n");
     printf("        --version               Print the version of this tool.\n");
@@ -168,15 +226,38 @@ static void print_help(char *arg0)
            "                                execution via Ctrl+C or other means.\n");
     printf("    -p, --print-endpoint        When using -in-port, this option will enable\n"
            "                                reception of printf data on this xscope endpoint.\n");
+    printf("    -q, --queue-size <QUEUE_MB> When using --in-port, the size of the queue that holds\n"
+           "                                records until they are written to the file system.\n"
+           "                                Records are dropped if the queue is full.\n"
+           "                                Default = %d.\n", DEFAULT_QUEUE_MB);
+    printf("    -c, --capture               When using --in-port, write a binary capture file to\n"
+           "                                OUT_FILE instead of PSF. A capture is much smaller\n"
+           "                                than VCD and can later be converted with --in-file.\n");
+    printf("        --from <SEC>            When converting a binary capture, the start of the\n"
+           "                                time window to convert, in seconds from the start of\n"
+           "                                the capture. Default = start of capture.\n");
+    printf("        --to <SEC>              When converting a binary capture, the end of the time\n"
+           "                                window to convert, in seconds from the start of the\n"
+           "                                capture. Default = end of capture.\n");
     printf("    -d, --delay <DELAY_MS>      The time in milliseconds to sleep when waiting for more\n"
-           "                                data on the input file stream. This option only applies\n"
-           "                                for --stream. Default = 1000.\n");
-    printf("    -i, --in-file <IN_FILE>     The VCD file to process. In stream mode, the\n"
-           "                                application will wait for such a file to exist.\n");
+           "                                data on the input file stream. On Linux, file change\n"
+           "                                notifications are used instead and this is only the\n"
+           "                                interval between status updates. This option only\n"
+           "                                applies for --stream. Default = 1000.\n");
+    printf("    -j, --jobs <NUM_JOBS>       The number of threads used to decode the input file.\n"
+           "                                This option does not apply for --stream.\n"
+           "                                Default = number of CPUs.\n");
+    printf("    -i, --in-file <IN_FILE>     The VCD, binary capture or flash snapshot file to\n"
+           "                                process. In stream mode, the application will wait\n"
+           "                                for such a VCD file to exist.\n");
     printf("    -I, --in-port <HOST>:<PORT> The host and port (separated by ':') on the which\n"
            "                                xgdb's --xscope-port is serving on.\n"
            "                                Note: --stream is implied when using this mode.\n");
-    printf("    -o, --out-file <OUT_FILE>   The PSF file to generate.\n");
+    printf("    -o, --out-file <OUT_FILE>   The PSF (or with --capture, binary capture) file to\n"
+           "                                generate. Optional when --analyze is specified.\n");
+    printf("    -a, --analyze <JSON_FILE>   Write a JSON report of per-core utilisation, per-task\n"
+           "                                run time, ready to running latency and mutex hold\n"
+           "                                times. Does not apply for --stream or --capture.\n");
 }
 
 static void write_log(log_level_t level, const char *format, ...)
@@ -207,7 +288,18 @@ static void print_stream_status(void)
     if (input_filename)
         write_log(LOG_INF, "- Read %lld lines\n", line_count);
 
-    write_log(LOG_INF, "- Processed %d events\n", event_count + 1);
+    if (capture_mode)
+        write_log(LOG_INF, "- Captured %llu records\n", capture.records);
+    else
+        write_log(LOG_INF, "- Processed %d events\n", event_count + 1);
+
+    if (input_port) {
+        write_log(LOG_INF, "- Queue: %zu bytes used, %zu bytes high-water mark (of %zu)\n",
+                  spsc_ring_used(&record_queue), record_queue.high_water,
+                  record_queue.capacity);
+        write_log(LOG_INF, "- Queue: %llu records (%llu bytes) dropped\n",
+                  record_queue.drops, record_queue.dropped_bytes);
+    }
 }
 
 static void print_psf_header(TraceHeader_t *header)
@@ -333,6 +425,10 @@ static error_code_t process_psf_header(unsigned char trace_bytes[],
 
     print_psf_header(&header);
 
+    if (analysis_filename &&
+        psf_analysis_header(&analysis, header.uiNumCores) != 0)
+        return ERROR_OUT_OF_RESOURCES;
+
     if (header.uiNumCores > 0) {
         uint16_t data_size = header.uiNumCores * sizeof(uint16_t);
         event_cnts = malloc(data_size);
@@ -362,6 +458,9 @@ static error_code_t process_psf_timestamp(unsigned char trace_bytes[],
 
     memcpy(&timestamp, trace_bytes, sizeof(TraceTimestamp_t));
     print_psf_timestamp(&timestamp);
+
+    if (analysis_filename)
+        psf_analysis_timestamp(&analysis, timestamp.frequency);
     return ERROR_NONE;
 }
 
@@ -399,6 +498,11 @@ static error_code_t process_psf_event_table_entry(unsigned char trace_bytes[],
     print_psf_event_table_entry(trace_bytes, trace_length);
 #endif
 
+    if (analysis_filename)
+        psf_analysis_entry(&analysis, trace_bytes, trace_length,
+                           psf_evt_table.uiEntryStateCount,
+                           psf_evt_table.uiEntrySymbolLength);
+
     return ERROR_NONE;
 }
 
@@ -462,8 +566,27 @@ static void modify_trace_event_count(unsigned char trace_bytes[],
     event_count++;
 }
 
-static error_code_t process_trace_event(unsigned char trace_bytes[],
-                                        int num_trace_bytes)
+/*
+ * Returns true if the record is a batch of several whole events, as sent by
+ * the per-core stream port. An event is an 8 byte header followed by the
+ * number of 32-bit parameters given in the top 4 bits of its ID.
+ */
+static bool is_trace_event_batch(const unsigned char trace_bytes[],
+                                 int num_trace_bytes)
+{
+    int pos = 0;
+    int num_events = 0;
+
+    while (pos + 4 <= num_trace_bytes) {
+        pos += PSF_EVENT_HEADER_BYTES + 4 * (trace_bytes[pos + 1] >> 4);
+        num_events++;
+    }
+
+    return num_events > 1 && pos == num_trace_bytes;
+}
+
+static error_code_t process_single_trace_event(unsigned char trace_bytes[],
+                                               int num_trace_bytes)
 {
     /*
      * Tracealyzer's FreeRTOS unit tracks event data on a per-core basis;
@@ -489,12 +612,34 @@ static error_code_t process_trace_event(unsigned char trace_bytes[],
     print_psf_event(trace_bytes, num_trace_bytes);
 #endif
 
+    if (analysis_filename)
+        psf_analysis_event(&analysis, trace_bytes, num_trace_bytes);
+
     detect_missing_events(trace_bytes, num_trace_bytes);
     modify_trace_event_count(trace_bytes, num_trace_bytes);
 
     return ERROR_NONE;
 }
 
+static error_code_t process_trace_event(unsigned char trace_bytes[],
+                                        int num_trace_bytes)
+{
+    error_code_t res = ERROR_NONE;
+    int pos = 0;
+
+    if (!is_trace_event_batch(trace_bytes, num_trace_bytes))
+        return process_single_trace_event(trace_bytes, num_trace_bytes);
+
+    while (res == ERROR_NONE && pos < num_trace_bytes) {
+        int len = PSF_EVENT_HEADER_BYTES + 4 * (trace_bytes[pos + 1] >> 4);
+
+        res = process_single_trace_event(&trace_bytes[pos], len);
+        pos += len;
+    }
+
+    return res;
+}
+
 static error_code_t process_psf_data(unsigned char trace_bytes[],
                                      int trace_length)
 {
@@ -538,98 +683,373 @@ static error_code_t process_psf_data(unsigned char trace_bytes[],
     return res;
 }
 
-static error_code_t process_vcd_file(FILE *input_file, FILE *output_file)
+static error_code_t write_psf_record(unsigned char trace_bytes[],
+                                     int trace_length, FILE *output_file)
+{
+    error_code_t res = process_psf_data(trace_bytes, trace_length);
+    if (res != ERROR_NONE && res != ERROR_DATA_TOO_SHORT)
+        return res;
+
+    // Nothing is written when only analysing the trace
+    if (output_file == NULL)
+        return ERROR_NONE;
+
+    if (fwrite(trace_bytes, sizeof(trace_bytes[0]), trace_length,
+               output_file) != trace_length)
+        write_log(LOG_ERR, "Data lost while writing to file system.\n");
+
+    return ERROR_NONE;
+}
+
+/*
+ * Processes the VCD records in [pos, end), which must start at the beginning
+ * of a line following the VCD header.
+ */
+static error_code_t process_vcd_lines(const char *pos, const char *end,
+                                      FILE *output_file)
+{
+    while (pos < end) {
+        vcd_record_t record;
+        vcd_line_type_t type = vcd_scan_line(&pos, end, &record);
+
+        line_count++;
+
+        if (type == VCD_LINE_OTHER)
+            continue;
+
+        if (type == VCD_LINE_MALFORMED) {
+            write_log(LOG_WRN, "Unexpected encoding (line %lld).\n",
+                      line_count);
+            continue;
+        }
+
+        if (record.probe != XSCOPE_PROBE_ID)
+            continue;
+
+        unsigned char trace_bytes[MAX_LINE_BUFFER_BYTES >> 1];
+
+        if (record.length < 0 || record.length > sizeof(trace_bytes) ||
+            !vcd_hex_decode(trace_bytes, record.hex, record.length)) {
+            write_log(LOG_WRN, "Unexpected encoding (line %lld).\n",
+                      line_count);
+            continue;
+        }
+
+        error_code_t res =
+                write_psf_record(trace_bytes, record.length, output_file);
+        if (res != ERROR_NONE)
+            return res;
+    }
+
+    return ERROR_NONE;
+}
+
+/*
+ * Processes an entire VCD file in place. Records are located and decoded
+ * directly from the mapped file.
+ */
+static error_code_t process_vcd_map_serial(const vcd_map_t *map,
+                                           FILE *output_file)
+{
+    const char *pos = map->data;
+    const char *end = map->data + map->size;
+
+    if (map->size > 0)
+        pos = vcd_skip_header(pos, end, &line_count);
+
+    if (pos == NULL)
+        return ERROR_NONE;
+
+    return process_vcd_lines(pos, end, output_file);
+}
+
+/*
+ * Follows a VCD file while it is being written by xscope. Each batch of newly
+ * appended, complete lines is decoded in place; a partially written line is
+ * held back until the rest of it arrives.
+ */
+static error_code_t process_vcd_stream(vcd_follow_t *follow, FILE *output_file)
 {
     int last_event_count = 0;
-    parsing_vcd_state_t parsing_state = PARSING_VCD_HEADER;
-    char line[MAX_LINE_BUFFER_BYTES];
+    long long last_status_ms = os_time_ms();
+    bool in_header = true;
+    bool flushed = true;
 
     while (1) {
-        const char delim[] = " \n\r";
-        char *line_ptr = fgets(line, sizeof(line), input_file);
+        const char *begin;
+        const char *end;
 
-        if (line_ptr == NULL) {
-            if (!stream_mode)
-                break;
+        if (vcd_follow_read(follow, &begin, &end)) {
+            if (in_header) {
+                begin = vcd_skip_header(begin, end, &line_count);
 
-            if (last_event_count != event_count) {
-                print_stream_status();
-                last_event_count = event_count;
+                if (begin == NULL)
+                    continue;
+
+                in_header = false;
             }
 
-            SLEEP_MS(sleep_ms);
+            error_code_t res = process_vcd_lines(begin, end, output_file);
+            if (res != ERROR_NONE)
+                return res;
+
+            flushed = false;
             continue;
         }
 
-        line_count++;
+        /* Caught up with the writer; make the output visible to live
+         * Tracealyzer sessions before waiting for more data. */
+        if (!flushed) {
+            if (output_file != NULL)
+                fflush(output_file);
+            flushed = true;
+        }
 
-        /* Filter lines related to VCD header; afterwards, only process lines
-         * that begin with 'l' which are expected to be run-length encoded
-         * hex-strings representing the Tracealyzer PSF data. */
-        if (parsing_state == PARSING_VCD_HEADER) {
-            char *token = strtok(line, delim);
-            const char *end_of_header = "$enddefinitions";
+        if (last_event_count != event_count &&
+            (os_time_ms() - last_status_ms) >= sleep_ms) {
+            print_stream_status();
+            last_event_count = event_count;
+            last_status_ms = os_time_ms();
+        }
 
-            if (strcmp(token, end_of_header) == 0)
-                parsing_state = PARSING_VCD_RECORDS;
+        if (!vcd_follow_wait(follow, sleep_ms))
+            SLEEP_MS(sleep_ms);
+    }
 
-            continue;
+    return ERROR_NONE;
+}
+
+static int vcd_pipeline_record_cb(void *ctx, unsigned char *bytes, int length,
+                                  long long line)
+{
+    /* Keep line_count in step with the record so that any warnings raised
+     * while processing it report the correct line. */
+    line_count = line;
+
+    if (length < 0) {
+        write_log(LOG_WRN, "Unexpected encoding (line %lld).\n", line);
+        return ERROR_NONE;
+    }
+
+    return write_psf_record(bytes, length, (FILE *)ctx);
+}
+
+/*
+ * Returns true if the file starts, after any whitespace, with a VCD header
+ * command. Only files that do not are searched for a snapshot, as the search
+ * would read every sector of a large VCD file before converting it.
+ */
+static bool vcd_has_header(const char *data, size_t size)
+{
+    size_t i = 0;
+
+    while (i < size && isspace((unsigned char)data[i]))
+        i++;
+
+    return i < size && data[i] == '$';
+}
+
+/*
+ * Processes an entire VCD file in place using a pool of decode workers.
+ * Records are passed through the PSF state machine and written out on the
+ * calling thread in file order, so the output is identical to that of
+ * process_vcd_map_serial().
+ */
+static error_code_t process_vcd_map(const vcd_map_t *map, FILE *output_file)
+{
+    const char *pos = map->data;
+    const char *end = map->data + map->size;
+    int num_workers = (num_jobs > 0) ? num_jobs : os_cpu_count();
+    error_code_t res;
+
+    if (num_workers <= 1) {
+        res = process_vcd_map_serial(map, output_file);
+    } else {
+        long long lines = 0;
+
+        if (map->size > 0)
+            pos = vcd_skip_header(pos, end, &lines);
+
+        if (pos != NULL) {
+            write_log(LOG_INF, "Decoding with %d threads ...\n", num_workers);
+            int ret = vcd_pipeline_run(pos, end, XSCOPE_PROBE_ID, num_workers,
+                                       vcd_pipeline_record_cb, output_file,
+                                       &lines);
+            res = (ret < 0) ? ERROR_OUT_OF_RESOURCES : (error_code_t)ret;
         } else {
-            bool is_trace_data = (line[0] == 'l');
-            if (!is_trace_data)
-                continue;
+            res = ERROR_NONE;
         }
 
-        // The first token indicates the length of the data that follows
-        char *len_field = strtok(line, delim);
+        line_count = lines;
+    }
+
+    if (res != ERROR_NONE)
+        return res;
 
-        // The second token has the trace data that needs to be converted
-        char *trace_data = strtok(NULL, delim);
+    write_log(LOG_INF, "End of file reached.\n");
+    write_log(LOG_INF, "Read %lld lines.\n", line_count);
+    write_log(LOG_INF, "Processed %d events.\n", event_count + 1);
 
-        /* The third token indicates the probe ID. Skip lines not targeting the
-         * expected probe ID. */
-        char *scope_probe = strtok(NULL, delim);
+    return ERROR_NONE;
+}
 
-        if (len_field == NULL || trace_data == NULL || scope_probe == NULL) {
-            write_log(LOG_WRN, "Unexpected encoding (line %lld).\n",
-                      line_count);
-            continue;
+static error_code_t write_capture_record(const capture_record_t *record,
+                                         FILE *output_file)
+{
+    unsigned char trace_bytes[MAX_LINE_BUFFER_BYTES >> 1];
+
+    line_count++;
+
+    // The PSF state machine modifies records, so work on a copy
+    if (record->length > sizeof(trace_bytes)) {
+        write_log(LOG_WRN, "Unexpected encoding (record %lld).\n",
+                  line_count);
+        return ERROR_NONE;
+    }
+
+    memcpy(trace_bytes, record->data, record->length);
+    return write_psf_record(trace_bytes, record->length, output_file);
+}
+
+/*
+ * Converts a binary capture to PSF, optionally limited to the time window
+ * given by --from and --to. The PSF metadata at the start of the capture is
+ * always converted; the index is then used to seek directly to the first
+ * record of the window.
+ */
+static error_code_t process_capture(const vcd_map_t *map, FILE *output_file)
+{
+    capture_reader_t reader;
+    capture_record_t record;
+    uint64_t from_ts = 0;
+    uint64_t to_ts = UINT64_MAX;
+    error_code_t res = ERROR_NONE;
+    bool first = true;
+
+    if (capture_reader_open(&reader, map->data, map->size) != 0) {
+        write_log(LOG_ERR, "Incompatible capture file.\n");
+        return ERROR_INCOMPATIBLE_CAPTURE;
+    }
+
+    write_log(LOG_INF, "Loaded %zu index entries.\n", reader.index_len);
+
+    while (res == ERROR_NONE && psf_state != PROCESS_PSF_EVENT &&
+           capture_reader_next(&reader, &record)) {
+        if (first) {
+            // The window is relative to the first record of the capture
+            if (window_from_s > 0)
+                from_ts = record.timestamp + (uint64_t)(window_from_s * 1e9);
+            if (window_to_s >= 0)
+                to_ts = record.timestamp + (uint64_t)(window_to_s * 1e9);
+            first = false;
         }
 
-        if (strcmp(scope_probe, XSTR(XSCOPE_PROBE_ID)) != 0)
-            continue;
+        res = write_capture_record(&record, output_file);
+    }
 
-        int trace_data_chars = strlen(trace_data);
-        int decoded_trace_len;
+    if (res == ERROR_NONE && from_ts > 0) {
+        size_t metadata_end = reader.pos;
 
-        if ((sscanf(len_field, "l%d", &decoded_trace_len) != 1) ||
-            (trace_data_chars != (decoded_trace_len << 1))) {
-            write_log(LOG_WRN, "Unexpected encoding (line %lld).\n",
-                      line_count);
+        capture_reader_seek(&reader, from_ts);
+
+        if (reader.pos < metadata_end)
+            reader.pos = metadata_end;
+    }
+
+    while (res == ERROR_NONE && capture_reader_next(&reader, &record)) {
+        if (record.timestamp < from_ts)
             continue;
-        }
 
-        unsigned char trace_bytes[MAX_LINE_BUFFER_BYTES >> 1];
+        if (record.timestamp > to_ts)
+            break;
 
-        // Convert the trace_data from a hex-string to an array of bytes
-        for (int i = 0; i < decoded_trace_len; i++)
-            sscanf(&trace_data[i << 1], "%02hhx", &trace_bytes[i]);
+        res = write_capture_record(&record, output_file);
+    }
 
-        error_code_t res = process_psf_data(trace_bytes, decoded_trace_len);
-        if (res != ERROR_NONE && res != ERROR_DATA_TOO_SHORT)
-            return res;
+    capture_reader_close(&reader);
 
-        if (fwrite(trace_bytes, sizeof(trace_bytes[0]), decoded_trace_len,
-                   output_file) != decoded_trace_len)
-            write_log(LOG_ERR, "Data lost while writing to file system.\n");
+    if (res != ERROR_NONE)
+        return res;
+
+    write_log(LOG_INF, "End of file reached.\n");
+    write_log(LOG_INF, "Read %lld records.\n", line_count);
+    write_log(LOG_INF, "Processed %d events.\n", event_count + 1);
+
+    return ERROR_NONE;
+}
+
+static error_code_t write_snapshot_record(const uint8_t *data, uint32_t length,
+                                          FILE *output_file)
+{
+    unsigned char trace_bytes[MAX_LINE_BUFFER_BYTES >> 1];
+
+    line_count++;
+
+    // The PSF state machine modifies records, so work on a copy
+    if (length > sizeof(trace_bytes)) {
+        write_log(LOG_WRN, "Unexpected encoding (record %lld).\n",
+                  line_count);
+        return ERROR_NONE;
     }
 
-    if (feof(input_file) && !stream_mode) {
-        write_log(LOG_INF, "End of file reached.\n");
-        write_log(LOG_INF, "Read %lld lines.\n", line_count);
-        write_log(LOG_INF, "Processed %d events.\n", event_count + 1);
+    memcpy(trace_bytes, data, length);
+    return write_psf_record(trace_bytes, length, output_file);
+}
+
+/*
+ * Converts a post-mortem snapshot read back from flash to PSF. The metadata
+ * records (header, timestamp, entry table and object names) are followed by
+ * the events that were in the target's RAM ring when the snapshot was taken.
+ */
+static error_code_t process_snapshot(const trace_snapshot_t *snapshot,
+                                     FILE *output_file)
+{
+    error_code_t res = ERROR_NONE;
+    const uint8_t *record;
+    uint32_t length;
+    size_t pos = 0;
+
+    write_log(LOG_INF, "[Snapshot]\n");
+    write_log(LOG_INF, "- Offset: 0x%zX\n", snapshot->offset);
+    write_log(LOG_INF, "- Reason: %s\n",
+              snapshot_reason_name(snapshot->reason));
+    write_log(LOG_INF, "- Number of Cores: %u\n", snapshot->num_cores);
+    write_log(LOG_INF, "- Overwritten Events: %u\n",
+              snapshot->overwritten_events);
+    write_log(LOG_INF, "- Commits: %u\n", snapshot->commits);
+    write_log(LOG_INF, "- Commit Time (max): %u ticks\n",
+              snapshot->commit_ticks_max);
+    write_log(LOG_INF, "- Commit Time (mean): %u ticks\n",
+              snapshot->commit_ticks_mean);
+
+    if (snapshot->dropped_events > 0)
+        write_log(LOG_WRN, "%u events were dropped by the target.\n",
+                  snapshot->dropped_events);
+    if (snapshot->dropped_metadata > 0)
+        write_log(LOG_WRN, "%u metadata records did not fit in the snapshot.\n",
+                  snapshot->dropped_metadata);
+
+    while (res == ERROR_NONE &&
+           snapshot_next_metadata(snapshot, &pos, &record, &length))
+        res = write_snapshot_record(record, length, output_file);
+
+    if (res == ERROR_NONE && psf_state != PROCESS_PSF_EVENT) {
+        write_log(LOG_ERR, "Incomplete snapshot metadata.\n");
+        return ERROR_INCOMPATIBLE_SNAPSHOT;
     }
 
+    pos = 0;
+    while (res == ERROR_NONE &&
+           snapshot_next_event(snapshot, &pos, &record, &length))
+        res = write_snapshot_record(record, length, output_file);
+
+    if (res != ERROR_NONE)
+        return res;
+
+    write_log(LOG_INF, "End of snapshot reached.\n");
+    write_log(LOG_INF, "Read %lld records.\n", line_count);
+    write_log(LOG_INF, "Processed %d events.\n", event_count + 1);
+
     return ERROR_NONE;
 }
 
@@ -668,16 +1088,16 @@ static void xscope_record_cb(unsigned int id, unsigned long long timestamp,
     if (!running)
         return;
 
+    /* Only queue the record here; blocking this callback on the file system
+     * would stall the xscope endpoint and lose records. */
     if (id == XSCOPE_PROBE_ID) {
-        error_code_t res = process_psf_data(data_bytes, length);
-        if (res != ERROR_NONE && res != ERROR_DATA_TOO_SHORT) {
-            running = false;
-            return;
-        }
+        bool queued = capture_mode ?
+                spsc_ring_push_parts(&record_queue, &timestamp,
+                                     sizeof(timestamp), data_bytes, length) :
+                spsc_ring_push(&record_queue, data_bytes, length);
 
-        if (fwrite(data_bytes, sizeof(data_bytes[0]), length, out_file) !=
-            length) {
-            write_log(LOG_ERR, "Data lost while writing to file system.\n");
+        if (!queued && record_queue.drops == 1) {
+            write_log(LOG_WRN, "Record queue full, dropping records.\n");
         }
     }
 #if (PRINT_OTHER_RECORDS == 1)
@@ -687,6 +1107,59 @@ static void xscope_record_cb(unsigned int id, unsigned long long timestamp,
 #endif
 }
 
+/*
+ * Drains the record queue filled by xscope_record_cb(), running each record
+ * through the PSF state machine before writing it out, or, in capture mode,
+ * appending it to the binary capture. The output file is flushed whenever the
+ * queue runs empty so that live views stay current.
+ */
+static void psf_writer_thread(void *arg)
+{
+    FILE *output_file = arg;
+    bool flushed = true;
+
+    while (1) {
+        /* Sample the stop request before checking the queue so that records
+         * queued before the request are always written. */
+        size_t stop = os_atomic_load_acquire(&writer_stop);
+        uint32_t length;
+        unsigned char *bytes = spsc_ring_peek(&record_queue, &length);
+
+        if (bytes == NULL) {
+            if (stop)
+                break;
+
+            if (!flushed) {
+                if (output_file != NULL)
+                    fflush(output_file);
+                flushed = true;
+            }
+
+            SLEEP_MS(WRITER_IDLE_SLEEP_MS);
+            continue;
+        }
+
+        if (running && capture_mode) {
+            unsigned long long timestamp;
+
+            memcpy(&timestamp, bytes, sizeof(timestamp));
+
+            if (capture_writer_write(&capture, timestamp,
+                                     &bytes[sizeof(timestamp)],
+                                     length - sizeof(timestamp)) != 0) {
+                write_log(LOG_ERR, "Data lost while writing to file system.\n");
+                running = false;
+            }
+        } else if (running &&
+                   write_psf_record(bytes, length, output_file) != ERROR_NONE) {
+            running = false;
+        }
+
+        spsc_ring_pop(&record_queue);
+        flushed = false;
+    }
+}
+
 static bool is_matching_arg(char *arg, const char *arg_options[],
                             int num_options)
 {
@@ -760,6 +1233,53 @@ static error_code_t process_args(int argc, char *argv[])
                           argv[i]);
                 return ERROR_ARG_VALUE_PARSING_FAILURE;
             }
+        } else if (is_matching_arg(argv[i], jobs_arg, NUM_ELEMS(jobs_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            if (sscanf(argv[i], "%d", &num_jobs) != 1) {
+                write_log(LOG_ERR, "Argument value (%s) could not be parsed.\n",
+                          argv[i]);
+                return ERROR_ARG_VALUE_PARSING_FAILURE;
+            }
+        } else if (is_matching_arg(argv[i], queue_size_arg,
+                                   NUM_ELEMS(queue_size_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            if (sscanf(argv[i], "%d", &queue_mb) != 1 || queue_mb <= 0) {
+                write_log(LOG_ERR, "Argument value (%s) could not be parsed.\n",
+                          argv[i]);
+                return ERROR_ARG_VALUE_PARSING_FAILURE;
+            }
+        } else if (is_matching_arg(argv[i], analyze_arg,
+                                   NUM_ELEMS(analyze_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            analysis_filename = argv[i];
+        } else if (is_matching_arg(argv[i], capture_arg,
+                                   NUM_ELEMS(capture_arg))) {
+            capture_mode = true;
+        } else if (is_matching_arg(argv[i], from_arg, NUM_ELEMS(from_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            if (sscanf(argv[i], "%lf", &window_from_s) != 1 ||
+                window_from_s < 0) {
+                write_log(LOG_ERR, "Argument value (%s) could not be parsed.\n",
+                          argv[i]);
+                return ERROR_ARG_VALUE_PARSING_FAILURE;
+            }
+        } else if (is_matching_arg(argv[i], to_arg, NUM_ELEMS(to_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            if (sscanf(argv[i], "%lf", &window_to_s) != 1 || window_to_s < 0) {
+                write_log(LOG_ERR, "Argument value (%s) could not be parsed.\n",
+                          argv[i]);
+                return ERROR_ARG_VALUE_PARSING_FAILURE;
+            }
         } else if (is_matching_arg(argv[i], stream_arg,
                                    NUM_ELEMS(stream_arg))) {
             stream_mode = true;
@@ -775,7 +1295,19 @@ static error_code_t process_args(int argc, char *argv[])
     if (in_port_present && in_file_present)
         return ERROR_MUTUALLY_EXCLUSIVE_ARGS;
 
-    return ((in_port_present || in_file_present) && out_file_present) ?
+    // Captures are only recorded live, and time windows only apply to them
+    if ((capture_mode && in_file_present) ||
+        ((window_from_s >= 0 || window_to_s >= 0) &&
+         (in_port_present || stream_mode)))
+        return ERROR_MUTUALLY_EXCLUSIVE_ARGS;
+
+    /* A stream never ends and captures are not decoded, so neither can be
+     * analysed. */
+    if (analysis_filename && (stream_mode || capture_mode))
+        return ERROR_MUTUALLY_EXCLUSIVE_ARGS;
+
+    return ((in_port_present || in_file_present) &&
+            (out_file_present || analysis_filename)) ?
                    ERROR_NONE :
                    ERROR_MISSING_ARG;
 }
@@ -783,7 +1315,9 @@ static error_code_t process_args(int argc, char *argv[])
 int main(int argc, char *argv[])
 {
     int exit_code = process_args(argc, argv);
-    FILE *in_file = NULL;
+    vcd_follow_t in_follow = { 0 };
+    vcd_map_t in_map = { 0 };
+    trace_snapshot_t in_snapshot;
 
     if (show_help || exit_code) {
         print_help(argv[0]);
@@ -797,18 +1331,16 @@ int main(int argc, char *argv[])
     if (input_filename) {
         write_log(LOG_INF, "Opening input file ...\n");
 
-        while (1) {
-            in_file = fopen(input_filename, "r");
-
-            if (in_file != NULL)
+        while (stream_mode) {
+            if (vcd_follow_open(&in_follow, input_filename) == 0)
                 break;
 
-            if (stream_mode) {
-                SLEEP_MS(1000);
-            } else {
-                write_log(LOG_INF, "File not found.\n");
-                return ERROR_FILE_SYSTEM;
-            }
+            SLEEP_MS(1000);
+        }
+
+        if (!stream_mode && vcd_map_open(&in_map, input_filename) != 0) {
+            write_log(LOG_INF, "File not found.\n");
+            return ERROR_FILE_SYSTEM;
         }
     } else {
         write_log(LOG_INF, "Configuring xscope callbacks ...\n");
@@ -821,22 +1353,62 @@ int main(int argc, char *argv[])
         xscope_ep_set_exit_cb(xscope_exit_cb);
     }
 
-    write_log(LOG_INF, "Opening output file ...\n");
-    out_file = fopen(output_filename, "wb");
+    if (output_filename) {
+        write_log(LOG_INF, "Opening output file ...\n");
+        out_file = fopen(output_filename, "wb");
 
-    if (out_file == NULL) {
-        if (in_file != NULL)
-            fclose(in_file);
+        if (out_file == NULL) {
+            vcd_follow_close(&in_follow);
+            vcd_map_close(&in_map);
+            return ERROR_FILE_SYSTEM;
+        }
 
-        return ERROR_FILE_SYSTEM;
+        /* Offline conversions are not observed while in progress, and the
+         * `--in-port` writer flushes whenever it goes idle, so favor large
+         * writes in both cases. */
+        if (!(input_filename && stream_mode))
+            setvbuf(out_file, NULL, _IOFBF, OUTPUT_BUFFER_BYTES);
     }
 
+    if (analysis_filename)
+        psf_analysis_init(&analysis);
+
     // Process the input data source based on the specified user arguments
     if (input_filename) {
         write_log(LOG_INF, "Processing file (Probe: %d) ...\n",
                   XSCOPE_PROBE_ID);
-        exit_code = process_vcd_file(in_file, out_file);
+        if (stream_mode) {
+            exit_code = process_vcd_stream(&in_follow, out_file);
+        } else if (capture_is_capture(in_map.data, in_map.size)) {
+            exit_code = process_capture(&in_map, out_file);
+        } else if (window_from_s >= 0 || window_to_s >= 0) {
+            write_log(LOG_ERR, "--from and --to require a binary capture file.\n");
+            exit_code = ERROR_INCOMPATIBLE_CAPTURE;
+        } else if (!vcd_has_header(in_map.data, in_map.size) &&
+                   snapshot_open(&in_snapshot, in_map.data,
+                                 in_map.size) == 0) {
+            exit_code = process_snapshot(&in_snapshot, out_file);
+        } else {
+            exit_code = process_vcd_map(&in_map, out_file);
+        }
     } else {
+        os_thread_t writer;
+
+        if (capture_mode && capture_writer_init(&capture, out_file) != 0) {
+            fclose(out_file);
+            return ERROR_FILE_SYSTEM;
+        }
+
+        if (spsc_ring_init(&record_queue,
+                           (size_t)queue_mb * 1024 * 1024) != 0 ||
+            os_thread_create(&writer, psf_writer_thread, out_file) != 0) {
+            write_log(LOG_ERR, "Failed to create the record queue.\n");
+            if (out_file != NULL)
+                fclose(out_file);
+            spsc_ring_deinit(&record_queue);
+            return ERROR_OUT_OF_RESOURCES;
+        }
+
         write_log(LOG_INF,
                   "Connecting to xscope (Probe: %d, Host: %s, Port: %s) ...\n",
                   XSCOPE_PROBE_ID, input_host, input_port);
@@ -847,11 +1419,14 @@ int main(int argc, char *argv[])
         }
 
         // While 'running' print out basic status info for user feedback.
-        int last_event_count = 0;
+        long long last_progress = 0;
         while (running) {
-            if (last_event_count != event_count) {
+            long long progress = capture_mode ? (long long)capture.records :
+                                                event_count;
+
+            if (last_progress != progress) {
                 print_stream_status();
-                last_event_count = event_count;
+                last_progress = progress;
             }
 
             SLEEP_MS(1000);
@@ -859,12 +1434,45 @@ int main(int argc, char *argv[])
 
         write_log(LOG_INF, "Disconnecting from xscope ...\n");
         xscope_ep_disconnect();
+
+        // Write out any records still queued before closing the file
+        os_atomic_store_release(&writer_stop, 1);
+        os_thread_join(writer);
+
+        if (capture_mode && capture_writer_finish(&capture) != 0)
+            write_log(LOG_ERR, "Data lost while writing to file system.\n");
+
+        if (record_queue.drops > 0) {
+            write_log(LOG_WRN, "Dropped %llu records (%llu bytes); consider increasing --queue-size.\n",
+                      record_queue.drops, record_queue.dropped_bytes);
+        }
+        write_log(LOG_INF, "Record queue high-water mark: %zu of %zu bytes.\n",
+                  record_queue.high_water, record_queue.capacity);
+        spsc_ring_deinit(&record_queue);
+    }
+
+    if (analysis_filename && exit_code == ERROR_NONE) {
+        write_log(LOG_INF, "Writing analysis ...\n");
+        FILE *analysis_file = fopen(analysis_filename, "w");
+
+        if (analysis_file == NULL ||
+            psf_analysis_write_json(&analysis, analysis_file) != 0) {
+            write_log(LOG_ERR, "Failed to write the analysis report.\n");
+            exit_code = ERROR_FILE_SYSTEM;
+        }
+
+        if (analysis_file != NULL)
+            fclose(analysis_file);
     }
 
+    if (analysis_filename)
+        psf_analysis_deinit(&analysis);
+
     write_log(LOG_INF, "Closing files ...\n");
-    fclose(out_file);
-    if (in_file != NULL)
-        fclose(in_file);
+    if (out_file != NULL)
+        fclose(out_file);
+    vcd_follow_close(&in_follow);
+    vcd_map_close(&in_map);
 
     if (event_cnts != NULL)
         free(event_cnts);
@@ -0,0 +1,294 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Measures the VCD decoding throughput of xscope2psf on a synthetic trace.
+ *
+ * The legacy fgets/strtok/sscanf loop, the memory mapped, table driven
+ * scanner and the multi-threaded pipeline are all run over the same file.
+ * Each decoder computes a checksum of the probe 0 payload so that the results
+ * can be checked for equivalence.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "os_port.h"
+#include "vcd_pipeline.h"
+#include "vcd_reader.h"
+
+#define DEFAULT_SIZE_MB         256
+#define DEFAULT_FILENAME        "xscope2psf_bench.vcd"
+#define MAX_LINE_BUFFER_BYTES   4096
+#define XSCOPE_PROBE_ID         0
+
+typedef struct bench_result {
+    uint64_t checksum;
+    long long records;
+    double seconds;
+} bench_result_t;
+
+static double now_seconds(void)
+{
+#if defined(_WIN32)
+    return (double)clock() / CLOCKS_PER_SEC;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+#endif
+}
+
+static uint64_t checksum_update(uint64_t sum, const uint8_t *bytes, int len)
+{
+    for (int i = 0; i < len; i++)
+        sum = (sum * 31) + bytes[i];
+
+    return sum;
+}
+
+/*
+ * Writes a VCD file resembling an xscope capture of a Tracealyzer session:
+ * a timestamp line precedes each record, and records for a second probe are
+ * interleaved with the PSF event records on probe 0.
+ */
+static int generate_vcd(const char *filename, long long target_bytes)
+{
+    static const char hex[] = "0123456789abcdef";
+    FILE *f = fopen(filename, "wb");
+    long long written = 0;
+    unsigned long long timestamp = 0;
+    uint32_t lfsr = 0xACE1u;
+
+    if (f == NULL)
+        return -1;
+
+    written += fprintf(f, "$timescale\n   1 ns\n$end\n"
+                          "$scope module xscope $end\n"
+                          "$var wire 64 0 freertos_trace $end\n"
+                          "$var wire 64 1 other $end\n"
+                          "$upscope $end\n"
+                          "$enddefinitions $end\n");
+
+    while (written < target_bytes) {
+        char line[MAX_LINE_BUFFER_BYTES];
+        int len = 8 + 4 * (lfsr % 8);
+        int probe = (lfsr % 16) == 0;
+        int n;
+
+        timestamp += 100 + (lfsr % 1000);
+        n = sprintf(line, "#%llu\nl%d ", timestamp, len);
+
+        for (int i = 0; i < len; i++) {
+            lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+            line[n++] = hex[(lfsr >> 4) & 0xF];
+            line[n++] = hex[lfsr & 0xF];
+        }
+
+        n += sprintf(&line[n], " %d\n", probe);
+        written += fwrite(line, 1, n, f);
+    }
+
+    fclose(f);
+    return 0;
+}
+
+/* A copy of the original xscope2psf decode loop, used as the baseline. */
+static int bench_legacy(const char *filename, bench_result_t *result)
+{
+    const char delim[] = " \n\r";
+    char line[MAX_LINE_BUFFER_BYTES];
+    unsigned char trace_bytes[MAX_LINE_BUFFER_BYTES >> 1];
+    int in_header = 1;
+    FILE *f = fopen(filename, "r");
+
+    if (f == NULL)
+        return -1;
+
+    memset(result, 0, sizeof(*result));
+    double start = now_seconds();
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (in_header) {
+            char *token = strtok(line, delim);
+            if (token != NULL && strcmp(token, "$enddefinitions") == 0)
+                in_header = 0;
+            continue;
+        } else if (line[0] != 'l') {
+            continue;
+        }
+
+        char *len_field = strtok(line, delim);
+        char *trace_data = strtok(NULL, delim);
+        char *scope_probe = strtok(NULL, delim);
+        int decoded_trace_len;
+
+        if (len_field == NULL || trace_data == NULL || scope_probe == NULL)
+            continue;
+
+        if (strcmp(scope_probe, "0") != 0)
+            continue;
+
+        if ((sscanf(len_field, "l%d", &decoded_trace_len) != 1) ||
+            (strlen(trace_data) != (decoded_trace_len << 1)))
+            continue;
+
+        for (int i = 0; i < decoded_trace_len; i++)
+            sscanf(&trace_data[i << 1], "%02hhx", &trace_bytes[i]);
+
+        result->checksum = checksum_update(result->checksum, trace_bytes,
+                                           decoded_trace_len);
+        result->records++;
+    }
+
+    result->seconds = now_seconds() - start;
+    fclose(f);
+    return 0;
+}
+
+static int bench_mapped(const char *filename, bench_result_t *result)
+{
+    unsigned char trace_bytes[MAX_LINE_BUFFER_BYTES >> 1];
+    long long line_count = 0;
+    vcd_map_t map;
+
+    memset(result, 0, sizeof(*result));
+    double start = now_seconds();
+
+    if (vcd_map_open(&map, filename) != 0)
+        return -1;
+
+    const char *end = map.data + map.size;
+    const char *pos = vcd_skip_header(map.data, end, &line_count);
+
+    while (pos != NULL && pos < end) {
+        vcd_record_t record;
+
+        if (vcd_scan_line(&pos, end, &record) != VCD_LINE_RECORD ||
+            record.probe != XSCOPE_PROBE_ID || record.length < 0 ||
+            record.length > sizeof(trace_bytes) ||
+            !vcd_hex_decode(trace_bytes, record.hex, record.length))
+            continue;
+
+        result->checksum = checksum_update(result->checksum, trace_bytes,
+                                           record.length);
+        result->records++;
+    }
+
+    vcd_map_close(&map);
+    result->seconds = now_seconds() - start;
+    return 0;
+}
+
+static int pipelined_record_cb(void *ctx, unsigned char *bytes, int length,
+                               long long line)
+{
+    bench_result_t *result = ctx;
+
+    if (length > 0) {
+        result->checksum = checksum_update(result->checksum, bytes, length);
+        result->records++;
+    }
+
+    return 0;
+}
+
+static int bench_pipelined(const char *filename, int num_workers,
+                           bench_result_t *result)
+{
+    long long line_count = 0;
+    vcd_map_t map;
+    int ret = 0;
+
+    memset(result, 0, sizeof(*result));
+    double start = now_seconds();
+
+    if (vcd_map_open(&map, filename) != 0)
+        return -1;
+
+    const char *end = map.data + map.size;
+    const char *pos = vcd_skip_header(map.data, end, &line_count);
+
+    if (pos != NULL)
+        ret = vcd_pipeline_run(pos, end, XSCOPE_PROBE_ID, num_workers,
+                               pipelined_record_cb, result, &line_count);
+
+    vcd_map_close(&map);
+    result->seconds = now_seconds() - start;
+    return ret;
+}
+
+static void print_result(const char *name, const bench_result_t *result,
+                         double size_mb)
+{
+    printf("%-8s %8.3f s %10.1f MB/s %12lld records  checksum 0x%016llX\n",
+           name, result->seconds, size_mb / result->seconds, result->records,
+           (unsigned long long)result->checksum);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filename = DEFAULT_FILENAME;
+    long long size_mb = DEFAULT_SIZE_MB;
+    int keep_file = 0;
+    int num_workers = os_cpu_count();
+    bench_result_t legacy, mapped, pipelined;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && (i + 1) < argc) {
+            size_mb = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && (i + 1) < argc) {
+            filename = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && (i + 1) < argc) {
+            num_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-k") == 0) {
+            keep_file = 1;
+        } else {
+            printf("Usage: %s [-s <SIZE_MB>] [-f <VCD_FILE>] [-j <NUM_JOBS>] "
+                   "[-k]\n\n", argv[0]);
+            printf("    -s <SIZE_MB>    Size of the synthetic VCD file. "
+                   "Default = %d.\n", DEFAULT_SIZE_MB);
+            printf("    -f <VCD_FILE>   Path of the synthetic VCD file. "
+                   "Default = %s.\n", DEFAULT_FILENAME);
+            printf("    -j <NUM_JOBS>   Number of pipelined decode threads. "
+                   "Default = number of CPUs.\n");
+            printf("    -k              Keep the VCD file after the run.\n");
+            return 1;
+        }
+    }
+
+    printf("Generating %lld MB synthetic VCD (%s) ...\n", size_mb, filename);
+    if (generate_vcd(filename, size_mb * 1024 * 1024) != 0) {
+        printf("ERROR: Failed to create %s\n", filename);
+        return 1;
+    }
+
+    if (bench_legacy(filename, &legacy) != 0 ||
+        bench_mapped(filename, &mapped) != 0 ||
+        bench_pipelined(filename, num_workers, &pipelined) != 0) {
+        printf("ERROR: Failed to read %s\n", filename);
+        return 1;
+    }
+
+    print_result("legacy", &legacy, (double)size_mb);
+    print_result("mapped", &mapped, (double)size_mb);
+    print_result("pipeline", &pipelined, (double)size_mb);
+    printf("Speedup: %.1fx (mapped), %.1fx (pipeline, %d threads)\n",
+           legacy.seconds / mapped.seconds,
+           legacy.seconds / pipelined.seconds, num_workers);
+
+    if (!keep_file)
+        remove(filename);
+
+    if (legacy.checksum != mapped.checksum ||
+        legacy.records != mapped.records ||
+        legacy.checksum != pipelined.checksum ||
+        legacy.records != pipelined.records) {
+        printf("ERROR: Decoder outputs differ\n");
+        return 1;
+    }
+
+    return 0;
+}
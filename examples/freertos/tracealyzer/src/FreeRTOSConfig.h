@@ -75,8 +75,14 @@ your application. */
 #define configTIMER_QUEUE_LENGTH                10
 #define configTIMER_TASK_STACK_DEPTH            ( configMINIMAL_STACK_SIZE )
 
-/* Define to trap errors during development. */
+/* Define to trap errors during development. On tile 0 the trace snapshot,
+ * if enabled, is written to flash before trapping. */
+#if ON_TILE(0)
+void xTraceStreamPortOnAssert(void);
+#define configASSERT(x) do { if (!(x)) { xTraceStreamPortOnAssert(); xassert(0); } } while (0)
+#else
 #define configASSERT(x) xassert(x)
+#endif
 
 /* Define to enable debug_printf() */
 #define configENABLE_DEBUG_PRINTF 1
@@ -200,6 +200,10 @@ static void on_btn1_event(uint8_t *num_subprocesses)
 
 static void hbeat_tmr_callback(TimerHandle_t pxTimer)
 {
+#if (TRC_USE_TRACEALYZER_RECORDER == 1)
+    /* A snapshot is taken if the timer service task stops running */
+    xTraceStreamPortWatchdogKick();
+#endif
     xTaskNotify(ctx_gpio_task, TASK_NOTIF_MASK_HBEAT_TIMER, eSetBits);
 }
 
@@ -321,6 +325,10 @@ static void process_task(void *arg)
 
         case STATE_TIMEOUT:
             rtos_printf("Timeout!\n");
+#if (TRC_USE_TRACEALYZER_RECORDER == 1)
+            /* Capture the events leading up to the timeout */
+            xTraceStreamPortSnapshotTrigger();
+#endif
             xTaskNotify(ctx_gpio_task, TASK_NOTIF_MASK_TIMEOUT, eSetBits);
             vTaskDelay(pdMS_TO_TICKS(PROCESS_TIMEOUT_DELAY_MS));
             process_state = STATE_SETUP;
@@ -500,6 +508,7 @@ void main_tile0(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
 #if (USE_TRACE_MODE == TRACE_MODE_TRACEALYZER_STREAMING)
     xTraceInitialize();
     xTraceEnable(TRC_START);
+    xTraceStreamPortStartFlushTask();
 #endif
 
     tile_common_init(c1);
@@ -0,0 +1,556 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+#include <xs1.h>
+#include <xscope.h>
+#include <xcore/hwtimer.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <trcRecorder.h>
+
+#if (TRC_USE_TRACEALYZER_RECORDER == 1)
+#if (TRC_CFG_RECORDER_MODE == TRC_RECORDER_MODE_STREAMING)
+
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1)
+#include "platform/driver_instances.h"
+#endif
+
+#define RING_MASK                   (TRC_CFG_STREAM_PORT_CORE_BUFFER_SIZE - 1)
+#define SNAPSHOT_MASK               (TRC_CFG_STREAM_PORT_SNAPSHOT_BUFFER_SIZE - 1)
+
+#define STATS_PERIOD_TICKS          (1000 * XS1_TIMER_KHZ)
+
+/*
+ * A PSF event is an 8 byte header (16-bit ID, 16-bit event count, 32-bit
+ * timestamp) followed by the number of 32-bit parameters given in the top 4
+ * bits of the ID. Only commits that match this layout are buffered, which
+ * lets the flush task and xscope2psf find the event boundaries in a batch.
+ */
+#define EVENT_HEADER_BYTES          8
+#define EVENT_TIMESTAMP_OFFSET      4
+#define EVENT_LENGTH(id_hi)         (EVENT_HEADER_BYTES + \
+                                     ((id_hi) >> 4) * sizeof(uint32_t))
+#define EVENT_ID(event)             ((((event)[1] & 0x0F) << 8) | (event)[0])
+
+/*
+ * The cores of a tile share memory without caches, so it is sufficient to
+ * stop the compiler from moving ring accesses across the index updates.
+ */
+#define COMPILER_BARRIER()          __asm__ volatile("" ::: "memory")
+
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1)
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT_FLASH_SIZE < \
+     (48 + TRC_CFG_STREAM_PORT_SNAPSHOT_METADATA_SIZE + \
+      TRC_CFG_STREAM_PORT_SNAPSHOT_BUFFER_SIZE))
+#error "TRC_CFG_STREAM_PORT_SNAPSHOT_FLASH_SIZE is too small for a snapshot"
+#endif
+#endif
+
+static TraceStreamPortBuffer_t *port_buffer = NULL;
+static TaskHandle_t flush_task_handle = NULL;
+static TraceStringHandle_t overflow_channel;
+static uint8_t batch[TRC_CFG_STREAM_PORT_BATCH_SIZE];
+
+#if (TRC_CFG_STREAM_PORT_MEASURE_COMMIT == 1)
+static TraceStringHandle_t commit_channel;
+static uint32_t stats_time;
+#endif
+
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1)
+static uint8_t snapshot_metadata[TRC_CFG_STREAM_PORT_SNAPSHOT_METADATA_SIZE];
+static uint32_t snapshot_metadata_len;
+static uint32_t snapshot_metadata_dropped;
+static uint8_t snapshot_events[TRC_CFG_STREAM_PORT_SNAPSHOT_BUFFER_SIZE];
+static uint32_t snapshot_head;
+static uint32_t snapshot_tail;
+static uint32_t snapshot_overwritten;
+
+static volatile uint32_t snapshot_reason;
+static volatile uint32_t snapshot_count;
+static volatile uint32_t watchdog_armed;
+static volatile uint32_t watchdog_kick_time;
+#endif
+
+traceResult xTraceStreamPortInitialize(TraceStreamPortBuffer_t *pxBuffer)
+{
+    if (pxBuffer == NULL)
+        return TRC_FAIL;
+
+    memset(pxBuffer, 0, sizeof(*pxBuffer));
+    port_buffer = pxBuffer;
+
+    return TRC_SUCCESS;
+}
+
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1)
+
+/*
+ * Only called before the flush task starts, or by the flush task itself, so
+ * the metadata area has a single writer.
+ */
+static void snapshot_append_metadata(const uint8_t *data, uint32_t size)
+{
+    uint8_t *p = &snapshot_metadata[snapshot_metadata_len];
+
+    if (size > 0xFFFF ||
+        size + 2 > sizeof(snapshot_metadata) - snapshot_metadata_len) {
+        snapshot_metadata_dropped++;
+        return;
+    }
+
+    p[0] = (uint8_t)size;
+    p[1] = (uint8_t)(size >> 8);
+    memcpy(&p[2], data, size);
+    snapshot_metadata_len += size + 2;
+}
+
+/*
+ * Adds a batch of whole events to the snapshot ring, discarding the oldest
+ * events to make room. Object names are also kept with the metadata, so that
+ * the objects in the snapshot can still be named once the events that named
+ * them have been discarded.
+ */
+static void snapshot_append_events(const uint8_t *events, uint32_t len)
+{
+    uint32_t pos = 0;
+
+    while (pos < len) {
+        const uint8_t *event = &events[pos];
+        uint32_t size = EVENT_LENGTH(event[1]);
+        uint32_t offset;
+        uint32_t first;
+
+        if (EVENT_ID(event) == PSF_EVENT_OBJ_NAME)
+            snapshot_append_metadata(event, size);
+
+        while (TRC_CFG_STREAM_PORT_SNAPSHOT_BUFFER_SIZE -
+                       (snapshot_head - snapshot_tail) < size) {
+            snapshot_tail += EVENT_LENGTH(
+                    snapshot_events[(snapshot_tail + 1) & SNAPSHOT_MASK]);
+            snapshot_overwritten++;
+        }
+
+        offset = snapshot_head & SNAPSHOT_MASK;
+        first = TRC_CFG_STREAM_PORT_SNAPSHOT_BUFFER_SIZE - offset;
+        if (first > size)
+            first = size;
+
+        memcpy(&snapshot_events[offset], event, first);
+        memcpy(snapshot_events, &event[first], size - first);
+        snapshot_head += size;
+        pos += size;
+    }
+}
+
+static void snapshot_write(uint32_t reason)
+{
+    TraceStreamPortSnapshotHeader_t header;
+    const unsigned base = TRC_CFG_STREAM_PORT_SNAPSHOT_FLASH_ADDRESS;
+    unsigned addr = base + sizeof(header);
+    uint32_t event_bytes = snapshot_head - snapshot_tail;
+    uint32_t offset = snapshot_tail & SNAPSHOT_MASK;
+    uint32_t first = TRC_CFG_STREAM_PORT_SNAPSHOT_BUFFER_SIZE - offset;
+    uint64_t commit_ticks = 0;
+
+    if (first > event_bytes)
+        first = event_bytes;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRC_STREAM_PORT_SNAPSHOT_MAGIC, 4);
+    header.version = TRC_STREAM_PORT_SNAPSHOT_VERSION;
+    header.header_size = sizeof(header);
+    header.reason = reason;
+    header.num_cores = TRC_STREAM_PORT_NUM_CORES;
+    header.metadata_bytes = snapshot_metadata_len;
+    header.event_bytes = event_bytes;
+    header.overwritten_events = snapshot_overwritten;
+    header.dropped_metadata = snapshot_metadata_dropped;
+
+    for (int i = 0; i < TRC_STREAM_PORT_NUM_CORES; i++) {
+        TraceStreamPortCoreBuffer_t *core = &port_buffer->cores[i];
+
+        header.dropped_events += core->dropped_events;
+        header.commits += core->commits;
+        commit_ticks += core->commit_ticks;
+        if (core->commit_ticks_max > header.commit_ticks_max)
+            header.commit_ticks_max = core->commit_ticks_max;
+    }
+
+    if (header.commits > 0)
+        header.commit_ticks_mean = (uint32_t)(commit_ticks / header.commits);
+
+    /* The header is written last so that an interrupted snapshot is not
+     * mistaken for a complete one. */
+    rtos_qspi_flash_lock(qspi_flash_ctx);
+    {
+        rtos_qspi_flash_erase(qspi_flash_ctx, base,
+                              sizeof(header) + snapshot_metadata_len +
+                              event_bytes);
+        rtos_qspi_flash_write(qspi_flash_ctx, snapshot_metadata, addr,
+                              snapshot_metadata_len);
+        addr += snapshot_metadata_len;
+        rtos_qspi_flash_write(qspi_flash_ctx, &snapshot_events[offset], addr,
+                              first);
+        addr += first;
+        rtos_qspi_flash_write(qspi_flash_ctx, snapshot_events, addr,
+                              event_bytes - first);
+        rtos_qspi_flash_write(qspi_flash_ctx, (uint8_t *)&header, base,
+                              sizeof(header));
+    }
+    rtos_qspi_flash_unlock(qspi_flash_ctx);
+}
+
+static void snapshot_check_triggers(void)
+{
+    uint32_t reason = snapshot_reason;
+
+    if (reason == 0 && watchdog_armed &&
+        get_reference_time() - watchdog_kick_time >
+                TRC_CFG_STREAM_PORT_SNAPSHOT_WATCHDOG_MS * XS1_TIMER_KHZ) {
+        watchdog_armed = 0;
+        reason = TRC_STREAM_PORT_SNAPSHOT_REASON_WATCHDOG;
+    }
+
+    if (reason != 0) {
+        snapshot_write(reason);
+        snapshot_reason = 0;
+        snapshot_count++;
+    }
+}
+
+#endif /* (TRC_CFG_STREAM_PORT_SNAPSHOT == 1) */
+
+traceResult xTraceStreamPortWriteDirect(void *pvData, uint32_t uiSize,
+                                        int32_t *piBytesWritten)
+{
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1)
+    snapshot_append_metadata(pvData, uiSize);
+#else
+    xscope_bytes(FREERTOS_TRACE, uiSize, pvData);
+#endif
+    *piBytesWritten = (int32_t)uiSize;
+
+    return TRC_SUCCESS;
+}
+
+/*
+ * Copies an event into the core's ring. Returns false if the ring is full.
+ */
+static int ring_commit(TraceStreamPortCoreBuffer_t *core,
+                       const uint8_t *event, uint32_t size)
+{
+    uint32_t head = core->head;
+    uint32_t offset;
+    uint32_t first;
+
+    if (size > TRC_CFG_STREAM_PORT_CORE_BUFFER_SIZE - (head - core->tail))
+        return 0;
+
+    offset = head & RING_MASK;
+    first = TRC_CFG_STREAM_PORT_CORE_BUFFER_SIZE - offset;
+    if (first > size)
+        first = size;
+
+    memcpy(&core->data[offset], event, first);
+    memcpy(core->data, &event[first], size - first);
+
+    COMPILER_BARRIER();
+    core->head = head + size;
+
+    return 1;
+}
+
+/*
+ * Called by the recorder with interrupts masked on the calling core, which is
+ * therefore the only producer for its ring until the event is committed.
+ */
+traceResult xTraceStreamPortCommitEvent(void *pvData, uint32_t uiSize,
+                                        int32_t *piBytesCommitted)
+{
+    const uint8_t *event = pvData;
+    TraceStreamPortCoreBuffer_t *core;
+#if (TRC_CFG_STREAM_PORT_MEASURE_COMMIT == 1)
+    uint32_t start = get_reference_time();
+    uint32_t ticks;
+#endif
+
+    if (flush_task_handle == NULL)
+        return xTraceStreamPortWriteDirect(pvData, uiSize, piBytesCommitted);
+
+    core = &port_buffer->cores[portGET_CORE_ID()];
+    *piBytesCommitted = (int32_t)uiSize;
+
+    if (uiSize > sizeof(batch) || uiSize < EVENT_HEADER_BYTES ||
+        uiSize != EVENT_LENGTH(event[1])) {
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1)
+        /* The metadata area belongs to the flush task once it is running */
+        core->dropped_events++;
+        return TRC_SUCCESS;
+#else
+        return xTraceStreamPortWriteDirect(pvData, uiSize, piBytesCommitted);
+#endif
+    }
+
+    if (!ring_commit(core, event, uiSize))
+        core->dropped_events++;
+
+#if (TRC_CFG_STREAM_PORT_MEASURE_COMMIT == 1)
+    ticks = get_reference_time() - start;
+    core->commits++;
+    core->commit_ticks += ticks;
+    if (ticks > core->commit_ticks_max)
+        core->commit_ticks_max = ticks;
+#endif
+
+    return TRC_SUCCESS;
+}
+
+static uint8_t ring_byte(const TraceStreamPortCoreBuffer_t *core,
+                         uint32_t pos)
+{
+    return core->data[pos & RING_MASK];
+}
+
+static uint32_t ring_timestamp(const TraceStreamPortCoreBuffer_t *core,
+                               uint32_t pos)
+{
+    pos += EVENT_TIMESTAMP_OFFSET;
+
+    return ring_byte(core, pos) |
+           (ring_byte(core, pos + 1) << 8) |
+           (ring_byte(core, pos + 2) << 16) |
+           ((uint32_t)ring_byte(core, pos + 3) << 24);
+}
+
+static void ring_copy(const TraceStreamPortCoreBuffer_t *core, uint32_t pos,
+                      uint8_t *dst, uint32_t len)
+{
+    uint32_t offset = pos & RING_MASK;
+    uint32_t first = TRC_CFG_STREAM_PORT_CORE_BUFFER_SIZE - offset;
+
+    if (first > len)
+        first = len;
+
+    memcpy(dst, &core->data[offset], first);
+    memcpy(&dst[first], core->data, len - first);
+}
+
+static void send_batch(const uint8_t *data, uint32_t len)
+{
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1)
+    snapshot_append_events(data, len);
+#else
+    xscope_bytes(FREERTOS_TRACE, len, data);
+#endif
+}
+
+/*
+ * Sends the events committed so far, oldest first across all cores. Events
+ * committed while this runs are left for the next pass.
+ */
+static void flush_events(void)
+{
+    uint32_t heads[TRC_STREAM_PORT_NUM_CORES];
+    uint32_t tails[TRC_STREAM_PORT_NUM_CORES];
+    size_t len = 0;
+
+    for (int i = 0; i < TRC_STREAM_PORT_NUM_CORES; i++) {
+        heads[i] = port_buffer->cores[i].head;
+        tails[i] = port_buffer->cores[i].tail;
+    }
+
+    COMPILER_BARRIER();
+
+    for (;;) {
+        TraceStreamPortCoreBuffer_t *core;
+        uint32_t timestamp = 0;
+        uint32_t size;
+        int next = -1;
+
+        for (int i = 0; i < TRC_STREAM_PORT_NUM_CORES; i++) {
+            if (tails[i] != heads[i]) {
+                uint32_t ts = ring_timestamp(&port_buffer->cores[i], tails[i]);
+
+                if (next < 0 || (int32_t)(ts - timestamp) < 0) {
+                    next = i;
+                    timestamp = ts;
+                }
+            }
+        }
+
+        if (next < 0)
+            break;
+
+        core = &port_buffer->cores[next];
+        size = EVENT_LENGTH(ring_byte(core, tails[next] + 1));
+
+        if (len + size > sizeof(batch)) {
+            send_batch(batch, len);
+            len = 0;
+        }
+
+        ring_copy(core, tails[next], &batch[len], size);
+        len += size;
+        tails[next] += size;
+
+        COMPILER_BARRIER();
+        core->tail = tails[next];
+    }
+
+    if (len > 0)
+        send_batch(batch, len);
+}
+
+static void report_overflows(void)
+{
+    for (int i = 0; i < TRC_STREAM_PORT_NUM_CORES; i++) {
+        TraceStreamPortCoreBuffer_t *core = &port_buffer->cores[i];
+        uint32_t dropped = core->dropped_events;
+
+        if (dropped != core->reported_drops) {
+            xTracePrintF(overflow_channel, "Core %d dropped %d events", i,
+                         dropped - core->reported_drops);
+            core->reported_drops = dropped;
+        }
+    }
+}
+
+#if (TRC_CFG_STREAM_PORT_MEASURE_COMMIT == 1)
+static void report_commit_stats(void)
+{
+    uint32_t now = get_reference_time();
+    uint32_t commits = 0;
+    uint32_t max_ticks = 0;
+    uint64_t ticks = 0;
+
+    if (now - stats_time < STATS_PERIOD_TICKS)
+        return;
+
+    stats_time = now;
+
+    for (int i = 0; i < TRC_STREAM_PORT_NUM_CORES; i++) {
+        TraceStreamPortCoreBuffer_t *core = &port_buffer->cores[i];
+
+        commits += core->commits;
+        ticks += core->commit_ticks;
+        if (core->commit_ticks_max > max_ticks)
+            max_ticks = core->commit_ticks_max;
+    }
+
+    if (commits > 0)
+        xTracePrintF(commit_channel, "max %d mean %d ticks", max_ticks,
+                     (uint32_t)(ticks / commits));
+}
+#endif
+
+static void flush_task(void *arg)
+{
+    (void)arg;
+
+    for (;;) {
+        flush_events();
+        report_overflows();
+#if (TRC_CFG_STREAM_PORT_MEASURE_COMMIT == 1)
+        report_commit_stats();
+#endif
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1)
+        snapshot_check_triggers();
+#endif
+        vTaskDelay(pdMS_TO_TICKS(TRC_CFG_STREAM_PORT_FLUSH_PERIOD_MS));
+    }
+}
+
+traceResult xTraceStreamPortStartFlushTask(void)
+{
+    if (port_buffer == NULL)
+        return TRC_FAIL;
+
+    if (flush_task_handle != NULL)
+        return TRC_SUCCESS;
+
+    overflow_channel = xTraceRegisterString("Trace Overflow");
+#if (TRC_CFG_STREAM_PORT_MEASURE_COMMIT == 1)
+    commit_channel = xTraceRegisterString("Trace Commit");
+    stats_time = get_reference_time();
+#endif
+
+    if (xTaskCreate((TaskFunction_t) flush_task,
+                    "TzFlush",
+                    RTOS_THREAD_STACK_SIZE(flush_task),
+                    NULL,
+                    TRC_CFG_STREAM_PORT_FLUSH_TASK_PRIORITY,
+                    &flush_task_handle) != pdPASS)
+        return TRC_FAIL;
+
+    return TRC_SUCCESS;
+}
+
+traceResult xTraceStreamPortSnapshotTrigger(void)
+{
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1)
+    if (snapshot_reason == 0)
+        snapshot_reason = TRC_STREAM_PORT_SNAPSHOT_REASON_USER;
+#endif
+
+    return TRC_SUCCESS;
+}
+
+void xTraceStreamPortWatchdogKick(void)
+{
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1) && (TRC_CFG_STREAM_PORT_SNAPSHOT_WATCHDOG_MS > 0)
+    watchdog_kick_time = get_reference_time();
+    watchdog_armed = 1;
+#endif
+}
+
+void xTraceStreamPortOnAssert(void)
+{
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1)
+    uint32_t count = snapshot_count;
+    uint32_t start;
+    uint32_t mask;
+
+    /* The snapshot is written by the flush task, which cannot wait on
+     * itself. */
+    if (flush_task_handle == NULL ||
+        xTaskGetSchedulerState() != taskSCHEDULER_RUNNING ||
+        xTaskGetCurrentTaskHandle() == flush_task_handle)
+        return;
+
+    /* Nor can it be scheduled while the caller holds the kernel lock, as it
+     * does inside a critical section or an ISR. Interrupts are masked in both
+     * cases, so no snapshot is written when they are. Waiting would only
+     * delay the trap by the timeout. */
+    mask = rtos_interrupt_mask_all();
+    rtos_interrupt_mask_set(mask);
+    if (mask == 0)
+        return;
+
+    start = get_reference_time();
+
+    snapshot_reason = TRC_STREAM_PORT_SNAPSHOT_REASON_ASSERT;
+
+    while (snapshot_count == count &&
+           get_reference_time() - start <
+                   TRC_CFG_STREAM_PORT_SNAPSHOT_ASSERT_TIMEOUT_MS * XS1_TIMER_KHZ);
+#endif
+}
+
+#else /* (TRC_CFG_RECORDER_MODE == TRC_RECORDER_MODE_STREAMING) */
+
+void xTraceStreamPortOnAssert(void)
+{
+}
+
+#endif /* (TRC_CFG_RECORDER_MODE == TRC_RECORDER_MODE_STREAMING) */
+
+#else /* (TRC_USE_TRACEALYZER_RECORDER == 1) */
+
+void xTraceStreamPortOnAssert(void)
+{
+}
+
+#endif /* (TRC_USE_TRACEALYZER_RECORDER == 1) */
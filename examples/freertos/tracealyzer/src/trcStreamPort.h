@@ -0,0 +1,189 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * A Tracealyzer stream port that buffers events per core and sends them over
+ * xscope from a flush task.
+ *
+ * Each core commits its events into its own single producer, single consumer
+ * ring, so recording an event never waits on another core or on xscope. The
+ * flush task merges the rings in timestamp order and sends the events in
+ * batches of up to TRC_CFG_STREAM_PORT_BATCH_SIZE bytes per xscope_bytes()
+ * call. Events that do not fit in a core's ring are dropped and counted; the
+ * counts are reported by the flush task as user events on the
+ * "Trace Overflow" channel.
+ *
+ * The header, timestamp configuration and entry table are written by
+ * xTraceEnable() before the scheduler starts, and are sent directly so that
+ * they reach the host as individual records ahead of any buffered events.
+ *
+ * With TRC_CFG_STREAM_PORT_SNAPSHOT enabled, nothing is sent over xscope.
+ * The flush task instead keeps the most recent events in a RAM ring,
+ * discarding the oldest, along with the metadata and object names needed to
+ * decode them. On a failed assertion, a watchdog timeout or a call to
+ * xTraceStreamPortSnapshotTrigger(), the ring is written to the QSPI flash
+ * region given by TRC_CFG_STREAM_PORT_SNAPSHOT_FLASH_ADDRESS, from where
+ * xscope2psf can convert it to PSF. The snapshot layout is:
+ *
+ *   TraceStreamPortSnapshotHeader_t
+ *   metadata: records of u16 length | bytes, in the order they were written
+ *   events:   whole PSF events, oldest first
+ *
+ * The cost of recording an event is the same in both modes: a copy of at
+ * most TRC_CFG_STREAM_PORT_BATCH_SIZE bytes into the core's ring. With
+ * TRC_CFG_STREAM_PORT_MEASURE_COMMIT enabled it is measured in reference
+ * clock ticks, reported once a second on the "Trace Commit" channel and
+ * stored in each snapshot.
+ *
+ * This header is found ahead of the trace driver's trcStreamPort.h, in the
+ * same way as the trc*Config.h files in this directory, and trcStreamPort.c
+ * takes the place of the driver's xscope stream port, which
+ * tracealyzer.cmake leaves out of the build.
+ */
+
+#ifndef TRC_STREAM_PORT_H
+#define TRC_STREAM_PORT_H
+
+#if (TRC_USE_TRACEALYZER_RECORDER == 1)
+#if (TRC_CFG_RECORDER_MODE == TRC_RECORDER_MODE_STREAMING)
+
+#include <stdint.h>
+#include <trcTypes.h>
+#include <trcStreamPortConfig.h>
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRC_USE_INTERNAL_BUFFER (TRC_CFG_STREAM_PORT_USE_INTERNAL_BUFFER)
+
+#if (TRC_USE_INTERNAL_BUFFER == 1)
+#error "The per-core stream port does its own buffering; disable TRC_CFG_STREAM_PORT_USE_INTERNAL_BUFFER"
+#endif
+
+#if ((TRC_CFG_STREAM_PORT_CORE_BUFFER_SIZE) & ((TRC_CFG_STREAM_PORT_CORE_BUFFER_SIZE) - 1)) != 0
+#error "TRC_CFG_STREAM_PORT_CORE_BUFFER_SIZE must be a power of two"
+#endif
+
+#define TRC_STREAM_PORT_NUM_CORES configNUM_CORES
+
+#if (TRC_CFG_STREAM_PORT_SNAPSHOT == 1)
+#if ((TRC_CFG_STREAM_PORT_SNAPSHOT_BUFFER_SIZE) & ((TRC_CFG_STREAM_PORT_SNAPSHOT_BUFFER_SIZE) - 1)) != 0
+#error "TRC_CFG_STREAM_PORT_SNAPSHOT_BUFFER_SIZE must be a power of two"
+#endif
+#endif
+
+#define TRC_STREAM_PORT_SNAPSHOT_MAGIC              "XTSN"
+#define TRC_STREAM_PORT_SNAPSHOT_VERSION            1
+
+#define TRC_STREAM_PORT_SNAPSHOT_REASON_ASSERT      1
+#define TRC_STREAM_PORT_SNAPSHOT_REASON_WATCHDOG    2
+#define TRC_STREAM_PORT_SNAPSHOT_REASON_USER        3
+
+/*
+ * The header at the start of a snapshot in flash. All fields are little
+ * endian.
+ */
+typedef struct TraceStreamPortSnapshotHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t reason;
+    uint32_t num_cores;
+    uint32_t metadata_bytes;
+    uint32_t event_bytes;
+    uint32_t dropped_events;        /* Per-core ring overflows */
+    uint32_t overwritten_events;    /* Discarded from the snapshot ring */
+    uint32_t dropped_metadata;      /* Metadata records that did not fit */
+    uint32_t commits;
+    uint32_t commit_ticks_max;
+    uint32_t commit_ticks_mean;
+} TraceStreamPortSnapshotHeader_t;
+
+/*
+ * The ring a single core records into. head is only written by the owning
+ * core, and tail only by the flush task.
+ */
+typedef struct TraceStreamPortCoreBuffer {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t dropped_events;
+    uint32_t reported_drops;
+    uint32_t commits;
+    uint32_t commit_ticks_max;
+    uint64_t commit_ticks;
+    uint8_t data[TRC_CFG_STREAM_PORT_CORE_BUFFER_SIZE];
+} TraceStreamPortCoreBuffer_t;
+
+typedef struct TraceStreamPortBuffer {
+    TraceStreamPortCoreBuffer_t cores[TRC_STREAM_PORT_NUM_CORES];
+} TraceStreamPortBuffer_t;
+
+traceResult xTraceStreamPortInitialize(TraceStreamPortBuffer_t *pxBuffer);
+
+traceResult xTraceStreamPortCommitEvent(void *pvData, uint32_t uiSize,
+                                        int32_t *piBytesCommitted);
+
+traceResult xTraceStreamPortWriteDirect(void *pvData, uint32_t uiSize,
+                                        int32_t *piBytesWritten);
+
+/*
+ * Creates the task that sends buffered events to the host. Call once after
+ * xTraceEnable(); until then, and until the scheduler has started, events are
+ * sent directly.
+ */
+traceResult xTraceStreamPortStartFlushTask(void);
+
+/*
+ * Requests a snapshot. May be called from any task or ISR; the snapshot is
+ * written by the flush task. Does nothing unless TRC_CFG_STREAM_PORT_SNAPSHOT
+ * is enabled.
+ */
+traceResult xTraceStreamPortSnapshotTrigger(void);
+
+/*
+ * Restarts the snapshot watchdog. Once kicked, a snapshot is written if it is
+ * not kicked again within TRC_CFG_STREAM_PORT_SNAPSHOT_WATCHDOG_MS.
+ */
+void xTraceStreamPortWatchdogKick(void);
+
+/*
+ * Called by configASSERT() on failure. Requests a snapshot and waits, for at
+ * most TRC_CFG_STREAM_PORT_SNAPSHOT_ASSERT_TIMEOUT_MS, for it to be written.
+ * No snapshot is written for an assertion that fails with interrupts masked,
+ * e.g. inside a critical section or an ISR, as the flush task cannot run.
+ */
+void xTraceStreamPortOnAssert(void);
+
+#define xTraceStreamPortAllocate(uiSize, ppvData) \
+    ((void)(uiSize), xTraceStaticBufferGet(ppvData))
+
+#define xTraceStreamPortCommit(pvData, uiSize, piBytesCommitted) \
+    xTraceStreamPortCommitEvent(pvData, uiSize, piBytesCommitted)
+
+#define xTraceStreamPortWriteData(pvData, uiSize, piBytesWritten) \
+    xTraceStreamPortWriteDirect(pvData, uiSize, piBytesWritten)
+
+/* There is no host to target channel over xscope */
+#define xTraceStreamPortReadData(pvData, uiSize, piBytesRead) \
+    ((void)(pvData), (void)(uiSize), (void)(*(piBytesRead) = 0), TRC_SUCCESS)
+
+#define xTraceStreamPortOnEnable(uiStartOption) \
+    ((void)(uiStartOption), TRC_SUCCESS)
+
+#define xTraceStreamPortOnDisable() (TRC_SUCCESS)
+
+#define xTraceStreamPortOnTraceBegin() (TRC_SUCCESS)
+
+#define xTraceStreamPortOnTraceEnd() (TRC_SUCCESS)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* (TRC_CFG_RECORDER_MODE == TRC_RECORDER_MODE_STREAMING) */
+#endif /* (TRC_USE_TRACEALYZER_RECORDER == 1) */
+
+#endif /* TRC_STREAM_PORT_H */
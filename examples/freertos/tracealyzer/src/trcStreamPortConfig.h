@@ -28,6 +28,109 @@ then the internal buffer must be enabled to avoid infinite recursion. */
 */
 #define TRC_CFG_STREAM_PORT_INTERNAL_BUFFER_SIZE 35000
 
+/**
+* @def TRC_CFG_STREAM_PORT_CORE_BUFFER_SIZE
+*
+* @brief The size in bytes of the buffer each core records events into before
+* they are sent by the flush task. It must hold the events a core records
+* while the flush task is kept from running by higher priority tasks; at an
+* average of 12 bytes per event, the default holds about 1300. Must be a power
+* of two.
+*/
+#define TRC_CFG_STREAM_PORT_CORE_BUFFER_SIZE 16384
+
+/**
+* @def TRC_CFG_STREAM_PORT_BATCH_SIZE
+*
+* @brief The maximum number of bytes sent in a single xscope_bytes() call.
+*/
+#define TRC_CFG_STREAM_PORT_BATCH_SIZE 256
+
+/**
+* @def TRC_CFG_STREAM_PORT_FLUSH_PERIOD_MS
+*
+* @brief How often the flush task sends the buffered events.
+*/
+#define TRC_CFG_STREAM_PORT_FLUSH_PERIOD_MS 1
+
+/**
+* @def TRC_CFG_STREAM_PORT_FLUSH_TASK_PRIORITY
+*
+* @brief The priority of the flush task. It runs just above idle so that
+* tracing does not delay the application. If the application keeps all cores
+* busy for long enough to fill a core's buffer, events are dropped and
+* reported on the "Trace Overflow" channel; raise this priority or
+* TRC_CFG_STREAM_PORT_CORE_BUFFER_SIZE if that happens.
+*/
+#define TRC_CFG_STREAM_PORT_FLUSH_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
+
+/**
+* @def TRC_CFG_STREAM_PORT_MEASURE_COMMIT
+*
+* @brief Measures the time taken to record each event, in reference clock
+* ticks. The maximum and mean are reported once a second on the
+* "Trace Commit" user event channel and stored in each snapshot.
+*/
+#define TRC_CFG_STREAM_PORT_MEASURE_COMMIT 1
+
+/**
+* @def TRC_CFG_STREAM_PORT_SNAPSHOT
+*
+* @brief Set to 1 to keep the most recent events in RAM and write them to
+* flash when a snapshot is triggered, instead of streaming them over xscope.
+* For use where no xscope host is attached.
+*/
+#define TRC_CFG_STREAM_PORT_SNAPSHOT 0
+
+/**
+* @def TRC_CFG_STREAM_PORT_SNAPSHOT_BUFFER_SIZE
+*
+* @brief The size in bytes of the RAM ring holding the most recent events.
+* Events are 12 bytes on average, so the ring holds the last
+* (size / (12 * event rate)) seconds. Must be a power of two.
+*/
+#define TRC_CFG_STREAM_PORT_SNAPSHOT_BUFFER_SIZE 65536
+
+/**
+* @def TRC_CFG_STREAM_PORT_SNAPSHOT_METADATA_SIZE
+*
+* @brief The size in bytes of the area holding the trace header, entry table
+* and object names. Must hold the entry table of TRC_CFG_ENTRY_SLOTS entries.
+*/
+#define TRC_CFG_STREAM_PORT_SNAPSHOT_METADATA_SIZE 20480
+
+/**
+* @def TRC_CFG_STREAM_PORT_SNAPSHOT_FLASH_ADDRESS
+*
+* @brief The start of the flash region reserved for snapshots. It must be
+* sector aligned and must not overlap the boot image or any data partition.
+*/
+#define TRC_CFG_STREAM_PORT_SNAPSHOT_FLASH_ADDRESS 0x100000
+
+/**
+* @def TRC_CFG_STREAM_PORT_SNAPSHOT_FLASH_SIZE
+*
+* @brief The size in bytes of the flash region reserved for snapshots.
+*/
+#define TRC_CFG_STREAM_PORT_SNAPSHOT_FLASH_SIZE 0x20000
+
+/**
+* @def TRC_CFG_STREAM_PORT_SNAPSHOT_WATCHDOG_MS
+*
+* @brief A snapshot is written if xTraceStreamPortWatchdogKick() has been
+* called but is then not called again within this time. 0 disables the
+* watchdog.
+*/
+#define TRC_CFG_STREAM_PORT_SNAPSHOT_WATCHDOG_MS 2000
+
+/**
+* @def TRC_CFG_STREAM_PORT_SNAPSHOT_ASSERT_TIMEOUT_MS
+*
+* @brief How long a failed assertion waits for the snapshot to be written
+* before trapping.
+*/
+#define TRC_CFG_STREAM_PORT_SNAPSHOT_ASSERT_TIMEOUT_MS 5000
+
 #ifdef __cplusplus
 }
 #endif
@@ -34,9 +34,27 @@ set(APP_LINK_OPTIONS
     ${CMAKE_CURRENT_LIST_DIR}/src/config.xscope
 )
 
+#**********************
+# Trace Driver
+#**********************
+# src/trcStreamPort.c replaces the trace driver's xscope stream port, and
+# src/trcStreamPort.h is found ahead of the driver's header. Link a copy of
+# the driver without its own trcStreamPort.c, which would otherwise also be
+# compiled into each tile and define the same xTraceStreamPort functions.
+add_library(example_freertos_tracealyzer_trace INTERFACE)
+foreach(PROPERTY INTERFACE_SOURCES INTERFACE_INCLUDE_DIRECTORIES INTERFACE_COMPILE_DEFINITIONS INTERFACE_COMPILE_OPTIONS INTERFACE_LINK_LIBRARIES)
+    get_target_property(VALUE rtos::drivers::trace ${PROPERTY})
+    if(VALUE)
+        if(PROPERTY STREQUAL "INTERFACE_SOURCES")
+            list(FILTER VALUE EXCLUDE REGEX "/trcStreamPort\\.c")
+        endif()
+        set_property(TARGET example_freertos_tracealyzer_trace PROPERTY ${PROPERTY} ${VALUE})
+    endif()
+endforeach()
+
 set(APP_LINK_LIBRARIES
     rtos::bsp_config::xcore_ai_explorer
-    rtos::drivers::trace
+    example_freertos_tracealyzer_trace
 )
 
 #**********************
@@ -0,0 +1,605 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Runs the data pipeline stages of the xscope_fileio example over a WAV file
+ * on the host, as fast as the host allows.
+ *
+ * The pipeline sources are built unchanged against the shim in shim/, which
+ * records each pipeline passed to generic_pipeline_init() rather than
+ * creating tasks for it. The runner then passes each frame through the
+ * pipelines in the order they were initialised, tile 1 and then tile 0,
+ * timing every stage, and optionally checks the output against a reference
+ * WAV file sample for sample.
+ *
+ * As on the device, 16, 24 and 32 bit files of up to appconfMAX_CHANNELS
+ * channels are converted to the pipeline's Q31 channel-major frames on input,
+ * and back on output. The conversion is timed separately from the stages.
+ *
+ * Pipeline taps can be enabled by name, and each is written to its own 32
+ * bit WAV file, named after the output file and the tap.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+
+#include "app_conf.h"
+#include "data_pipeline.h"
+#include "host_shim.h"
+#include "wav_convert.h"
+
+#define WAV_HEADER_BYTES        44
+#define WAV_FORMAT_PCM          1
+#define WAV_FORMAT_EXTENSIBLE   0xfffe
+
+#define MAX_TOTAL_STAGES        (HOST_SHIM_MAX_PIPELINES * HOST_SHIM_MAX_STAGES)
+#define MAX_TAPS                MAX_TOTAL_STAGES
+
+/* The data pipeline sources for each tile, built with their entry points
+ * renamed so that both can be linked */
+void data_pipeline_init_tile0(void *input_app_data, void *output_app_data);
+void data_pipeline_init_tile1(void *input_app_data, void *output_app_data);
+
+typedef struct {
+    uint8_t *file;
+    size_t file_len;
+    uint16_t audio_format;
+    uint16_t num_channels;
+    uint32_t sample_rate;
+    uint16_t bit_depth;
+    const uint8_t *data;
+    size_t data_len;
+} wav_file_t;
+
+typedef struct {
+    uint64_t ns;
+    uint64_t max_ns;
+} stage_time_t;
+
+typedef struct {
+    const char *name;
+    uint8_t *data;
+    size_t len;
+    size_t size;
+} tap_capture_t;
+
+static const uint8_t *input_data;
+static uint8_t *output_data;
+static bool input_eos;
+static bool output_eos;
+
+static unsigned file_channels;
+static unsigned file_bit_depth;
+static size_t file_frame_bytes;
+static uint64_t convert_ns;
+
+/* A frame of the file, word aligned for the sample conversion */
+static int32_t file_samples[appconfMAX_CHANNELS * appconfFRAME_ADVANCE];
+
+static tap_capture_t taps[MAX_TAPS];
+static int tap_count;
+static bool tap_capture;
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return get_u16(p) | ((uint32_t) get_u16(p + 2) << 16);
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, (uint16_t) v);
+    put_u16(p + 2, (uint16_t) (v >> 16));
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint8_t *read_file(const char *filename, size_t *len)
+{
+    FILE *f;
+    uint8_t *buf = NULL;
+    long size;
+
+    f = fopen(filename, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 &&
+        fseek(f, 0, SEEK_SET) == 0) {
+        buf = malloc(size > 0 ? size : 1);
+        if (buf != NULL && fread(buf, 1, size, f) != (size_t) size) {
+            free(buf);
+            buf = NULL;
+        }
+        *len = size;
+    }
+
+    fclose(f);
+    return buf;
+}
+
+/* Reads a WAV file and finds its format and data. Returns 0 on success. */
+static int wav_open(wav_file_t *wav, const char *filename)
+{
+    size_t pos = 12;
+    bool have_fmt = false;
+
+    memset(wav, 0, sizeof(*wav));
+    wav->file = read_file(filename, &wav->file_len);
+    if (wav->file == NULL) {
+        fprintf(stderr, "Error: cannot read %s\n", filename);
+        return -1;
+    }
+
+    if (wav->file_len < 12 || memcmp(wav->file, "RIFF", 4) != 0 ||
+        memcmp(&wav->file[8], "WAVE", 4) != 0) {
+        fprintf(stderr, "Error: %s is not a WAV file\n", filename);
+        return -1;
+    }
+
+    while (pos + 8 <= wav->file_len) {
+        const uint8_t *chunk = &wav->file[pos];
+        size_t chunk_len = get_u32(&chunk[4]);
+        size_t avail = wav->file_len - pos - 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_len >= 16 && chunk_len <= avail) {
+            wav->audio_format = get_u16(&chunk[8]);
+            wav->num_channels = get_u16(&chunk[10]);
+            wav->sample_rate = get_u32(&chunk[12]);
+            wav->bit_depth = get_u16(&chunk[22]);
+            /* The first 2 bytes of the extensible format GUID are the format */
+            if (wav->audio_format == WAV_FORMAT_EXTENSIBLE && chunk_len >= 26) {
+                wav->audio_format = get_u16(&chunk[32]);
+            }
+            have_fmt = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            wav->data = &chunk[8];
+            wav->data_len = chunk_len <= avail ? chunk_len : avail;
+            break;
+        }
+
+        /* Chunks are padded to an even length */
+        pos += 8 + chunk_len + (chunk_len & 1);
+    }
+
+    if (!have_fmt || wav->data == NULL) {
+        fprintf(stderr, "Error: %s has no %s chunk\n", filename,
+                have_fmt ? "data" : "fmt");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int wav_write(const char *filename, const wav_file_t *format,
+                     const uint8_t *data, size_t data_len)
+{
+    uint8_t header[WAV_HEADER_BYTES];
+    unsigned bytes_per_frame = format->num_channels * (format->bit_depth / 8);
+    FILE *f;
+    int ret = 0;
+
+    memcpy(&header[0], "RIFF", 4);
+    put_u32(&header[4], (uint32_t) (data_len + WAV_HEADER_BYTES - 8));
+    memcpy(&header[8], "WAVEfmt ", 8);
+    put_u32(&header[16], 16);
+    put_u16(&header[20], WAV_FORMAT_PCM);
+    put_u16(&header[22], format->num_channels);
+    put_u32(&header[24], format->sample_rate);
+    put_u32(&header[28], format->sample_rate * bytes_per_frame);
+    put_u16(&header[32], (uint16_t) bytes_per_frame);
+    put_u16(&header[34], format->bit_depth);
+    memcpy(&header[36], "data", 4);
+    put_u32(&header[40], (uint32_t) data_len);
+
+    f = fopen(filename, "wb");
+    if (f == NULL ||
+        fwrite(header, 1, sizeof(header), f) != sizeof(header) ||
+        fwrite(data, 1, data_len, f) != data_len) {
+        fprintf(stderr, "Error: cannot write %s\n", filename);
+        ret = -1;
+    }
+    if (f != NULL && fclose(f) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+/* Reads a little endian sample of bytes bytes, sign extended */
+static int32_t get_sample(const uint8_t *p, unsigned bytes)
+{
+    uint32_t v = 0;
+
+    for (unsigned i = 0; i < bytes; i++) {
+        v |= (uint32_t) p[i] << (8 * (4 - bytes + i));
+    }
+    return (int32_t) v >> (8 * (4 - bytes));
+}
+
+/* Compares the output with a reference, sample by sample. Returns the number
+ * of samples that differ, counting any difference in length as well. */
+static size_t compare_samples(const uint8_t *out, size_t out_len,
+                              const uint8_t *ref, size_t ref_len,
+                              unsigned bytes)
+{
+    size_t count = (out_len < ref_len ? out_len : ref_len) / bytes;
+    size_t mismatches = 0;
+    size_t first = 0;
+    int32_t got = 0, expected = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t a = get_sample(&out[i * bytes], bytes);
+        int32_t b = get_sample(&ref[i * bytes], bytes);
+
+        if (a != b) {
+            if (mismatches++ == 0) {
+                first = i;
+                got = a;
+                expected = b;
+            }
+        }
+    }
+
+    if (mismatches > 0) {
+        printf("Mismatch: %zu of %zu samples differ, first at sample %zu "
+               "(got %d, expected %d)\n",
+               mismatches, count, first, got, expected);
+    }
+    if (out_len != ref_len) {
+        printf("Mismatch: output has %zu samples, reference has %zu\n",
+               out_len / bytes, ref_len / bytes);
+        mismatches += (out_len > ref_len ? out_len - ref_len : ref_len - out_len) /
+                      bytes;
+    }
+
+    return mismatches;
+}
+
+size_t data_pipeline_input(void *input_app_data,
+                           int8_t **input_data_frame,
+                           size_t frame_count)
+{
+    (void) input_app_data;
+
+    if (input_eos) {
+        return 0;
+    }
+
+    int32_t (*frame)[appconfFRAME_ADVANCE] = (void *) input_data_frame;
+    uint64_t start;
+
+    memcpy(file_samples, input_data, file_frame_bytes);
+    input_data += file_frame_bytes;
+
+    start = now_ns();
+    wav_convert_to_q31(&frame[0][0], appconfFRAME_ADVANCE, file_samples,
+                       file_channels, file_bit_depth, appconfFRAME_ADVANCE);
+    convert_ns += now_ns() - start;
+
+    /* Channels beyond those in the file are zero */
+    memset(frame[file_channels], 0x00,
+           (appconfMAX_CHANNELS - file_channels) * sizeof(frame[0]));
+
+    return frame_count;
+}
+
+void data_pipeline_input_done(void *input_app_data)
+{
+    (void) input_app_data;
+}
+
+int data_pipeline_output(void *output_app_data,
+                         int8_t **output_data_frame,
+                         size_t frame_count)
+{
+    (void) output_app_data;
+
+    if (frame_count == 0) {
+        output_eos = true;
+        return DATA_PIPELINE_FREE_FRAME;
+    }
+
+    int32_t (*frame)[appconfFRAME_ADVANCE] = (void *) output_data_frame;
+    uint64_t start = now_ns();
+
+    wav_convert_from_q31(file_samples, &frame[0][0], appconfFRAME_ADVANCE,
+                         file_channels, file_bit_depth, appconfFRAME_ADVANCE);
+    convert_ns += now_ns() - start;
+
+    memcpy(output_data, file_samples, file_frame_bytes);
+    output_data += file_frame_bytes;
+
+    return DATA_PIPELINE_FREE_FRAME;
+}
+
+void data_pipeline_tap_output(const pipeline_tap_frame_t *frame, size_t frame_bytes)
+{
+    static int32_t tap_samples[appconfMAX_CHANNELS * appconfFRAME_ADVANCE];
+    size_t bytes = appconfFRAME_ADVANCE * file_channels * sizeof(int32_t);
+    tap_capture_t *tap = NULL;
+
+    /* Ignore the end of stream markers, and repeats of the input */
+    if (frame_bytes == PIPELINE_TAP_END_BYTES || !tap_capture) {
+        return;
+    }
+
+    for (int i = 0; i < tap_count; i++) {
+        if (strcmp(taps[i].name, frame->name) == 0) {
+            tap = &taps[i];
+        }
+    }
+    if (tap == NULL) {
+        return;
+    }
+
+    if (tap->len + bytes > tap->size) {
+        tap->size = 2 * (tap->len + bytes);
+        tap->data = realloc(tap->data, tap->size);
+        if (tap->data == NULL) {
+            fprintf(stderr, "Error: out of memory\n");
+            exit(2);
+        }
+    }
+
+    wav_convert_from_q31(tap_samples, &frame->data[0][0], appconfFRAME_ADVANCE,
+                         file_channels, 32, appconfFRAME_ADVANCE);
+    memcpy(tap->data + tap->len, tap_samples, bytes);
+    tap->len += bytes;
+}
+
+/* Writes each tap to <output>_<tap>.wav, where output is the output file
+ * name without its extension */
+static int write_taps(const char *out_filename, const wav_file_t *format)
+{
+    wav_file_t tap_format = *format;
+    size_t prefix_len = strlen(out_filename);
+
+    tap_format.bit_depth = 32;
+    if (prefix_len >= 4 && strcmp(&out_filename[prefix_len - 4], ".wav") == 0) {
+        prefix_len -= 4;
+    }
+
+    for (int i = 0; i < tap_count; i++) {
+        char filename[FILENAME_MAX];
+
+        snprintf(filename, sizeof(filename), "%.*s_%s.wav",
+                 (int) prefix_len, out_filename, taps[i].name);
+        if (wav_write(filename, &tap_format, taps[i].data, taps[i].len) != 0) {
+            return -1;
+        }
+        printf("Tap %s written to %s\n", taps[i].name, filename);
+    }
+
+    return 0;
+}
+
+/* Passes one frame through every pipeline, returning the time taken */
+static uint64_t run_frame(stage_time_t *stage_times)
+{
+    uint64_t frame_start = now_ns();
+    int s = 0;
+
+    for (int p = 0; p < host_pipeline_count; p++) {
+        host_pipeline_t *pipeline = &host_pipelines[p];
+        void *frame = pipeline->input(pipeline->input_data);
+
+        for (int i = 0; i < pipeline->stage_count; i++, s++) {
+            uint64_t start = now_ns();
+            uint64_t ns;
+
+            pipeline->stages[i](frame);
+            ns = now_ns() - start;
+
+            stage_times[s].ns += ns;
+            if (ns > stage_times[s].max_ns) {
+                stage_times[s].max_ns = ns;
+            }
+        }
+
+        if (pipeline->output(frame, pipeline->output_data) == DATA_PIPELINE_FREE_FRAME) {
+            vPortFree(frame);
+        }
+    }
+
+    return now_ns() - frame_start;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [-o output.wav] [-r reference.wav] [-n repeat] [-t tap] [-v] input.wav\n"
+            "\n"
+            "Runs the data pipeline stages over input.wav and reports the time each\n"
+            "stage takes per frame.\n"
+            "\n"
+            "  -o  Write the output to output.wav\n"
+            "  -r  Check that the output is bit exact with reference.wav\n"
+            "  -n  Process the input this many times, for more stable timings\n"
+            "  -t  Capture the frames passing the named tap to output_tap.wav, where\n"
+            "      output is the -o file name, or out, without its extension. May be\n"
+            "      given more than once.\n"
+            "  -v  Print the output of the pipeline stages\n"
+            "\n"
+            "Exits with 1 if the output does not match the reference, and 2 on\n"
+            "any other error.\n",
+            name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *in_filename = NULL;
+    const char *out_filename = NULL;
+    const char *ref_filename = NULL;
+    unsigned repeat = 1;
+    wav_file_t in_wav;
+    wav_file_t ref_wav;
+    uint8_t *out_buf;
+    size_t block_count;
+    size_t out_len;
+    stage_time_t stage_times[MAX_TOTAL_STAGES] = {{0}};
+    stage_time_t eos_times[MAX_TOTAL_STAGES] = {{0}};
+    uint64_t total_ns = 0;
+    uint64_t frames = 0;
+    int stage_total = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_filename = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            ref_filename = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            repeat = (unsigned) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc && tap_count < MAX_TAPS) {
+            taps[tap_count++].name = argv[++i];
+        } else if (strcmp(argv[i], "-v") == 0) {
+            host_shim_verbose = true;
+        } else if (argv[i][0] != '-' && in_filename == NULL) {
+            in_filename = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (in_filename == NULL || repeat == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (wav_open(&in_wav, in_filename) != 0) {
+        return 2;
+    }
+
+    /* The same checks as the file I/O task on the device */
+    if (in_wav.audio_format != WAV_FORMAT_PCM) {
+        fprintf(stderr, "Error: audio format(%d) is not PCM\n", in_wav.audio_format);
+        return 2;
+    }
+    if (!wav_convert_supported(in_wav.bit_depth)) {
+        fprintf(stderr, "Error: unsupported wav bit depth (%d) for %s file. Only 16, 24 and 32 supported\n",
+                in_wav.bit_depth, in_filename);
+        return 2;
+    }
+    if (in_wav.num_channels < 1 || in_wav.num_channels > appconfMAX_CHANNELS) {
+        fprintf(stderr, "Error: wav num channels(%d) must be from 1 to %u\n",
+                in_wav.num_channels, appconfMAX_CHANNELS);
+        return 2;
+    }
+    file_channels = in_wav.num_channels;
+    file_bit_depth = in_wav.bit_depth;
+    file_frame_bytes = appconfFRAME_ADVANCE * file_channels * (file_bit_depth / 8);
+
+    /* Only whole frames are processed, as on the device */
+    block_count = in_wav.data_len / file_frame_bytes;
+    out_len = block_count * file_frame_bytes;
+    out_buf = malloc(out_len > 0 ? out_len : 1);
+    if (out_buf == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 2;
+    }
+
+    /* Frames enter the pipeline on tile 1 and leave it on tile 0 */
+    data_pipeline_init_tile1(NULL, NULL);
+    data_pipeline_init_tile0(NULL, NULL);
+
+    for (int i = 0; i < tap_count; i++) {
+        if (!pipeline_tap_enable(taps[i].name, 1)) {
+            fprintf(stderr, "Error: no tap named %s\n", taps[i].name);
+            return 2;
+        }
+    }
+
+    for (unsigned r = 0; r < repeat; r++) {
+        tap_capture = (r == 0);
+        input_data = in_wav.data;
+        output_data = out_buf;
+
+        for (size_t b = 0; b < block_count; b++) {
+            total_ns += run_frame(stage_times);
+            frames++;
+        }
+    }
+
+    /* The end of stream token must reach the output, after every frame */
+    input_eos = true;
+    (void) run_frame(eos_times);
+    if (!output_eos) {
+        fprintf(stderr, "Error: end of stream did not reach the pipeline output\n");
+        return 2;
+    }
+
+    for (int p = 0; p < host_pipeline_count; p++) {
+        stage_total += host_pipelines[p].stage_count;
+    }
+
+    printf("%s: %zu frames of %d samples, %u channel(s) of %u bits at %u Hz\n",
+           in_filename, block_count, appconfFRAME_ADVANCE,
+           in_wav.num_channels, in_wav.bit_depth, in_wav.sample_rate);
+
+    if (frames > 0) {
+        double audio_s = (double) frames * appconfFRAME_ADVANCE / in_wav.sample_rate;
+
+        for (int s = 0; s < stage_total; s++) {
+            printf("  stage %d: %8.1f ns/frame (max %llu ns)\n",
+                   s + 1,
+                   (double) stage_times[s].ns / frames,
+                   (unsigned long long) stage_times[s].max_ns);
+        }
+        printf("  convert: %8.1f ns/frame, to and from %u bit samples\n",
+               (double) convert_ns / frames, in_wav.bit_depth);
+        printf("  total:   %8.1f ns/frame, %.0fx real time\n",
+               (double) total_ns / frames,
+               audio_s * 1e9 / (total_ns > 0 ? total_ns : 1));
+    }
+
+    if (out_filename != NULL &&
+        wav_write(out_filename, &in_wav, out_buf, out_len) != 0) {
+        return 2;
+    }
+
+    if (write_taps(out_filename != NULL ? out_filename : "out", &in_wav) != 0) {
+        return 2;
+    }
+
+    if (ref_filename != NULL) {
+        if (wav_open(&ref_wav, ref_filename) != 0) {
+            return 2;
+        }
+        if (ref_wav.num_channels != in_wav.num_channels ||
+            ref_wav.bit_depth != in_wav.bit_depth) {
+            printf("Mismatch: reference has %u channel(s) of %u bits, output has %u of %u\n",
+                   ref_wav.num_channels, ref_wav.bit_depth,
+                   in_wav.num_channels, in_wav.bit_depth);
+            return 1;
+        }
+        if (compare_samples(out_buf, out_len, ref_wav.data, ref_wav.data_len,
+                            in_wav.bit_depth / 8) != 0) {
+            return 1;
+        }
+        printf("Bit exact with %s\n", ref_filename);
+    }
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef HOST_SHIM_FREERTOS_H_
+#define HOST_SHIM_FREERTOS_H_
+
+/*
+ * Just enough of FreeRTOS for the data pipeline sources to build on the host.
+ * The pipeline runner calls the input, stage and output functions directly,
+ * in a single thread, so there is no scheduler.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "platform.h"
+#include "rtos_printf.h"
+#include "xcore/assert.h"
+
+#define configMAX_PRIORITIES        32
+#define configMINIMAL_STACK_SIZE    256
+#define configSTACK_DEPTH_TYPE      uint32_t
+
+#define portMAX_DELAY               0xffffffffUL
+#define pdMS_TO_TICKS(ms)           (ms)
+#define pdTRUE                      1
+#define pdFALSE                     0
+
+#define RTOS_THREAD_STACK_SIZE(fn)  0
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pvPortMalloc(size)          malloc(size)
+#define vPortFree(p)                free(p)
+
+static inline uint32_t rtos_interrupt_mask_all(void) { return 0; }
+static inline void rtos_interrupt_mask_set(uint32_t mask) { (void) mask; }
+
+#endif /* HOST_SHIM_FREERTOS_H_ */
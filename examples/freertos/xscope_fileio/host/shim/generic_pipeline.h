@@ -0,0 +1,24 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef HOST_SHIM_GENERIC_PIPELINE_H_
+#define HOST_SHIM_GENERIC_PIPELINE_H_
+
+#include <stddef.h>
+
+typedef void *(*pipeline_input_t)(void *input_app_data);
+typedef int (*pipeline_output_t)(void *data, void *output_app_data);
+typedef void (*pipeline_stage_t)(void *data);
+
+/* Records the pipeline, for the runner to call its functions directly,
+ * instead of creating a task per stage */
+void generic_pipeline_init(const pipeline_input_t input,
+                           const pipeline_output_t output,
+                           void * const input_data,
+                           void * const output_data,
+                           const pipeline_stage_t * const stage_functions,
+                           const size_t * const stage_stack_sizes,
+                           const int pipeline_priority,
+                           const int stage_count);
+
+#endif /* HOST_SHIM_GENERIC_PIPELINE_H_ */
@@ -0,0 +1,146 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "frame_stream.h"
+#include "host_shim.h"
+#include "platform/driver_instances.h"
+#include "xcore/hwtimer.h"
+
+/* Frames are passed between the pipelines on the host through a queue per
+ * intertile port. Only as many frames as the sender holds credits for can
+ * be queued. */
+#define HOST_SHIM_MAX_PORTS         32
+#define HOST_SHIM_MAX_QUEUED        16
+#define HOST_SHIM_MAX_FRAME_BYTES   65536
+
+typedef struct {
+    size_t len[HOST_SHIM_MAX_QUEUED];
+    uint8_t *data[HOST_SHIM_MAX_QUEUED];
+    unsigned head;
+    unsigned tail;
+} host_port_t;
+
+host_pipeline_t host_pipelines[HOST_SHIM_MAX_PIPELINES];
+int host_pipeline_count;
+bool host_shim_verbose;
+
+rtos_intertile_t *intertile_ctx;
+
+static host_port_t host_ports[HOST_SHIM_MAX_PORTS];
+
+int rtos_printf(const char *fmt, ...)
+{
+    va_list ap;
+    int ret = 0;
+
+    if (host_shim_verbose) {
+        va_start(ap, fmt);
+        ret = vprintf(fmt, ap);
+        va_end(ap);
+    }
+    return ret;
+}
+
+uint32_t get_reference_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t) (ts.tv_sec * 100000000ULL + ts.tv_nsec / 10);
+}
+
+void generic_pipeline_init(const pipeline_input_t input,
+                           const pipeline_output_t output,
+                           void * const input_data,
+                           void * const output_data,
+                           const pipeline_stage_t * const stage_functions,
+                           const size_t * const stage_stack_sizes,
+                           const int pipeline_priority,
+                           const int stage_count)
+{
+    host_pipeline_t *pipeline;
+
+    (void) stage_stack_sizes;
+    (void) pipeline_priority;
+
+    xassert(host_pipeline_count < HOST_SHIM_MAX_PIPELINES);
+    xassert(stage_count <= HOST_SHIM_MAX_STAGES);
+
+    pipeline = &host_pipelines[host_pipeline_count++];
+    pipeline->input = input;
+    pipeline->output = output;
+    pipeline->input_data = input_data;
+    pipeline->output_data = output_data;
+    memcpy(pipeline->stages, stage_functions, stage_count * sizeof(pipeline_stage_t));
+    pipeline->stage_count = stage_count;
+}
+
+void frame_stream_tx_init(frame_stream_t *stream,
+                          rtos_intertile_t *ctx,
+                          uint8_t data_port,
+                          uint8_t credit_port,
+                          unsigned initial_credits,
+                          unsigned priority)
+{
+    (void) initial_credits;
+    (void) priority;
+
+    stream->ctx = ctx;
+    stream->data_port = data_port;
+    stream->credit_port = credit_port;
+}
+
+void frame_stream_rx_init(frame_stream_t *stream,
+                          rtos_intertile_t *ctx,
+                          uint8_t data_port,
+                          uint8_t credit_port,
+                          unsigned credit_batch)
+{
+    stream->ctx = ctx;
+    stream->data_port = data_port;
+    stream->credit_port = credit_port;
+    stream->credit_batch = credit_batch;
+    stream->credits_owed = 0;
+}
+
+void frame_stream_send(frame_stream_t *stream, const void *frame, size_t len)
+{
+    host_port_t *port = &host_ports[stream->data_port % HOST_SHIM_MAX_PORTS];
+    unsigned slot = port->head % HOST_SHIM_MAX_QUEUED;
+
+    xassert(port->head - port->tail < HOST_SHIM_MAX_QUEUED);
+    xassert(len <= HOST_SHIM_MAX_FRAME_BYTES);
+
+    if (port->data[slot] == NULL) {
+        port->data[slot] = malloc(HOST_SHIM_MAX_FRAME_BYTES);
+        xassert(port->data[slot] != NULL);
+    }
+    memcpy(port->data[slot], frame, len);
+    port->len[slot] = len;
+    port->head++;
+}
+
+size_t frame_stream_receive(frame_stream_t *stream, void *frame, size_t max_len)
+{
+    host_port_t *port = &host_ports[stream->data_port % HOST_SHIM_MAX_PORTS];
+    unsigned slot = port->tail % HOST_SHIM_MAX_QUEUED;
+
+    /* The runner only calls a pipeline's input once a frame has been sent */
+    xassert(port->head != port->tail);
+    xassert(port->len[slot] <= max_len);
+
+    memcpy(frame, port->data[slot], port->len[slot]);
+    port->tail++;
+    return port->len[slot];
+}
+
+void frame_stream_release(frame_stream_t *stream)
+{
+    (void) stream;
+}
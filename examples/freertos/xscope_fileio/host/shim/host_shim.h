@@ -0,0 +1,31 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef HOST_SHIM_H_
+#define HOST_SHIM_H_
+
+#include <stdbool.h>
+
+#include "generic_pipeline.h"
+
+#define HOST_SHIM_MAX_PIPELINES 4
+#define HOST_SHIM_MAX_STAGES    16
+
+/* A pipeline as passed to generic_pipeline_init() */
+typedef struct {
+    pipeline_input_t input;
+    pipeline_output_t output;
+    void *input_data;
+    void *output_data;
+    pipeline_stage_t stages[HOST_SHIM_MAX_STAGES];
+    int stage_count;
+} host_pipeline_t;
+
+/* The pipelines, in the order they were initialised */
+extern host_pipeline_t host_pipelines[HOST_SHIM_MAX_PIPELINES];
+extern int host_pipeline_count;
+
+/* Whether rtos_printf() output is printed */
+extern bool host_shim_verbose;
+
+#endif /* HOST_SHIM_H_ */
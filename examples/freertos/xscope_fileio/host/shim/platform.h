@@ -0,0 +1,11 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef HOST_SHIM_PLATFORM_H_
+#define HOST_SHIM_PLATFORM_H_
+
+/* The sources for both tiles are built into the one host program */
+#define ON_TILE(t)          1
+#define THIS_XCORE_TILE     0
+
+#endif /* HOST_SHIM_PLATFORM_H_ */
@@ -0,0 +1,11 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef HOST_SHIM_DRIVER_INSTANCES_H_
+#define HOST_SHIM_DRIVER_INSTANCES_H_
+
+#include "rtos_intertile.h"
+
+extern rtos_intertile_t *intertile_ctx;
+
+#endif /* HOST_SHIM_DRIVER_INSTANCES_H_ */
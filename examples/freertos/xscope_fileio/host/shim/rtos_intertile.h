@@ -0,0 +1,9 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef HOST_SHIM_RTOS_INTERTILE_H_
+#define HOST_SHIM_RTOS_INTERTILE_H_
+
+typedef struct rtos_intertile_struct rtos_intertile_t;
+
+#endif /* HOST_SHIM_RTOS_INTERTILE_H_ */
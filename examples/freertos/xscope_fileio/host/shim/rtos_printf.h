@@ -0,0 +1,11 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef HOST_SHIM_RTOS_PRINTF_H_
+#define HOST_SHIM_RTOS_PRINTF_H_
+
+/* Output from the pipeline sources, such as per frame timings, is only
+ * printed when the runner is verbose */
+int rtos_printf(const char *fmt, ...);
+
+#endif /* HOST_SHIM_RTOS_PRINTF_H_ */
@@ -0,0 +1,11 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef HOST_SHIM_SEMPHR_H_
+#define HOST_SHIM_SEMPHR_H_
+
+#include "queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#endif /* HOST_SHIM_SEMPHR_H_ */
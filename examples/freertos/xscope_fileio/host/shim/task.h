@@ -0,0 +1,14 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef HOST_SHIM_TASK_H_
+#define HOST_SHIM_TASK_H_
+
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+
+#define taskYIELD()                 do { } while (0)
+#define vTaskDelay(ticks)           ((void) (ticks))
+
+#endif /* HOST_SHIM_TASK_H_ */
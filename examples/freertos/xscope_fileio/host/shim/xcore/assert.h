@@ -0,0 +1,23 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef HOST_SHIM_XCORE_ASSERT_H_
+#define HOST_SHIM_XCORE_ASSERT_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Like the xcore xassert(), this is not removed by NDEBUG: the expression is
+ * always evaluated and a failure always traps.
+ */
+#define xassert(e) \
+    do { \
+        if (!(e)) { \
+            fprintf(stderr, "%s:%d: xassert(%s) failed\n", \
+                    __FILE__, __LINE__, #e); \
+            abort(); \
+        } \
+    } while (0)
+
+#endif /* HOST_SHIM_XCORE_ASSERT_H_ */
@@ -0,0 +1,12 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef HOST_SHIM_XCORE_HWTIMER_H_
+#define HOST_SHIM_XCORE_HWTIMER_H_
+
+#include <stdint.h>
+
+/* The host monotonic clock, in 100 MHz reference clock ticks */
+uint32_t get_reference_time(void);
+
+#endif /* HOST_SHIM_XCORE_HWTIMER_H_ */
@@ -6,6 +6,9 @@
 
 /* Intertile port settings */
 #define appconfEXAMPLE_DATA_PORT          16
+#define appconfEXAMPLE_CREDIT_PORT        17
+#define appconfEXAMPLE_TAP_PORT           18
+#define appconfEXAMPLE_TAP_CREDIT_PORT    19
 
 /* Application tile specifiers */
 #include "platform/driver_instances.h"
@@ -13,12 +16,62 @@
 /* App configuration */
 #define appconfINPUT_FILENAME  "in.wav\0"
 #define appconfOUTPUT_FILENAME "out.wav\0"
-#define appconfMAX_CHANNELS 1
+#define appconfMAX_CHANNELS 2
 #define appconfFRAME_ADVANCE 240
 #define appconfFRAME_ELEMENT_SIZE sizeof(int32_t)
-#define appconfDATA_FRAME_SIZE_BYTES   (appconfFRAME_ADVANCE * appconfFRAME_ELEMENT_SIZE)
+#define appconfDATA_FRAME_SIZE_BYTES   (appconfMAX_CHANNELS * appconfFRAME_ADVANCE * appconfFRAME_ELEMENT_SIZE)
 
-#define appconfAPP_NOTIFY_FILEIO_DONE  0
+/* The number of frames the fileio task keeps in the data pipeline at once.
+ * Reads run this many frames ahead of the writes. */
+#define appconfFILEIO_FRAMES_IN_FLIGHT 4
+
+/* The number of frames transferred per host request. The input file is read,
+ * and the output file written, in chunks the size of this many pipeline
+ * frames, which hold more frames of a file with fewer channels or smaller
+ * samples. */
+#define appconfFILEIO_CHUNK_FRAMES 16
+#define appconfFILEIO_CHUNK_SIZE_BYTES (appconfFILEIO_CHUNK_FRAMES * appconfDATA_FRAME_SIZE_BYTES)
+
+/* Set to 1 to process each pair of input and output files listed in the
+ * manifest in turn, one pair per line, rather than appconfINPUT_FILENAME
+ * alone. The manifest is read whole, so must be smaller than
+ * appconfFILEIO_BATCH_MANIFEST_MAX_BYTES. */
+#define appconfFILEIO_BATCH_MODE 0
+#define appconfFILEIO_BATCH_MANIFEST_FILENAME "batch.txt\0"
+#define appconfFILEIO_BATCH_MANIFEST_MAX_BYTES 8192
+
+/* All xscope fileio calls are made by a single task, pinned to the core
+ * given by this mask, which serves up to this many queued requests */
+#define appconfFILEIO_ASYNC_CORE_MASK   0x10
+#define appconfFILEIO_ASYNC_QUEUE_DEPTH 4
+
+/* The number of frames in the data pipeline frame pool on each tile. Must be
+ * a power of two, and more than appconfFILEIO_FRAMES_IN_FLIGHT. */
+#define appconfDATA_PIPELINE_POOL_FRAMES 8
+
+/* Frames are sent between the tiles with credit based flow control. The
+ * sender starts with a credit for each frame the receiving pipeline can
+ * take, leaving one frame of its pool for the pipeline input to hold while it
+ * waits, and the receiver returns credits in batches of this many. */
+#define appconfINTERTILE_FRAME_CREDITS   (appconfDATA_PIPELINE_POOL_FRAMES - 1)
+#define appconfINTERTILE_CREDIT_BATCH    2
+
+/* The pipeline taps, named after the stages they follow, that are enabled
+ * at startup, separated by spaces. For example:
+ *   "stage_preemption_disabled stage_3"
+ * Each enabled tap is captured to its own file, named after the output file
+ * and the tap, for example out_stage_3.wav. At most appconfFILEIO_MAX_TAPS
+ * taps can be captured at once, and each file is written in chunks of
+ * appconfFILEIO_TAP_CHUNK_FRAMES frames, from a buffer allocated from the
+ * heap. */
+#define appconfPIPELINE_TAPS ""
+#define appconfFILEIO_MAX_TAPS 3
+#define appconfFILEIO_TAP_CHUNK_FRAMES 4
+#define appconfFILEIO_TAP_QUEUE_DEPTH 4
+
+/* Set to 1 to time frame allocation from the heap and from a frame pool at
+ * startup */
+#define appconfFRAME_POOL_BENCHMARK 0
 
 /* Task Priorities */
 #define appconfSTARTUP_TASK_PRIORITY              (configMAX_PRIORITIES - 2)
@@ -6,26 +6,60 @@
 
 #include <stdint.h>
 #include "app_conf.h"
+#include "frame_pool.h"
+#include "stage_stats.h"
+#include "pipeline_tap.h"
 
 #define DATA_PIPELINE_DONT_FREE_FRAME 0
 #define DATA_PIPELINE_FREE_FRAME      1
 
+/* Set on the frame that follows the last frame of the stream. It carries no
+ * data, and passes through every stage, in order, to the pipeline output.
+ * Another stream may follow, so a stage that keeps state from frame to frame
+ * resets it when it sees this frame. */
+#define DATA_PIPELINE_FRAME_EOS       0x1
+
+/* Q31 samples, appconfFRAME_ADVANCE for each channel in turn. Channels
+ * beyond those in the input file are zero. */
 typedef struct {
-    int32_t data[appconfFRAME_ADVANCE];
+    int32_t data[appconfMAX_CHANNELS][appconfFRAME_ADVANCE];
+    uint32_t flags;
+    stage_stats_frame_t stats;
 } frame_data_t;
 
+/* The pool the pipeline frames on this tile are allocated from */
+const frame_pool_t *data_pipeline_frame_pool(void);
+
+/* Prints the stage timing histograms of the pipeline on this tile once its
+ * output next outputs a frame, rather than waiting for the end of the
+ * stream. See stage_stats_request_dump(). */
+void data_pipeline_stats_dump(void);
+
 void data_pipeline_init(
         void *input_app_data,
         void *output_app_data);
 
-void data_pipeline_input(
+/* Returns the number of bytes received, or 0 at the end of the stream */
+size_t data_pipeline_input(
         void *input_app_data,
         int8_t **input_data_frame,
         size_t frame_count);
 
+/* Called once the pipeline has finished with a frame from
+ * data_pipeline_input() */
+void data_pipeline_input_done(
+        void *input_app_data);
+
+/* Called with frame_count 0 once every frame before the end of the stream
+ * has been output */
 int data_pipeline_output(
         void *output_app_data,
         int8_t **output_data_frame,
         size_t frame_count);
 
+#if appconfFRAME_POOL_BENCHMARK
+/* Prints the per frame cost of heap allocation and of a frame pool */
+void data_pipeline_frame_pool_benchmark(void);
+#endif
+
 #endif /* DATA_PIPELINE_H_ */
@@ -0,0 +1,73 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef FRAME_STREAM_H_
+#define FRAME_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "rtos_intertile.h"
+
+/*
+ * A one way stream of frames from a task on one tile to a task on the other,
+ * for pipelines that are split across tiles.
+ *
+ * The receiver has a fixed number of frame buffers, such as a frame_pool,
+ * and the sender holds one credit for each buffer that is free. A frame is
+ * only sent when the sender has a credit, so the receiver always has a
+ * buffer ready and receives each frame directly into it. The receiver
+ * returns credits as it finishes with frames, in batches to keep the number
+ * of intertile messages down.
+ *
+ * Frames are sent on data_port and credits are returned on credit_port. The
+ * credits are received by a task on the sending tile, which is always
+ * waiting for them, so a credit message never holds up the frames that the
+ * receiving tile sends in the other direction.
+ */
+typedef struct {
+    rtos_intertile_t *ctx;
+    uint8_t data_port;
+    uint8_t credit_port;
+
+    /* Sender */
+    SemaphoreHandle_t credits;
+
+    /* Receiver */
+    unsigned credit_batch;
+    unsigned credits_owed;
+} frame_stream_t;
+
+/* Initialises the sending end of a stream, and creates the task that receives
+ * its credits. initial_credits is the number of frames the receiver can hold
+ * when it starts. */
+void frame_stream_tx_init(frame_stream_t *stream,
+                          rtos_intertile_t *ctx,
+                          uint8_t data_port,
+                          uint8_t credit_port,
+                          unsigned initial_credits,
+                          unsigned priority);
+
+/* Initialises the receiving end of a stream. Credits are returned once
+ * credit_batch frames have been released. */
+void frame_stream_rx_init(frame_stream_t *stream,
+                          rtos_intertile_t *ctx,
+                          uint8_t data_port,
+                          uint8_t credit_port,
+                          unsigned credit_batch);
+
+/* Waits for a credit and then sends len bytes of frame */
+void frame_stream_send(frame_stream_t *stream, const void *frame, size_t len);
+
+/* Waits for the next frame and receives it into frame, which must have room
+ * for max_len bytes. Returns the length of the frame, which is 0 if the
+ * sender sent an empty frame, for example to mark the end of a stream. */
+size_t frame_stream_receive(frame_stream_t *stream, void *frame, size_t max_len);
+
+/* Tells the sender that a received frame's buffer is free again */
+void frame_stream_release(frame_stream_t *stream);
+
+#endif /* FRAME_STREAM_H_ */
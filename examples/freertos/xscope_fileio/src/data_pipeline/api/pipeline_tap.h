@@ -0,0 +1,70 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef PIPELINE_TAP_H_
+#define PIPELINE_TAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_conf.h"
+
+/*
+ * Named points between the stages of a pipeline at which the frames can be
+ * captured. Each tap is registered by name when its pipeline is initialised,
+ * and is disabled unless named in appconfPIPELINE_TAPS or enabled with
+ * pipeline_tap_enable(). While a tap is enabled, a copy of every frame that
+ * passes it is given to data_pipeline_tap_output(). A disabled tap costs a
+ * single test of its enabled flag.
+ */
+
+#define PIPELINE_TAP_NAME_MAX 32
+
+/* A frame captured by a tap. A frame with an empty name, and no data, marks
+ * the end of a stream through the taps of one tile. */
+typedef struct {
+    char name[PIPELINE_TAP_NAME_MAX];
+    int32_t data[appconfMAX_CHANNELS][appconfFRAME_ADVANCE];
+} pipeline_tap_frame_t;
+
+#define PIPELINE_TAP_END_BYTES offsetof(pipeline_tap_frame_t, data)
+
+typedef struct pipeline_tap {
+    volatile int enabled;
+    struct pipeline_tap *next;
+
+    /* Only used by the task of the stage the tap follows */
+    pipeline_tap_frame_t frame;
+} pipeline_tap_t;
+
+/* Registers a tap on this tile */
+void pipeline_tap_register(pipeline_tap_t *tap, const char *name);
+
+/* Enables or disables the tap on this tile with the given name. Returns 0 if
+ * there is no such tap. */
+int pipeline_tap_enable(const char *name, int enable);
+
+/* Passes a copy of the frame data to data_pipeline_tap_output() */
+void pipeline_tap_send(pipeline_tap_t *tap, const void *data);
+
+/* Passes the end of stream marker to data_pipeline_tap_output(). Called by
+ * the pipeline output once every frame before the end of the stream has
+ * passed every tap. */
+void pipeline_tap_end_of_stream(void);
+
+/* Provided by the application. Called from the stage task with each captured
+ * frame, which is frame_bytes long, and may block. */
+void data_pipeline_tap_output(const pipeline_tap_frame_t *frame, size_t frame_bytes);
+
+/* Defines stage##_tapped(), which calls stage and then passes the frame to
+ * tap if it is enabled. frame_type must have data and flags members. */
+#define PIPELINE_TAP_STAGE(tap, stage, frame_type)                          \
+    static void stage##_tapped(frame_type *frame)                           \
+    {                                                                       \
+        stage(frame);                                                       \
+        if ((tap).enabled && !(frame->flags & DATA_PIPELINE_FRAME_EOS)) {   \
+            pipeline_tap_send(&(tap), frame->data);                         \
+        }                                                                   \
+    }
+
+#endif /* PIPELINE_TAP_H_ */
@@ -0,0 +1,104 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef STAGE_STATS_H_
+#define STAGE_STATS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Timing statistics for the stages of a generic_pipeline, kept in fixed
+ * bucket histograms so that nothing is printed per frame.
+ *
+ * For each stage, the time spent executing the stage and the time each frame
+ * waited in the queue ahead of it are recorded. For the pipeline, the
+ * latency from the input to the output is recorded. Times are in reference
+ * clock ticks, and bucket n holds times from 2^(n-1) up to 2^n - 1 ticks.
+ *
+ * Each frame carries a stage_stats_frame_t, named stats, which is stamped by
+ * stage_stats_frame_input() in the pipeline input. Each stage is wrapped with
+ * STAGE_STATS_STAGE(), and the pipeline output calls
+ * stage_stats_frame_output(). Every histogram is only written by one task,
+ * so no locking is needed.
+ */
+
+#define STAGE_STATS_MAX_STAGES  8
+#define STAGE_STATS_BUCKETS     32
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t buckets[STAGE_STATS_BUCKETS];
+} stage_histogram_t;
+
+typedef struct {
+    const char *name;
+    stage_histogram_t exec;
+    stage_histogram_t wait;
+} stage_stats_stage_t;
+
+typedef struct {
+    const char *name;
+    int stage_count;
+    stage_stats_stage_t stages[STAGE_STATS_MAX_STAGES];
+    stage_histogram_t latency;
+    volatile bool dump_requested;
+} stage_stats_t;
+
+typedef struct {
+    uint32_t input_time;
+    uint32_t ready_time;    /* When the frame was queued for the next stage */
+    uint32_t record;        /* Whether to record this frame's times */
+} stage_stats_frame_t;
+
+void stage_stats_init(stage_stats_t *stats,
+                      const char *name,
+                      const char * const *stage_names,
+                      int stage_count);
+
+/* Called by the pipeline input once the frame is ready. Frames that are not
+ * recorded, such as an end of stream token, still pass through the stages. */
+void stage_stats_frame_input(stage_stats_frame_t *frame, bool record);
+
+uint32_t stage_stats_stage_begin(stage_stats_t *stats,
+                                 int index,
+                                 stage_stats_frame_t *frame);
+
+void stage_stats_stage_end(stage_stats_t *stats,
+                           int index,
+                           stage_stats_frame_t *frame,
+                           uint32_t start);
+
+/* Called by the pipeline output */
+void stage_stats_frame_output(stage_stats_t *stats, stage_stats_frame_t *frame);
+
+/* Prints the histograms, which go to the host over xscope */
+void stage_stats_dump(const stage_stats_t *stats);
+
+/* Requests that the histograms collected so far are printed by the pipeline
+ * output when it next outputs a frame, without clearing them. May be called
+ * from any task or ISR on the same tile. The stages keep running while the
+ * histograms are printed, so a dump may be a few frames out of step between
+ * its histograms. */
+void stage_stats_request_dump(stage_stats_t *stats);
+
+/* Clears the histograms, keeping the names */
+void stage_stats_reset(stage_stats_t *stats);
+
+/* Defines stage##_timed(), which calls stage and records its times as stage
+ * index of pipeline_stats. frame_type must have a stage_stats_frame_t member
+ * named stats. */
+#define STAGE_STATS_STAGE(pipeline_stats, index, stage, frame_type)         \
+    static void stage##_timed(frame_type *frame)                            \
+    {                                                                       \
+        uint32_t start = stage_stats_stage_begin(&(pipeline_stats), (index),\
+                                                 &frame->stats);            \
+        stage(frame);                                                       \
+        stage_stats_stage_end(&(pipeline_stats), (index), &frame->stats,    \
+                              start);                                       \
+    }
+
+#endif /* STAGE_STATS_H_ */
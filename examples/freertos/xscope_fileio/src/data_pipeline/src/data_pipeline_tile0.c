@@ -17,28 +17,51 @@
 /* App headers */
 #include "app_conf.h"
 #include "data_pipeline.h"
+#include "frame_stream.h"
 
 #if ON_TILE(0)
 
+static frame_pool_t frame_pool;
+static frame_data_t frame_pool_frames[appconfDATA_PIPELINE_POOL_FRAMES];
+static void *frame_pool_ring[appconfDATA_PIPELINE_POOL_FRAMES];
+
+/* From the pipeline stages on tile 1 */
+static frame_stream_t tile1_stream;
+
+static stage_stats_t pipeline_stats;
+
+static pipeline_tap_t stage_taps[1];
+
+const frame_pool_t *data_pipeline_frame_pool(void)
+{
+    return &frame_pool;
+}
+
+void data_pipeline_stats_dump(void)
+{
+    stage_stats_request_dump(&pipeline_stats);
+}
+
 static void *data_pipeline_input_i(void *input_app_data)
 {
     frame_data_t *frame_data;
 
-    frame_data = pvPortMalloc(sizeof(frame_data_t));
-    memset(frame_data, 0x00, sizeof(frame_data_t));
+    /* The whole frame is overwritten by the received data, so it is not
+     * zeroed. Tile 1 only sends a frame when it has a credit for one, so
+     * this only waits if frames are being leaked. */
+    while ((frame_data = frame_pool_get(&frame_pool)) == NULL) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
 
     size_t bytes_received = 0;
-    bytes_received = rtos_intertile_rx_len(
-            intertile_ctx,
-            appconfEXAMPLE_DATA_PORT,
-            portMAX_DELAY);
+    bytes_received = frame_stream_receive(&tile1_stream,
+                                          frame_data,
+                                          sizeof(frame_data_t));
 
     xassert(bytes_received == sizeof(frame_data_t));
 
-    rtos_intertile_rx_data(
-            intertile_ctx,
-            frame_data,
-            bytes_received);
+    stage_stats_frame_input(&frame_data->stats,
+                            !(frame_data->flags & DATA_PIPELINE_FRAME_EOS));
 
     return frame_data;
 }
@@ -46,9 +69,21 @@ static void *data_pipeline_input_i(void *input_app_data)
 static int data_pipeline_output_i(frame_data_t *frame_data,
                                    void *output_app_data)
 {
-    return data_pipeline_output(output_app_data,
+    stage_stats_frame_output(&pipeline_stats, &frame_data->stats);
+    if (frame_data->flags & DATA_PIPELINE_FRAME_EOS) {
+        stage_stats_dump(&pipeline_stats);
+        stage_stats_reset(&pipeline_stats);
+        pipeline_tap_end_of_stream();
+    }
+
+    /* data_pipeline_output() copies the frame, so it may be reused whatever
+     * it returns */
+    (void) data_pipeline_output(output_app_data,
                                (int8_t **)frame_data->data,
-                               appconfDATA_FRAME_SIZE_BYTES);
+                               (frame_data->flags & DATA_PIPELINE_FRAME_EOS) ? 0 : appconfDATA_FRAME_SIZE_BYTES);
+    frame_pool_put(&frame_pool, frame_data);
+    frame_stream_release(&tile1_stream);
+    return DATA_PIPELINE_DONT_FREE_FRAME;
 }
 
 static void stage_3(frame_data_t *frame_data)
@@ -56,6 +91,9 @@ static void stage_3(frame_data_t *frame_data)
     /* Do nothing */
 }
 
+PIPELINE_TAP_STAGE(stage_taps[0], stage_3, frame_data_t)
+STAGE_STATS_STAGE(pipeline_stats, 0, stage_3_tapped, frame_data_t)
+
 void data_pipeline_init(
     void *input_app_data,
     void *output_app_data)
@@ -63,13 +101,34 @@ void data_pipeline_init(
     const int stage_count = 1;
 
     const pipeline_stage_t stages[] = {
-        (pipeline_stage_t) stage_3,
+        (pipeline_stage_t) stage_3_tapped_timed,
+    };
+
+    const char * const stage_names[] = {
+        "stage_3",
     };
 
     const configSTACK_DEPTH_TYPE stage_stack_sizes[] = {
-        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_3) + RTOS_THREAD_STACK_SIZE(data_pipeline_input_i) + RTOS_THREAD_STACK_SIZE(data_pipeline_output_i),
+        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_3_tapped_timed) + RTOS_THREAD_STACK_SIZE(data_pipeline_input_i) + RTOS_THREAD_STACK_SIZE(data_pipeline_output_i),
     };
 
+    stage_stats_init(&pipeline_stats, "Tile[0]", stage_names, stage_count);
+    for (int i = 0; i < stage_count; i++) {
+        pipeline_tap_register(&stage_taps[i], stage_names[i]);
+    }
+
+    frame_stream_rx_init(&tile1_stream,
+                         intertile_ctx,
+                         appconfEXAMPLE_DATA_PORT,
+                         appconfEXAMPLE_CREDIT_PORT,
+                         appconfINTERTILE_CREDIT_BATCH);
+
+    frame_pool_init(&frame_pool,
+                    frame_pool_frames,
+                    sizeof(frame_data_t),
+                    appconfDATA_PIPELINE_POOL_FRAMES,
+                    frame_pool_ring);
+
     generic_pipeline_init((pipeline_input_t)data_pipeline_input_i,
                         (pipeline_output_t)data_pipeline_output_i,
                         input_app_data,
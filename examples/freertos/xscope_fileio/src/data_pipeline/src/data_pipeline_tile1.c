@@ -17,19 +17,52 @@
 /* App headers */
 #include "app_conf.h"
 #include "data_pipeline.h"
+#include "frame_stream.h"
 
 #if ON_TILE(1)
 
+static frame_pool_t frame_pool;
+static frame_data_t frame_pool_frames[appconfDATA_PIPELINE_POOL_FRAMES];
+static void *frame_pool_ring[appconfDATA_PIPELINE_POOL_FRAMES];
+
+/* To the pipeline stage on tile 0 */
+static frame_stream_t tile0_stream;
+static void *pipeline_input_app_data;
+
+static stage_stats_t pipeline_stats;
+
+static pipeline_tap_t stage_taps[2];
+
+const frame_pool_t *data_pipeline_frame_pool(void)
+{
+    return &frame_pool;
+}
+
+void data_pipeline_stats_dump(void)
+{
+    stage_stats_request_dump(&pipeline_stats);
+}
+
 static void *data_pipeline_input_i(void *input_app_data)
 {
     frame_data_t *frame_data;
 
-    frame_data = pvPortMalloc(sizeof(frame_data_t));
-    memset(frame_data, 0x00, sizeof(frame_data_t));
+    /* The whole frame is overwritten by the received data, so it is not
+     * zeroed. Tile 0 only sends a frame when it has a credit for one, so
+     * this only waits if frames are being leaked. */
+    while ((frame_data = frame_pool_get(&frame_pool)) == NULL) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
 
-    data_pipeline_input(input_app_data,
-                       (int8_t **)frame_data->data,
-                       appconfDATA_FRAME_SIZE_BYTES);
+    if (data_pipeline_input(input_app_data,
+                            (int8_t **)frame_data->data,
+                            appconfDATA_FRAME_SIZE_BYTES) == 0) {
+        frame_data->flags = DATA_PIPELINE_FRAME_EOS;
+    } else {
+        frame_data->flags = 0;
+    }
+    stage_stats_frame_input(&frame_data->stats,
+                            !(frame_data->flags & DATA_PIPELINE_FRAME_EOS));
 
     return frame_data;
 }
@@ -37,54 +70,68 @@ static void *data_pipeline_input_i(void *input_app_data)
 static int data_pipeline_output_i(frame_data_t *frame_data,
                                    void *output_app_data)
 {
-    rtos_intertile_tx(intertile_ctx,
-                      appconfEXAMPLE_DATA_PORT,
-                      frame_data,
-                      sizeof(frame_data_t));
-    return DATA_PIPELINE_FREE_FRAME;
+    stage_stats_frame_output(&pipeline_stats, &frame_data->stats);
+    if (frame_data->flags & DATA_PIPELINE_FRAME_EOS) {
+        stage_stats_dump(&pipeline_stats);
+        stage_stats_reset(&pipeline_stats);
+        pipeline_tap_end_of_stream();
+    }
+
+    frame_stream_send(&tile0_stream, frame_data, sizeof(frame_data_t));
+    frame_pool_put(&frame_pool, frame_data);
+    data_pipeline_input_done(pipeline_input_app_data);
+    return DATA_PIPELINE_DONT_FREE_FRAME;
 }
 
 static void stage_preemption_disabled(frame_data_t *frame_data)
 {
-    uint32_t time_start, time_end;
+    if (frame_data->flags & DATA_PIPELINE_FRAME_EOS) {
+        return;
+    }
 
     // Disable preemption around the performance critical code section that follows
     uint32_t mask = rtos_interrupt_mask_all();
     {
-        time_start = get_reference_time();
         /* Apply a fixed gain to all samples */
-        for (int i=0; i<appconfFRAME_ADVANCE; i++) {
-            frame_data->data[i] *= 2;
+        for (int ch=0; ch<appconfMAX_CHANNELS; ch++) {
+            for (int i=0; i<appconfFRAME_ADVANCE; i++) {
+                frame_data->data[ch][i] *= 2;
+            }
         }
-        time_end = get_reference_time();
     }
     rtos_interrupt_mask_set(mask); // Enable preemption
-    
-    rtos_printf("stage_preemption_disabled: %d (microseconds) \n", (time_end - time_start) / 100);
 }
 
 static void stage_preemption_enabled(frame_data_t *frame_data)
 {
-    uint32_t time_start, time_end;
+    if (frame_data->flags & DATA_PIPELINE_FRAME_EOS) {
+        return;
+    }
     
     // Preemption is not disabled around the code section that follows
     //   Instead, the code periodically yields to the RTOS kernel to 
     //   emulate a task context switch.
 
-    time_start = get_reference_time();
     /* Apply a fixed gain to all samples */
-    for (int i=0; i<appconfFRAME_ADVANCE; i++) {
-        frame_data->data[i] *= 2;
-        if (i % 100 == 0) {
-            // Yield to the RTOS kernel here
-            taskYIELD();
+    for (int ch=0; ch<appconfMAX_CHANNELS; ch++) {
+        for (int i=0; i<appconfFRAME_ADVANCE; i++) {
+            frame_data->data[ch][i] *= 2;
+            if (i % 100 == 0) {
+                // Yield to the RTOS kernel here
+                taskYIELD();
+            }
         }
     }
-    time_end = get_reference_time();
-
-    rtos_printf("stage_preemption_enabled: %d (microseconds) \n", (time_end - time_start) / 100);
 }
 
+/* Each stage is followed by a tap, named after the stage, and is timed by a
+ * wrapper, rather than timing and printing from within the stage for every
+ * frame */
+PIPELINE_TAP_STAGE(stage_taps[0], stage_preemption_disabled, frame_data_t)
+PIPELINE_TAP_STAGE(stage_taps[1], stage_preemption_enabled, frame_data_t)
+STAGE_STATS_STAGE(pipeline_stats, 0, stage_preemption_disabled_tapped, frame_data_t)
+STAGE_STATS_STAGE(pipeline_stats, 1, stage_preemption_enabled_tapped, frame_data_t)
+
 void data_pipeline_init(
     void *input_app_data,
     void *output_app_data)
@@ -92,15 +139,40 @@ void data_pipeline_init(
     const int stage_count = 2;
 
     const pipeline_stage_t stages[] = {
-        (pipeline_stage_t)stage_preemption_disabled,
-        (pipeline_stage_t)stage_preemption_enabled,
+        (pipeline_stage_t)stage_preemption_disabled_tapped_timed,
+        (pipeline_stage_t)stage_preemption_enabled_tapped_timed,
+    };
+
+    const char * const stage_names[] = {
+        "stage_preemption_disabled",
+        "stage_preemption_enabled",
     };
 
     const configSTACK_DEPTH_TYPE stage_stack_sizes[] = {
-        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_preemption_disabled) + RTOS_THREAD_STACK_SIZE(data_pipeline_input_i),
-        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_preemption_enabled) + RTOS_THREAD_STACK_SIZE(data_pipeline_output_i),
+        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_preemption_disabled_tapped_timed) + RTOS_THREAD_STACK_SIZE(data_pipeline_input_i),
+        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_preemption_enabled_tapped_timed) + RTOS_THREAD_STACK_SIZE(data_pipeline_output_i),
     };
 
+    stage_stats_init(&pipeline_stats, "Tile[1]", stage_names, stage_count);
+    for (int i = 0; i < stage_count; i++) {
+        pipeline_tap_register(&stage_taps[i], stage_names[i]);
+    }
+
+    pipeline_input_app_data = input_app_data;
+
+    frame_stream_tx_init(&tile0_stream,
+                         intertile_ctx,
+                         appconfEXAMPLE_DATA_PORT,
+                         appconfEXAMPLE_CREDIT_PORT,
+                         appconfINTERTILE_FRAME_CREDITS,
+                         appconfDATA_PIPELINE_TASK_PRIORITY);
+
+    frame_pool_init(&frame_pool,
+                    frame_pool_frames,
+                    sizeof(frame_data_t),
+                    appconfDATA_PIPELINE_POOL_FRAMES,
+                    frame_pool_ring);
+
     generic_pipeline_init((pipeline_input_t)data_pipeline_input_i,
                         (pipeline_output_t)data_pipeline_output_i,
                         input_app_data,
@@ -0,0 +1,99 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/* STD headers */
+#include <string.h>
+#include <stdint.h>
+#include <xcore/hwtimer.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "rtos_printf.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "data_pipeline.h"
+#include "frame_pool.h"
+
+#if appconfFRAME_POOL_BENCHMARK
+
+#define BENCH_ITERATIONS    1000
+#define BENCH_FRAMES        appconfFILEIO_FRAMES_IN_FLIGHT
+
+typedef struct {
+    uint32_t total;
+    uint32_t max;
+} bench_result_t;
+
+static void bench_record(bench_result_t *result, uint32_t ticks)
+{
+    result->total += ticks;
+    if (ticks > result->max) {
+        result->max = ticks;
+    }
+}
+
+static void bench_report(const char *name, const bench_result_t *result)
+{
+    uint32_t frames = BENCH_ITERATIONS * BENCH_FRAMES;
+
+    rtos_printf("%s: %u ticks per frame (max %u)\n",
+                name,
+                result->total / frames,
+                result->max);
+}
+
+/* Times taking BENCH_FRAMES frames, as if they were in flight through the
+ * pipeline, and then releasing them, with the heap path the pipeline used
+ * before and with a frame pool. Each allocation and free is timed on its
+ * own, so the results include any time spent waiting for the heap lock. */
+void data_pipeline_frame_pool_benchmark(void)
+{
+    static frame_data_t pool_frames[appconfDATA_PIPELINE_POOL_FRAMES];
+    static void *pool_ring[appconfDATA_PIPELINE_POOL_FRAMES];
+    frame_pool_t pool;
+    frame_data_t *frames[BENCH_FRAMES];
+    bench_result_t heap = {0};
+    bench_result_t pooled = {0};
+    uint32_t start;
+
+    frame_pool_init(&pool, pool_frames, sizeof(frame_data_t),
+                    appconfDATA_PIPELINE_POOL_FRAMES, pool_ring);
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        for (int f = 0; f < BENCH_FRAMES; f++) {
+            start = get_reference_time();
+            frames[f] = pvPortMalloc(sizeof(frame_data_t));
+            memset(frames[f], 0x00, sizeof(frame_data_t));
+            bench_record(&heap, get_reference_time() - start);
+        }
+        for (int f = 0; f < BENCH_FRAMES; f++) {
+            start = get_reference_time();
+            vPortFree(frames[f]);
+            bench_record(&heap, get_reference_time() - start);
+        }
+    }
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        for (int f = 0; f < BENCH_FRAMES; f++) {
+            start = get_reference_time();
+            frames[f] = frame_pool_get(&pool);
+            bench_record(&pooled, get_reference_time() - start);
+        }
+        for (int f = 0; f < BENCH_FRAMES; f++) {
+            start = get_reference_time();
+            frame_pool_put(&pool, frames[f]);
+            bench_record(&pooled, get_reference_time() - start);
+        }
+    }
+
+    rtos_printf("Frame allocation on tile %d, %d frames in flight:\n",
+                THIS_XCORE_TILE, BENCH_FRAMES);
+    bench_report("\theap (malloc + memset + free)", &heap);
+    bench_report("\tframe pool (get + put)", &pooled);
+}
+
+#endif /* appconfFRAME_POOL_BENCHMARK */
@@ -0,0 +1,92 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <xcore/assert.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "frame_stream.h"
+
+static void frame_stream_credit_rx(frame_stream_t *stream)
+{
+    uint32_t count;
+    size_t len;
+
+    for (;;) {
+        len = rtos_intertile_rx_len(stream->ctx, stream->credit_port, portMAX_DELAY);
+        xassert(len == sizeof(count));
+        rtos_intertile_rx_data(stream->ctx, &count, sizeof(count));
+
+        while (count-- > 0) {
+            xSemaphoreGive(stream->credits);
+        }
+    }
+}
+
+void frame_stream_tx_init(frame_stream_t *stream,
+                          rtos_intertile_t *ctx,
+                          uint8_t data_port,
+                          uint8_t credit_port,
+                          unsigned initial_credits,
+                          unsigned priority)
+{
+    stream->ctx = ctx;
+    stream->data_port = data_port;
+    stream->credit_port = credit_port;
+    stream->credits = xSemaphoreCreateCounting(initial_credits, initial_credits);
+    xassert(stream->credits);
+
+    xTaskCreate((TaskFunction_t) frame_stream_credit_rx,
+                "frame_stream_credit_rx",
+                RTOS_THREAD_STACK_SIZE(frame_stream_credit_rx),
+                stream,
+                priority,
+                NULL);
+}
+
+void frame_stream_rx_init(frame_stream_t *stream,
+                          rtos_intertile_t *ctx,
+                          uint8_t data_port,
+                          uint8_t credit_port,
+                          unsigned credit_batch)
+{
+    stream->ctx = ctx;
+    stream->data_port = data_port;
+    stream->credit_port = credit_port;
+    stream->credit_batch = credit_batch;
+    stream->credits_owed = 0;
+}
+
+void frame_stream_send(frame_stream_t *stream, const void *frame, size_t len)
+{
+    xSemaphoreTake(stream->credits, portMAX_DELAY);
+    rtos_intertile_tx(stream->ctx, stream->data_port, (void *) frame, len);
+}
+
+size_t frame_stream_receive(frame_stream_t *stream, void *frame, size_t max_len)
+{
+    size_t len;
+
+    len = rtos_intertile_rx_len(stream->ctx, stream->data_port, portMAX_DELAY);
+    xassert(len <= max_len);
+    if (len > 0) {
+        rtos_intertile_rx_data(stream->ctx, frame, len);
+    }
+
+    return len;
+}
+
+void frame_stream_release(frame_stream_t *stream)
+{
+    uint32_t count;
+
+    if (++stream->credits_owed < stream->credit_batch) {
+        return;
+    }
+
+    count = stream->credits_owed;
+    stream->credits_owed = 0;
+    rtos_intertile_tx(stream->ctx, stream->credit_port, &count, sizeof(count));
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <string.h>
+#include <xcore/assert.h>
+
+#include "FreeRTOS.h"
+
+#include "rtos_printf.h"
+
+#include "pipeline_tap.h"
+
+/* Taps are only registered while the pipelines are initialised, before any
+ * frames pass them */
+static pipeline_tap_t *taps;
+
+static pipeline_tap_frame_t end_of_stream;
+
+/* Returns non-zero if name is one of the space separated names in list */
+static int name_in_list(const char *name, const char *list)
+{
+    size_t len = strlen(name);
+
+    while (*list != '\0') {
+        size_t n = strcspn(list, " ");
+
+        if (n == len && strncmp(list, name, len) == 0) {
+            return 1;
+        }
+        list += n;
+        list += strspn(list, " ");
+    }
+
+    return 0;
+}
+
+void pipeline_tap_register(pipeline_tap_t *tap, const char *name)
+{
+    xassert(strlen(name) < PIPELINE_TAP_NAME_MAX);
+
+    strcpy(tap->frame.name, name);
+    tap->enabled = name_in_list(name, appconfPIPELINE_TAPS);
+    tap->next = taps;
+    taps = tap;
+
+    if (tap->enabled) {
+        rtos_printf("Tap %s enabled\n", name);
+    }
+}
+
+int pipeline_tap_enable(const char *name, int enable)
+{
+    for (pipeline_tap_t *tap = taps; tap != NULL; tap = tap->next) {
+        if (strcmp(tap->frame.name, name) == 0) {
+            tap->enabled = enable;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void pipeline_tap_send(pipeline_tap_t *tap, const void *data)
+{
+    memcpy(tap->frame.data, data, sizeof(tap->frame.data));
+    data_pipeline_tap_output(&tap->frame, sizeof(tap->frame));
+}
+
+void pipeline_tap_end_of_stream(void)
+{
+    data_pipeline_tap_output(&end_of_stream, PIPELINE_TAP_END_BYTES);
+}
@@ -0,0 +1,141 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <string.h>
+#include <xcore/assert.h>
+#include <xcore/hwtimer.h>
+
+#include "FreeRTOS.h"
+
+#include "rtos_printf.h"
+
+#include "stage_stats.h"
+
+static void histogram_add(stage_histogram_t *hist, uint32_t ticks)
+{
+    int bucket = (ticks == 0) ? 0 : 32 - __builtin_clz(ticks);
+
+    if (bucket >= STAGE_STATS_BUCKETS) {
+        bucket = STAGE_STATS_BUCKETS - 1;
+    }
+
+    if (hist->count == 0 || ticks < hist->min) {
+        hist->min = ticks;
+    }
+    if (ticks > hist->max) {
+        hist->max = ticks;
+    }
+    hist->total += ticks;
+    hist->count++;
+    hist->buckets[bucket]++;
+}
+
+static void histogram_dump(const char *pipeline,
+                           const char *name,
+                           const char *what,
+                           const stage_histogram_t *hist)
+{
+    if (hist->count == 0) {
+        rtos_printf("%s %s %s: no frames\n", pipeline, name, what);
+        return;
+    }
+
+    /* Times are in 10 ns reference clock ticks */
+    rtos_printf("%s %s %s: %u frames, min %u, mean %u, max %u ticks\n",
+                pipeline, name, what,
+                hist->count,
+                hist->min,
+                (uint32_t) (hist->total / hist->count),
+                hist->max);
+
+    for (int i = 0; i < STAGE_STATS_BUCKETS; i++) {
+        if (hist->buckets[i] > 0) {
+            rtos_printf("\t< %u: %u\n",
+                        i == STAGE_STATS_BUCKETS - 1 ? 0xffffffffu : 1u << i,
+                        hist->buckets[i]);
+        }
+    }
+}
+
+void stage_stats_init(stage_stats_t *stats,
+                      const char *name,
+                      const char * const *stage_names,
+                      int stage_count)
+{
+    xassert(stage_count <= STAGE_STATS_MAX_STAGES);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->name = name;
+    stats->stage_count = stage_count;
+    for (int i = 0; i < stage_count; i++) {
+        stats->stages[i].name = stage_names[i];
+    }
+}
+
+void stage_stats_frame_input(stage_stats_frame_t *frame, bool record)
+{
+    frame->input_time = get_reference_time();
+    frame->ready_time = frame->input_time;
+    frame->record = record;
+}
+
+uint32_t stage_stats_stage_begin(stage_stats_t *stats,
+                                 int index,
+                                 stage_stats_frame_t *frame)
+{
+    uint32_t now = get_reference_time();
+
+    if (frame->record) {
+        histogram_add(&stats->stages[index].wait, now - frame->ready_time);
+    }
+    return now;
+}
+
+void stage_stats_stage_end(stage_stats_t *stats,
+                           int index,
+                           stage_stats_frame_t *frame,
+                           uint32_t start)
+{
+    uint32_t now = get_reference_time();
+
+    if (frame->record) {
+        histogram_add(&stats->stages[index].exec, now - start);
+    }
+    frame->ready_time = now;
+}
+
+void stage_stats_frame_output(stage_stats_t *stats, stage_stats_frame_t *frame)
+{
+    if (frame->record) {
+        histogram_add(&stats->latency, get_reference_time() - frame->input_time);
+    }
+    if (stats->dump_requested) {
+        stats->dump_requested = false;
+        stage_stats_dump(stats);
+    }
+}
+
+void stage_stats_dump(const stage_stats_t *stats)
+{
+    for (int i = 0; i < stats->stage_count; i++) {
+        histogram_dump(stats->name, stats->stages[i].name, "exec",
+                       &stats->stages[i].exec);
+        histogram_dump(stats->name, stats->stages[i].name, "queue wait",
+                       &stats->stages[i].wait);
+    }
+    histogram_dump(stats->name, "pipeline", "latency", &stats->latency);
+}
+
+void stage_stats_request_dump(stage_stats_t *stats)
+{
+    stats->dump_requested = true;
+}
+
+void stage_stats_reset(stage_stats_t *stats)
+{
+    for (int i = 0; i < stats->stage_count; i++) {
+        memset(&stats->stages[i].exec, 0, sizeof(stats->stages[i].exec));
+        memset(&stats->stages[i].wait, 0, sizeof(stats->stages[i].wait));
+    }
+    memset(&stats->latency, 0, sizeof(stats->latency));
+}
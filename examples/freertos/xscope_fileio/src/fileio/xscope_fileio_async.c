@@ -0,0 +1,188 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <platform.h>
+#include <xcore/hwtimer.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "rtos_printf.h"
+
+#include "app_conf.h"
+#include "fileio/xscope_fileio_async.h"
+
+static QueueHandle_t req_queue;
+
+static void service_request(xscope_fileio_req_t *req)
+{
+    switch (req->op) {
+    case XSCOPE_FILEIO_OPEN:
+        *req->file = xscope_open_file((char *) req->filename, (char *) req->mode);
+        break;
+    case XSCOPE_FILEIO_SEEK:
+        xscope_fseek(req->file, req->offset, req->whence);
+        break;
+    case XSCOPE_FILEIO_TELL:
+        req->result = xscope_ftell(req->file);
+        break;
+    case XSCOPE_FILEIO_READ:
+        req->result = xscope_fread(req->file, req->buf, req->len);
+        break;
+    case XSCOPE_FILEIO_WRITE:
+        xscope_fwrite(req->file, req->buf, req->len);
+        req->result = req->len;
+        break;
+    case XSCOPE_FILEIO_CLOSE_ALL:
+        xscope_close_all_files();
+        break;
+    }
+}
+
+/* This task makes every xscope fileio call on the tile, one request at a
+ * time, in the order they were submitted.
+ */
+/* NOTE:
+ * xscope fileio waits on channel events, which must not be disturbed by an
+ * interrupt or a context switch on this core. Interrupts are masked on this
+ * core only while the host services a request, so the other cores on the
+ * tile continue to schedule tasks. */
+static void xscope_fileio_async_task(void *arg)
+{
+    (void) arg;
+    xscope_fileio_req_t *req;
+    TaskHandle_t task;
+    uint32_t start;
+    uint32_t mask;
+
+    for (;;) {
+        xQueueReceive(req_queue, &req, portMAX_DELAY);
+
+        start = get_reference_time();
+        mask = rtos_interrupt_mask_all();
+        {
+            service_request(req);
+        }
+        rtos_interrupt_mask_set(mask);
+        req->ticks = get_reference_time() - start;
+
+        /* The requester may return as soon as it sees done, and the request
+         * may be on its stack, so req is not touched after done is set */
+        task = req->task;
+        req->done = 1;
+        xTaskNotifyGiveIndexed(task, XSCOPE_FILEIO_ASYNC_NOTIFY_INDEX);
+    }
+}
+
+void xscope_fileio_async_task_create(unsigned priority)
+{
+    TaskHandle_t task_handle;
+
+    req_queue = xQueueCreate(appconfFILEIO_ASYNC_QUEUE_DEPTH, sizeof(xscope_fileio_req_t *));
+    xassert(req_queue);
+
+    xTaskCreate((TaskFunction_t)xscope_fileio_async_task,
+                "xscope_fileio_async",
+                RTOS_THREAD_STACK_SIZE(xscope_fileio_async_task),
+                NULL,
+                priority,
+                &task_handle);
+
+    /* Keep the xscope fileio calls on the core that always made them */
+    vTaskCoreAffinitySet(task_handle, appconfFILEIO_ASYNC_CORE_MASK);
+}
+
+void xscope_fileio_async_submit(xscope_fileio_req_t *req)
+{
+    req->task = xTaskGetCurrentTaskHandle();
+    req->done = 0;
+    req->ticks = 0;
+    xQueueSend(req_queue, &req, portMAX_DELAY);
+}
+
+void xscope_fileio_async_wait(xscope_fileio_req_t *req)
+{
+    /* Completions of the task's other requests share the notification, so a
+     * wake up does not necessarily mean that this request has completed */
+    while (!req->done) {
+        (void) ulTaskNotifyTakeIndexed(XSCOPE_FILEIO_ASYNC_NOTIFY_INDEX, pdFALSE, portMAX_DELAY);
+    }
+}
+
+static void submit_and_wait(xscope_fileio_req_t *req)
+{
+    xscope_fileio_async_submit(req);
+    xscope_fileio_async_wait(req);
+}
+
+xscope_file_t xscope_fileio_open(const char *filename, const char *mode)
+{
+    xscope_file_t file;
+    xscope_fileio_req_t req = {
+        .op = XSCOPE_FILEIO_OPEN,
+        .file = &file,
+        .filename = filename,
+        .mode = mode,
+    };
+
+    submit_and_wait(&req);
+    return file;
+}
+
+void xscope_fileio_seek(xscope_file_t *file, long offset, int whence)
+{
+    xscope_fileio_req_t req = {
+        .op = XSCOPE_FILEIO_SEEK,
+        .file = file,
+        .offset = offset,
+        .whence = whence,
+    };
+
+    submit_and_wait(&req);
+}
+
+long xscope_fileio_tell(xscope_file_t *file)
+{
+    xscope_fileio_req_t req = {
+        .op = XSCOPE_FILEIO_TELL,
+        .file = file,
+    };
+
+    submit_and_wait(&req);
+    return (long) req.result;
+}
+
+size_t xscope_fileio_read(xscope_file_t *file, uint8_t *buf, size_t len)
+{
+    xscope_fileio_req_t req = {
+        .op = XSCOPE_FILEIO_READ,
+        .file = file,
+        .buf = buf,
+        .len = len,
+    };
+
+    submit_and_wait(&req);
+    return req.result;
+}
+
+void xscope_fileio_write(xscope_file_t *file, const uint8_t *buf, size_t len)
+{
+    xscope_fileio_req_t req = {
+        .op = XSCOPE_FILEIO_WRITE,
+        .file = file,
+        .buf = (uint8_t *) buf,
+        .len = len,
+    };
+
+    submit_and_wait(&req);
+}
+
+void xscope_fileio_close_all(void)
+{
+    xscope_fileio_req_t req = {
+        .op = XSCOPE_FILEIO_CLOSE_ALL,
+    };
+
+    submit_and_wait(&req);
+}
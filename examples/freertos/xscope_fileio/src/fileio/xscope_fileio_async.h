@@ -0,0 +1,65 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef XSCOPE_FILEIO_ASYNC_H_
+#define XSCOPE_FILEIO_ASYNC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "xscope_io_device.h"
+
+/* Requests are completed by a notification at this index, leaving index 0
+ * free for the requesting task's own use */
+#define XSCOPE_FILEIO_ASYNC_NOTIFY_INDEX 1
+
+typedef enum {
+    XSCOPE_FILEIO_OPEN,
+    XSCOPE_FILEIO_SEEK,
+    XSCOPE_FILEIO_TELL,
+    XSCOPE_FILEIO_READ,
+    XSCOPE_FILEIO_WRITE,
+    XSCOPE_FILEIO_CLOSE_ALL,
+} xscope_fileio_op_t;
+
+/* A host file request. The request, and any buffer it refers to, must remain
+ * valid until xscope_fileio_async_wait() returns for it. */
+typedef struct {
+    xscope_fileio_op_t op;
+    xscope_file_t *file;
+    const char *filename;   /* OPEN */
+    const char *mode;       /* OPEN */
+    uint8_t *buf;           /* READ and WRITE */
+    size_t len;             /* READ and WRITE */
+    long offset;            /* SEEK */
+    int whence;             /* SEEK */
+
+    size_t result;          /* Bytes read for READ, position for TELL */
+    uint32_t ticks;         /* Time the host took to service the request */
+
+    TaskHandle_t task;
+    volatile int done;
+} xscope_fileio_req_t;
+
+/* Creates the task that makes all xscope fileio calls on this tile */
+void xscope_fileio_async_task_create(unsigned priority);
+
+/* Queues a request and returns without waiting for it to complete */
+void xscope_fileio_async_submit(xscope_fileio_req_t *req);
+
+/* Blocks the calling task until a request it submitted has completed */
+void xscope_fileio_async_wait(xscope_fileio_req_t *req);
+
+/* Blocking forms of the xscope fileio calls, each of which submits a request
+ * and waits for it. They may be called from any task on this tile. */
+xscope_file_t xscope_fileio_open(const char *filename, const char *mode);
+void xscope_fileio_seek(xscope_file_t *file, long offset, int whence);
+long xscope_fileio_tell(xscope_file_t *file);
+size_t xscope_fileio_read(xscope_file_t *file, uint8_t *buf, size_t len);
+void xscope_fileio_write(xscope_file_t *file, const uint8_t *buf, size_t len);
+void xscope_fileio_close_all(void);
+
+#endif /* XSCOPE_FILEIO_ASYNC_H_ */
@@ -0,0 +1,162 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <platform.h>
+#include <string.h>
+#include <xs1.h>
+
+#include "FreeRTOS.h"
+
+#include "rtos_printf.h"
+
+#include "fileio/xscope_fileio_stream.h"
+
+void xscope_fileio_stream_init(xscope_fileio_stream_t *stream,
+                               xscope_file_t *file,
+                               uint8_t *buf,
+                               size_t size)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->file = file;
+    stream->size = size / 2;
+    stream->half[0] = buf;
+    stream->half[1] = buf + stream->size;
+}
+
+static void stream_submit(xscope_fileio_stream_t *stream,
+                          xscope_fileio_op_t op,
+                          unsigned half,
+                          size_t len)
+{
+    stream->req.op = op;
+    stream->req.file = stream->file;
+    stream->req.buf = stream->half[half];
+    stream->req.len = len;
+    xscope_fileio_async_submit(&stream->req);
+    stream->pending = 1;
+}
+
+static void stream_complete(xscope_fileio_stream_t *stream)
+{
+    xscope_fileio_async_wait(&stream->req);
+    stream->pending = 0;
+
+    stream->bytes += stream->req.result;
+    stream->ticks += stream->req.ticks;
+    stream->requests++;
+}
+
+static void stream_fill(xscope_fileio_stream_t *stream)
+{
+    unsigned next = stream->cur ^ 1;
+
+    /* The first fill has no read ahead to wait for */
+    if (!stream->pending) {
+        stream_submit(stream, XSCOPE_FILEIO_READ, next, stream->size);
+    }
+    stream_complete(stream);
+
+    stream->cur = next;
+    stream->len = stream->req.result;
+    stream->pos = 0;
+
+    /* Read the next chunk into the other half while this one is consumed,
+     * unless this one has reached the end of the file */
+    if (stream->len == stream->size) {
+        stream_submit(stream, XSCOPE_FILEIO_READ, next ^ 1, stream->size);
+    }
+}
+
+size_t xscope_fileio_stream_read(xscope_fileio_stream_t *stream,
+                                 uint8_t *dst,
+                                 size_t len)
+{
+    size_t copied = 0;
+
+    while (copied < len) {
+        size_t n;
+
+        if (stream->pos == stream->len) {
+            stream_fill(stream);
+            if (stream->len == 0) {
+                break;
+            }
+        }
+
+        n = stream->len - stream->pos;
+        if (n > len - copied) {
+            n = len - copied;
+        }
+
+        memcpy(dst + copied, stream->half[stream->cur] + stream->pos, n);
+        stream->pos += n;
+        copied += n;
+    }
+
+    return copied;
+}
+
+static void stream_drain(xscope_fileio_stream_t *stream)
+{
+    /* Wait for the other half to be written before it is filled */
+    if (stream->pending) {
+        stream_complete(stream);
+    }
+    stream_submit(stream, XSCOPE_FILEIO_WRITE, stream->cur, stream->len);
+
+    stream->cur ^= 1;
+    stream->len = 0;
+}
+
+void xscope_fileio_stream_flush(xscope_fileio_stream_t *stream)
+{
+    if (stream->len > 0) {
+        stream_drain(stream);
+    }
+    xscope_fileio_stream_close(stream);
+}
+
+void xscope_fileio_stream_close(xscope_fileio_stream_t *stream)
+{
+    if (stream->pending) {
+        stream_complete(stream);
+    }
+}
+
+void xscope_fileio_stream_write(xscope_fileio_stream_t *stream,
+                                const uint8_t *src,
+                                size_t len)
+{
+    while (len > 0) {
+        size_t n = stream->size - stream->len;
+
+        if (n > len) {
+            n = len;
+        }
+
+        memcpy(stream->half[stream->cur] + stream->len, src, n);
+        stream->len += n;
+        src += n;
+        len -= n;
+
+        if (stream->len == stream->size) {
+            stream_drain(stream);
+        }
+    }
+}
+
+void xscope_fileio_stream_report(const xscope_fileio_stream_t *stream,
+                                 const char *name)
+{
+    uint32_t us = (uint32_t)(stream->ticks / XS1_TIMER_MHZ);
+    /* Bytes per microsecond is MB/s; keep two decimal places */
+    uint32_t centi_mbps = (us > 0) ? (uint32_t)((stream->bytes * 100) / us) : 0;
+
+    rtos_printf("%s: %u bytes in %u requests, %u us in host I/O, %u.%02u MB/s\n",
+                name,
+                (uint32_t)stream->bytes,
+                stream->requests,
+                us,
+                centi_mbps / 100,
+                centi_mbps % 100);
+}
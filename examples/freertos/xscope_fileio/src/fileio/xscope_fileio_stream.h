@@ -0,0 +1,62 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef XSCOPE_FILEIO_STREAM_H_
+#define XSCOPE_FILEIO_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xscope_io_device.h"
+#include "fileio/xscope_fileio_async.h"
+
+/* Sequential access to a host file in large chunks, so that many frames are
+ * transferred per host request. The buffer is split in two, and one half is
+ * transferred by the xscope fileio task while the other is being used. Each
+ * stream also measures the time spent in host requests, to report the
+ * achieved transfer rate. */
+typedef struct {
+    xscope_file_t *file;
+    uint8_t *half[2];
+    size_t size;    /* Of each half */
+    unsigned cur;   /* The half being filled or drained */
+    size_t len;     /* Bytes in the current half */
+    size_t pos;     /* Reader: next byte to return from the current half */
+    xscope_fileio_req_t req;
+    int pending;    /* req is outstanding */
+    uint64_t bytes;
+    uint64_t ticks;
+    unsigned requests;
+} xscope_fileio_stream_t;
+
+/* The file must already be positioned at the first byte to read or write.
+ * Each request transfers size/2 bytes. */
+void xscope_fileio_stream_init(xscope_fileio_stream_t *stream,
+                               xscope_file_t *file,
+                               uint8_t *buf,
+                               size_t size);
+
+/* Copies the next len bytes of the file to dst, refilling the chunk buffer as
+ * needed. Returns the number of bytes copied, which is less than len only at
+ * the end of the file. */
+size_t xscope_fileio_stream_read(xscope_fileio_stream_t *stream,
+                                 uint8_t *dst,
+                                 size_t len);
+
+/* Appends len bytes to the chunk buffer, writing it to the file when full */
+void xscope_fileio_stream_write(xscope_fileio_stream_t *stream,
+                                const uint8_t *src,
+                                size_t len);
+
+/* Writes any buffered bytes to the file, then closes the stream */
+void xscope_fileio_stream_flush(xscope_fileio_stream_t *stream);
+
+/* Waits for any outstanding request, such as a read ahead, to complete. The
+ * buffer may be reused once this returns. */
+void xscope_fileio_stream_close(xscope_fileio_stream_t *stream);
+
+/* Prints the bytes transferred and the transfer rate achieved */
+void xscope_fileio_stream_report(const xscope_fileio_stream_t *stream,
+                                 const char *name);
+
+#endif /* XSCOPE_FILEIO_STREAM_H_ */
@@ -0,0 +1,253 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <platform.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include "rtos_printf.h"
+
+#include "app_conf.h"
+#include "platform/driver_instances.h"
+#include "fileio/xscope_fileio_tap.h"
+#include "fileio/xscope_fileio_async.h"
+#include "frame_stream.h"
+#include "wav_utils.h"
+#include "wav_convert.h"
+
+/* The pipelines on tile 0 and on tile 1 each send an end of stream marker */
+#define TAP_SOURCES         2
+
+#define TAP_FILENAME_MAX    128
+#define TAP_CHUNK_BYTES     (appconfFILEIO_TAP_CHUNK_FRAMES * appconfDATA_FRAME_SIZE_BYTES)
+
+/* From the taps on the other tile to the tap writer on this one */
+static frame_stream_t tap_stream;
+
+#if ON_TILE(XSCOPE_HOST_IO_TILE)
+
+/* Why a tap frame could not be written */
+typedef enum {
+    TAP_DROP_TOO_MANY_TAPS,
+    TAP_DROP_NO_MEMORY,
+    TAP_DROP_REASONS
+} tap_drop_t;
+
+static const char * const tap_drop_reasons[TAP_DROP_REASONS] = {
+    [TAP_DROP_TOO_MANY_TAPS] = "more taps enabled than appconfFILEIO_MAX_TAPS",
+    [TAP_DROP_NO_MEMORY] = "out of memory for the tap buffers",
+};
+
+typedef struct {
+    char name[PIPELINE_TAP_NAME_MAX];   /* Empty while unused */
+    xscope_file_t file;
+    wav_writer_t wav;
+    uint8_t *chunk;
+} tap_file_t;
+
+static tap_file_t tap_files[appconfFILEIO_MAX_TAPS];
+static QueueHandle_t tap_queue;
+static SemaphoreHandle_t tap_end;
+
+/* Set by xscope_fileio_tap_begin() for each stream */
+static char tap_prefix[TAP_FILENAME_MAX];
+static unsigned tap_channels;
+static int tap_sample_rate;
+
+static pipeline_tap_frame_t writer_frame;
+static pipeline_tap_frame_t rx_frame;
+static int32_t tap_samples[appconfMAX_CHANNELS * appconfFRAME_ADVANCE];
+
+/* Returns the file for the named tap, opening it if it is not yet open. On
+ * failure, returns NULL and sets *drop to the reason. */
+static tap_file_t *tap_file_get(const char *name, tap_drop_t *drop)
+{
+    char filename[TAP_FILENAME_MAX + PIPELINE_TAP_NAME_MAX + 8];
+    tap_file_t *free_file = NULL;
+
+    for (int i = 0; i < appconfFILEIO_MAX_TAPS; i++) {
+        if (strcmp(tap_files[i].name, name) == 0) {
+            return &tap_files[i];
+        }
+        if (free_file == NULL && tap_files[i].name[0] == '\0') {
+            free_file = &tap_files[i];
+        }
+    }
+
+    if (free_file == NULL) {
+        *drop = TAP_DROP_TOO_MANY_TAPS;
+        return NULL;
+    }
+
+    /* The chunk buffers are only allocated while a tap is being captured */
+    free_file->chunk = pvPortMalloc(2 * TAP_CHUNK_BYTES);
+    if (free_file->chunk == NULL) {
+        *drop = TAP_DROP_NO_MEMORY;
+        return NULL;
+    }
+
+    snprintf(filename, sizeof(filename), "%s_%s.wav", tap_prefix, name);
+    rtos_printf("Capture tap %s to %s\n", name, filename);
+
+    /* xscope_open_file() returns no status to the device, so an open that
+     * fails on the host cannot be detected here */
+    strcpy(free_file->name, name);
+    free_file->file = xscope_fileio_open(filename, "wb");
+    wav_writer_open(&free_file->wav,
+                    &free_file->file,
+                    free_file->chunk,
+                    2 * TAP_CHUNK_BYTES,
+                    1,
+                    tap_channels,
+                    tap_sample_rate,
+                    32);
+
+    return free_file;
+}
+
+static void tap_files_close(void)
+{
+    for (int i = 0; i < appconfFILEIO_MAX_TAPS; i++) {
+        if (tap_files[i].name[0] != '\0') {
+            wav_writer_close(&tap_files[i].wav);
+            vPortFree(tap_files[i].chunk);
+            tap_files[i].name[0] = '\0';
+        }
+    }
+}
+
+/* This task writes every tap frame to its tap's file, in the order they
+ * arrive, and closes the files at the end of each stream */
+static void xscope_fileio_tap_writer(void *arg)
+{
+    (void) arg;
+    unsigned ends = 0;
+    unsigned dropped[TAP_DROP_REASONS] = {0};
+    tap_file_t *tap_file;
+    tap_drop_t drop;
+
+    for (;;) {
+        xQueueReceive(tap_queue, &writer_frame, portMAX_DELAY);
+
+        if (writer_frame.name[0] == '\0') {
+            if (++ends == TAP_SOURCES) {
+                tap_files_close();
+                for (int i = 0; i < TAP_DROP_REASONS; i++) {
+                    if (dropped[i] > 0) {
+                        rtos_printf("Error: %u tap frames dropped, %s\n",
+                                    dropped[i], tap_drop_reasons[i]);
+                    }
+                    dropped[i] = 0;
+                }
+                ends = 0;
+                xSemaphoreGive(tap_end);
+            }
+            continue;
+        }
+
+        tap_file = tap_file_get(writer_frame.name, &drop);
+        if (tap_file == NULL) {
+            dropped[drop]++;
+            continue;
+        }
+
+        wav_convert_from_q31(tap_samples, &writer_frame.data[0][0], appconfFRAME_ADVANCE,
+                             tap_channels, 32, appconfFRAME_ADVANCE);
+        wav_writer_write(&tap_file->wav, (uint8_t *) tap_samples,
+                         appconfFRAME_ADVANCE * tap_channels * sizeof(int32_t));
+    }
+}
+
+/* This task passes the tap frames from the other tile to the tap writer.
+ * The other tile holds a single credit, for rx_frame. */
+static void xscope_fileio_tap_rx(void *arg)
+{
+    (void) arg;
+
+    for (;;) {
+        (void) frame_stream_receive(&tap_stream, &rx_frame, sizeof(rx_frame));
+        xQueueSend(tap_queue, &rx_frame, portMAX_DELAY);
+        frame_stream_release(&tap_stream);
+    }
+}
+
+void xscope_fileio_tap_tasks_create(unsigned priority)
+{
+    tap_queue = xQueueCreate(appconfFILEIO_TAP_QUEUE_DEPTH, sizeof(pipeline_tap_frame_t));
+    xassert(tap_queue);
+    tap_end = xSemaphoreCreateBinary();
+    xassert(tap_end);
+
+    frame_stream_rx_init(&tap_stream,
+                         intertile_ctx,
+                         appconfEXAMPLE_TAP_PORT,
+                         appconfEXAMPLE_TAP_CREDIT_PORT,
+                         1);
+
+    xTaskCreate((TaskFunction_t)xscope_fileio_tap_writer,
+                "xscope_fileio_tap_writer",
+                RTOS_THREAD_STACK_SIZE(xscope_fileio_tap_writer),
+                NULL,
+                priority,
+                NULL);
+
+    xTaskCreate((TaskFunction_t)xscope_fileio_tap_rx,
+                "xscope_fileio_tap_rx",
+                RTOS_THREAD_STACK_SIZE(xscope_fileio_tap_rx),
+                NULL,
+                priority,
+                NULL);
+}
+
+void xscope_fileio_tap_begin(const char *output_filename,
+                             unsigned channels,
+                             int sample_rate)
+{
+    size_t len = strlen(output_filename);
+
+    /* out.wav is captured to out_<tap>.wav */
+    if (len >= 4 && strcmp(&output_filename[len - 4], ".wav") == 0) {
+        len -= 4;
+    }
+    if (len >= sizeof(tap_prefix)) {
+        len = sizeof(tap_prefix) - 1;
+    }
+    memcpy(tap_prefix, output_filename, len);
+    tap_prefix[len] = '\0';
+
+    tap_channels = channels;
+    tap_sample_rate = sample_rate;
+}
+
+void xscope_fileio_tap_wait_end(void)
+{
+    xSemaphoreTake(tap_end, portMAX_DELAY);
+}
+
+#endif /* ON_TILE(XSCOPE_HOST_IO_TILE) */
+
+void xscope_fileio_tap_tx_init(unsigned priority)
+{
+    frame_stream_tx_init(&tap_stream,
+                         intertile_ctx,
+                         appconfEXAMPLE_TAP_PORT,
+                         appconfEXAMPLE_TAP_CREDIT_PORT,
+                         1,
+                         priority);
+}
+
+void xscope_fileio_tap_output(const pipeline_tap_frame_t *frame, size_t frame_bytes)
+{
+#if ON_TILE(XSCOPE_HOST_IO_TILE)
+    /* The queue copies a whole frame, even of the end of stream marker */
+    (void) frame_bytes;
+    xQueueSend(tap_queue, frame, portMAX_DELAY);
+#else
+    frame_stream_send(&tap_stream, frame, frame_bytes);
+#endif
+}
@@ -0,0 +1,42 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef XSCOPE_FILEIO_TAP_H_
+#define XSCOPE_FILEIO_TAP_H_
+
+#include <stddef.h>
+
+#include "pipeline_tap.h"
+
+/*
+ * Captures the frames of the enabled pipeline taps, on both tiles, to a WAV
+ * file per tap on the host. The frames of the taps on the other tile are
+ * sent to this tile with a frame stream. A task on this tile writes every
+ * tap's file through the xscope fileio task, alongside the input and output
+ * files, in chunked writes.
+ *
+ * Once the end of stream marker has arrived from both tiles, every tap file
+ * has been written, and xscope_fileio_tap_wait_end() returns.
+ */
+
+/* Creates the task that writes the tap files, and the task that receives the
+ * taps of the other tile. On the host I/O tile. */
+void xscope_fileio_tap_tasks_create(unsigned priority);
+
+/* Sets up the sending of taps to the host I/O tile, from the other tile */
+void xscope_fileio_tap_tx_init(unsigned priority);
+
+/* Captures a tap frame, or end of stream marker, on either tile */
+void xscope_fileio_tap_output(const pipeline_tap_frame_t *frame, size_t frame_bytes);
+
+/* Sets the file name, without the tap name and extension, and the format of
+ * the tap files for the next stream. Called before the stream starts. */
+void xscope_fileio_tap_begin(const char *output_filename,
+                             unsigned channels,
+                             int sample_rate);
+
+/* Waits until the end of the stream has passed the taps on both tiles, and
+ * every tap file has been written */
+void xscope_fileio_tap_wait_end(void);
+
+#endif /* XSCOPE_FILEIO_TAP_H_ */
@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <xs1.h>
+#include <xcore/hwtimer.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -15,8 +17,13 @@
 #include "app_conf.h"
 #include "platform/driver_instances.h"
 #include "fileio/xscope_fileio_task.h"
+#include "fileio/xscope_fileio_async.h"
+#include "fileio/xscope_fileio_stream.h"
+#include "fileio/xscope_fileio_tap.h"
+#include "frame_stream.h"
 #include "xscope_io_device.h"
 #include "wav_utils.h"
+#include "wav_convert.h"
 
 static TaskHandle_t fileio_task_handle;
 static QueueHandle_t fileio_queue;
@@ -24,6 +31,28 @@ static QueueHandle_t fileio_queue;
 static xscope_file_t infile;
 static xscope_file_t outfile;
 
+static xscope_fileio_stream_t in_stream;
+static wav_writer_t out_wav;
+static uint8_t in_chunk[2 * appconfFILEIO_CHUNK_SIZE_BYTES];
+static uint8_t out_chunk[2 * appconfFILEIO_CHUNK_SIZE_BYTES];
+
+/* A frame of the input or output file, in the file's sample format. A 32 bit
+ * frame of appconfMAX_CHANNELS channels is the largest. Word aligned for
+ * the sample conversion. */
+static int32_t in_samples[appconfMAX_CHANNELS * appconfFRAME_ADVANCE];
+static int32_t out_samples[appconfMAX_CHANNELS * appconfFRAME_ADVANCE];
+
+/* Pipeline frames, in Q31 channel-major order */
+static int32_t in_frame[appconfMAX_CHANNELS][appconfFRAME_ADVANCE];
+static int32_t out_frame[appconfMAX_CHANNELS][appconfFRAME_ADVANCE];
+
+static unsigned file_channels;
+static unsigned file_bit_depth;
+static size_t file_frame_bytes;
+
+/* From the file I/O task on tile 0 to the first pipeline stage on tile 1 */
+static frame_stream_t pipeline_stream;
+
 #if ON_TILE(XSCOPE_HOST_IO_TILE)
 static SemaphoreHandle_t mutex_xscope_fileio;
 
@@ -47,7 +76,14 @@ void init_xscope_host_data_user_cb(chanend_t c_host) {
 
 size_t xscope_fileio_tx_to_host(uint8_t *buf, size_t len_bytes) {
     size_t ret = 0;
-    xQueueSend(fileio_queue, buf, portMAX_DELAY);
+
+    if (len_bytes == 0) {
+        /* Every frame has already been queued, in order, ahead of this */
+        xTaskNotifyGive(fileio_task_handle);
+    } else {
+        xQueueSend(fileio_queue, buf, portMAX_DELAY);
+        ret = len_bytes;
+    }
 
     return ret;
 }
@@ -55,148 +91,286 @@ size_t xscope_fileio_tx_to_host(uint8_t *buf, size_t len_bytes) {
 size_t xscope_fileio_rx_from_host(void *input_app_data, int8_t **input_data_frame, size_t frame_count) {
 
     size_t bytes_received = 0;
-    bytes_received = rtos_intertile_rx_len(
-            intertile_ctx,
-            appconfEXAMPLE_DATA_PORT,
-            portMAX_DELAY);
+    bytes_received = frame_stream_receive(&pipeline_stream,
+                                          input_data_frame,
+                                          frame_count);
     
-    xassert(bytes_received == frame_count);
-
-    rtos_intertile_rx_data(
-            intertile_ctx,
-            input_data_frame,
-            bytes_received);
+    /* An empty frame marks the end of the stream */
+    xassert(bytes_received == frame_count || bytes_received == 0);
 
     return bytes_received;
 }
 
-void xscope_fileio_user_done(void) {
-    xTaskNotifyGive(fileio_task_handle);
+void xscope_fileio_rx_init(void) {
+    frame_stream_rx_init(&pipeline_stream,
+                         intertile_ctx,
+                         appconfEXAMPLE_DATA_PORT,
+                         appconfEXAMPLE_CREDIT_PORT,
+                         appconfINTERTILE_CREDIT_BATCH);
 }
 
-/* This task reads the input file in chunks and sends it through the data pipeline
- * After reading the entire file, it will wait until the user has confirmed
- * all writing is complete before closing files.
- */
- /* NOTE:
-  * xscope fileio uses events.  Only xscope_fread() currently, but wrapping
-  * all calls just in case */
-void xscope_fileio(void *arg) {
-    (void) arg;
-    int state = 0;
-    wav_header input_header_struct, output_header_struct;
-    unsigned input_header_size;
-    unsigned frame_count;
-    unsigned block_count;        
-    uint8_t in_buf[appconfDATA_FRAME_SIZE_BYTES];
-    uint8_t out_buf[appconfDATA_FRAME_SIZE_BYTES];
-    size_t bytes_read = 0;
+void xscope_fileio_rx_done(void) {
+    frame_stream_release(&pipeline_stream);
+}
 
-    /* Wait until xscope_fileio is initialized */
-    while(xscope_fileio_is_initialized() == 0) {
-        vTaskDelay(pdMS_TO_TICKS(1));
+/* Converts the next processed frame to the file's sample format, and writes
+ * it to the output file. Returns 0 if no frame arrived within timeout. */
+static int write_frame(TickType_t timeout)
+{
+    if (xQueueReceive(fileio_queue, out_frame, timeout) != pdTRUE) {
+        return 0;
     }
 
-    fileio_queue = xQueueCreate(1, appconfDATA_FRAME_SIZE_BYTES);
+    wav_convert_from_q31(out_samples, &out_frame[0][0], appconfFRAME_ADVANCE,
+                         file_channels, file_bit_depth, appconfFRAME_ADVANCE);
+    wav_writer_write(&out_wav, (uint8_t *) out_samples, file_frame_bytes);
+    return 1;
+}
 
-    rtos_printf("Open test files\n");
-    state = rtos_osal_critical_enter();
-    {
-        infile = xscope_open_file(appconfINPUT_FILENAME, "rb");
-        outfile = xscope_open_file(appconfOUTPUT_FILENAME, "wb");
-        // Validate input wav file
-        if(get_wav_header_details(&infile, &input_header_struct, &input_header_size) != 0){
-            rtos_printf("Error: error in get_wav_header_details()\n");
-            _Exit(1);
-        }
-        xscope_fseek(&infile, input_header_size, SEEK_SET);
+/* Reads the input file in chunks and sends it through the data pipeline.
+ * After reading the entire file, it sends an end of stream token after the
+ * last frame, and closes the files as soon as the token has passed through
+ * every stage of the pipeline. Returns 0 on success. */
+static int xscope_fileio_process(const char *input_filename, const char *output_filename) {
+    wav_header input_header_struct;
+    unsigned input_header_size;
+    unsigned frame_count;
+    unsigned block_count;        
+    size_t bytes_read = 0;
+    unsigned frames_sent = 0;
+    unsigned frames_written = 0;
+    uint32_t start_time;
+    uint32_t us;
+
+    rtos_printf("Open %s and %s\n", input_filename, output_filename);
+    infile = xscope_fileio_open(input_filename, "rb");
+    outfile = xscope_fileio_open(output_filename, "wb");
+    // Validate input wav file
+    if(get_wav_header_details(&infile, &input_header_struct, &input_header_size) != 0){
+        rtos_printf("Error: error in get_wav_header_details()\n");
+        xscope_fileio_close_all();
+        return 1;
     }
-    rtos_osal_critical_exit(state);
+    xscope_fileio_seek(&infile, input_header_size, SEEK_SET);
 
-    // Ensure 32bit wav file
-    if(input_header_struct.bit_depth != 32)
+    // Ensure the samples can be converted to Q31
+    if(!wav_convert_supported(input_header_struct.bit_depth))
     {
-        rtos_printf("Error: unsupported wav bit depth (%d) for %s file. Only 32 supported\n", input_header_struct.bit_depth, appconfINPUT_FILENAME);
-        _Exit(1);
+        rtos_printf("Error: unsupported wav bit depth (%d) for %s file. Only 16, 24 and 32 supported\n", input_header_struct.bit_depth, input_filename);
+        xscope_fileio_close_all();
+        return 1;
     }
-    // Ensure input wav file contains correct number of channels 
-    if(input_header_struct.num_channels != appconfMAX_CHANNELS){
-        rtos_printf("Error: wav num channels(%d) does not match (%u)\n", input_header_struct.num_channels, appconfMAX_CHANNELS);
-        _Exit(1);
+    // Ensure input wav file fits in a pipeline frame
+    if(input_header_struct.num_channels < 1 || input_header_struct.num_channels > appconfMAX_CHANNELS){
+        rtos_printf("Error: wav num channels(%d) must be from 1 to %u\n", input_header_struct.num_channels, appconfMAX_CHANNELS);
+        xscope_fileio_close_all();
+        return 1;
     }
+    file_channels = input_header_struct.num_channels;
+    file_bit_depth = input_header_struct.bit_depth;
+    file_frame_bytes = appconfFRAME_ADVANCE * wav_get_num_bytes_per_frame(&input_header_struct);
     
     // Calculate number of frames in the wav file
     frame_count = wav_get_num_frames(&input_header_struct);
     block_count = frame_count / appconfFRAME_ADVANCE; 
 
-    // Create output wav file
-    wav_form_header(&output_header_struct,
+    /* Create output wav file, in the same format as the input. Its sizes
+     * are filled in when it is closed, so the number of frames need not be
+     * known in advance. */
+    wav_writer_open(&out_wav,
+        &outfile,
+        out_chunk,
+        sizeof(out_chunk),
         input_header_struct.audio_format,
-        appconfMAX_CHANNELS,
+        file_channels,
         input_header_struct.sample_rate,
-        input_header_struct.bit_depth,
-        block_count*appconfFRAME_ADVANCE);
+        input_header_struct.bit_depth);
 
-    xscope_fwrite(&outfile, (uint8_t*)(&output_header_struct), WAV_HEADER_BYTES);
+    /* The frames are contiguous in both files, so they are read and written
+     * sequentially in chunks of up to appconfFILEIO_CHUNK_SIZE_BYTES. The
+     * input file is already positioned at the first frame. */
+    xscope_fileio_stream_init(&in_stream, &infile, in_chunk, sizeof(in_chunk));
 
-    // ensure the write above has time to complete before performing any reads
-    vTaskDelay(pdMS_TO_TICKS(1000));
+    xscope_fileio_tap_begin(output_filename, file_channels, input_header_struct.sample_rate);
+
+    start_time = get_reference_time();
+
+    /* Channels beyond those in the file are never written */
+    memset(in_frame, 0x00, sizeof(in_frame));
 
     // Iterate over frame blocks and send the data to the first pipeline stage on tile[1]
     for(unsigned b=0; b<block_count; b++) {
-        memset(in_buf, 0x00, appconfDATA_FRAME_SIZE_BYTES);
-        long input_location =  wav_get_frame_start(&input_header_struct, b * appconfFRAME_ADVANCE, input_header_size);
+        // Only wait for a processed frame once the pipeline is full
+        if (frames_sent - frames_written == appconfFILEIO_FRAMES_IN_FLIGHT) {
+            frames_written += write_frame(portMAX_DELAY);
+        }
+
+        bytes_read = xscope_fileio_stream_read(&in_stream, (uint8_t *) in_samples, file_frame_bytes);
+        memset((uint8_t *) in_samples + bytes_read, 0x00, file_frame_bytes - bytes_read);
+        wav_convert_to_q31(&in_frame[0][0], appconfFRAME_ADVANCE, in_samples,
+                           file_channels, file_bit_depth, appconfFRAME_ADVANCE);
+
+        frame_stream_send(&pipeline_stream, in_frame, appconfDATA_FRAME_SIZE_BYTES);
+        frames_sent++;
 
-        state = rtos_osal_critical_enter();
-        {
-            xscope_fseek(&infile, input_location, SEEK_SET);
-            bytes_read = xscope_fread(&infile, in_buf, appconfDATA_FRAME_SIZE_BYTES);
+        // Write any frames that have already come back, without waiting
+        while (write_frame(0)) {
+            frames_written++;
         }
-        rtos_osal_critical_exit(state);
+    }
+
+    // Mark the end of the stream with an empty frame
+    frame_stream_send(&pipeline_stream, in_frame, 0);
+
+    // Write the frames still in the pipeline
+    while (frames_written < frames_sent) {
+        frames_written += write_frame(portMAX_DELAY);
+    }
+    xscope_fileio_stream_close(&in_stream);
+    wav_writer_close(&out_wav);
 
-        memset(in_buf + bytes_read, 0x00, appconfDATA_FRAME_SIZE_BYTES - bytes_read);
+    /* Wait for the end of the stream to reach the pipeline output. It follows
+     * the last frame, so this only waits while it drains through the stages
+     * behind that frame. */
+    (void) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-        rtos_intertile_tx(intertile_ctx,
-                        appconfEXAMPLE_DATA_PORT,
-                        in_buf,
-                        appconfDATA_FRAME_SIZE_BYTES);
+    /* The tap files are written by another task, so may not be complete */
+    xscope_fileio_tap_wait_end();
 
-        // read from queue here and write to file 
-        xQueueReceive(fileio_queue,  out_buf, portMAX_DELAY);
-        xscope_fwrite(&outfile, out_buf, appconfDATA_FRAME_SIZE_BYTES);
+    us = (get_reference_time() - start_time) / XS1_TIMER_MHZ;
+
+    xscope_fileio_stream_report(&in_stream, "Read");
+    xscope_fileio_stream_report(&out_wav.stream, "Write");
+    rtos_printf("%s: %u frames in %u us, %u us per frame\n",
+                input_filename,
+                block_count,
+                us,
+                block_count > 0 ? us / block_count : 0);
+
+    xscope_fileio_close_all();
+
+    return 0;
+}
+
+#if appconfFILEIO_BATCH_MODE
+/* Splits the next input and output file names from a line of the manifest.
+ * Returns 0 once there are none left. Malformed lines are counted in errors
+ * and skipped. */
+static int manifest_next(char **pos, char **input_filename, char **output_filename, int *errors) {
+    char *p = *pos;
+
+    while (*p != '\0') {
+        char *line = p;
+        char *fields[3] = {NULL, NULL, NULL};
+        int count = 0;
+
+        /* Terminate this line, and move on to the next */
+        p += strcspn(p, "\r\n");
+        if (*p != '\0') {
+            *p++ = '\0';
+        }
+
+        /* Blank lines and lines starting with '#' are skipped */
+        for (char *f = strtok(line, " \t"); f != NULL && count < 3; f = strtok(NULL, " \t")) {
+            fields[count++] = f;
+        }
+        if (count == 0 || fields[0][0] == '#') {
+            continue;
+        }
+        if (count != 2) {
+            rtos_printf("Error: manifest line \"%s\" is not an input and an output file name\n", fields[0]);
+            (*errors)++;
+            continue;
+        }
+
+        *pos = p;
+        *input_filename = fields[0];
+        *output_filename = fields[1];
+        return 1;
     }
 
-#if (appconfAPP_NOTIFY_FILEIO_DONE == 1)
-    /* Wait for user to tell us they are done writing */
-    (void) ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
-#else
-    /* Otherwise, assume data pipeline is done after 1 second */
-    vTaskDelay(pdMS_TO_TICKS(1000));
+    *pos = p;
+    return 0;
+}
 #endif
 
-    rtos_printf("Close all files\n");
-    state = rtos_osal_critical_enter();
+/* This task processes the input file, or each of the files in the batch
+ * manifest in turn, then closes the app.
+ */
+ /* NOTE:
+  * All of the xscope fileio calls are made by the xscope_fileio_async task,
+  * so this task, and the rest of the tile, keep running while the host
+  * services each request */
+void xscope_fileio(void *arg) {
+    (void) arg;
+    int errors = 0;
+
+    /* Wait until xscope_fileio is initialized */
+    while(xscope_fileio_is_initialized() == 0) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+
+    /* Every frame in flight can be waiting here, so the data pipeline never
+     * blocks on sending a frame back to this task */
+    fileio_queue = xQueueCreate(appconfFILEIO_FRAMES_IN_FLIGHT, appconfDATA_FRAME_SIZE_BYTES);
+
+#if appconfFILEIO_BATCH_MODE
     {
-        xscope_close_all_files();
+        static char manifest[appconfFILEIO_BATCH_MANIFEST_MAX_BYTES];
+        xscope_file_t manifest_file;
+        size_t manifest_len;
+        char *pos = manifest;
+        char *input_filename;
+        char *output_filename;
+        unsigned file_count = 0;
+        uint32_t start_time = get_reference_time();
+
+        /* The whole manifest is read first, as the files are closed after
+         * each pair is processed */
+        manifest_file = xscope_fileio_open(appconfFILEIO_BATCH_MANIFEST_FILENAME, "rb");
+        manifest_len = xscope_fileio_read(&manifest_file, (uint8_t *) manifest, sizeof(manifest) - 1);
+        xscope_fileio_close_all();
+        if (manifest_len == sizeof(manifest) - 1) {
+            rtos_printf("Error: %s is larger than %u bytes\n",
+                        appconfFILEIO_BATCH_MANIFEST_FILENAME,
+                        appconfFILEIO_BATCH_MANIFEST_MAX_BYTES - 1);
+            _Exit(1);
+        }
+        manifest[manifest_len] = '\0';
+
+        while (manifest_next(&pos, &input_filename, &output_filename, &errors)) {
+            errors += xscope_fileio_process(input_filename, output_filename);
+            file_count++;
+        }
+
+        rtos_printf("Processed %u files, %d failed, in %u ms\n",
+                    file_count,
+                    errors,
+                    (get_reference_time() - start_time) / (1000 * XS1_TIMER_MHZ));
     }
-    rtos_osal_critical_exit(state);
+#else
+    errors = xscope_fileio_process(appconfINPUT_FILENAME, appconfOUTPUT_FILENAME);
+#endif
 
     /* Close the app */
-    _Exit(0);
+    _Exit(errors ? 1 : 0);
 }
 
 void xscope_fileio_tasks_create(unsigned priority, void* app_data) {
+    xscope_fileio_async_task_create(priority);
+    xscope_fileio_tap_tasks_create(priority);
+
+    frame_stream_tx_init(&pipeline_stream,
+                         intertile_ctx,
+                         appconfEXAMPLE_DATA_PORT,
+                         appconfEXAMPLE_CREDIT_PORT,
+                         appconfINTERTILE_FRAME_CREDITS,
+                         priority);
+
     xTaskCreate((TaskFunction_t)xscope_fileio,
                 "xscope_fileio",
                 RTOS_THREAD_STACK_SIZE(xscope_fileio),
                 app_data,
                 priority,
                 &fileio_task_handle);
-    
-    // Define the core affinity mask such that this task can only run on a specific core
-    UBaseType_t uxCoreAffinityMask = 0x10;
-
-
-    /* Set the core affinity mask for the task. */
-    vTaskCoreAffinitySet( fileio_task_handle, uxCoreAffinityMask );                
 }
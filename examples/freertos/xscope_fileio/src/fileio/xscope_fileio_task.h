@@ -8,13 +8,21 @@
 
 void xscope_fileio_tasks_create(unsigned priority, void* app_data);
 
-/* Signal to fileio that the application is done and files can be closed */
-void xscope_fileio_user_done(void);
-
 /* Send len_bytes
+ * A len_bytes of 0 signals the end of the stream, after which the files are
+ * closed
  * returns number of bytes sent */
 size_t xscope_fileio_tx_to_host(uint8_t *buf, size_t len_bytes);
 
+/* Receive a frame of frame_count bytes
+ * returns frame_count, or 0 at the end of the stream */
 size_t xscope_fileio_rx_from_host(void *input_app_data, int8_t **input_data_frame, size_t frame_count);
 
+/* Set up the receiving end of xscope_fileio_rx_from_host(), on the tile
+ * that does not do the host I/O */
+void xscope_fileio_rx_init(void);
+
+/* Signal that a frame from xscope_fileio_rx_from_host() has been consumed */
+void xscope_fileio_rx_done(void);
+
 #endif /* XSCOPE_FILEIO_TASK_H_ */
@@ -19,9 +19,10 @@
 #include "platform/platform_init.h"
 #include "platform/driver_instances.h"
 #include "fileio/xscope_fileio_task.h"
+#include "fileio/xscope_fileio_tap.h"
 #include "data_pipeline.h"
 
-void data_pipeline_input(
+size_t data_pipeline_input(
         void *input_app_data,
         int8_t **input_data_frame,
         size_t frame_count)
@@ -29,7 +30,19 @@ void data_pipeline_input(
     (void) input_app_data;
     
 #if (DATA_TRANSPORT_METHOD == XSCOPE_FILEIO)
-    xscope_fileio_rx_from_host(input_app_data, input_data_frame, frame_count);
+    return xscope_fileio_rx_from_host(input_app_data, input_data_frame, frame_count);
+#else
+    return 0;
+#endif
+}
+
+void data_pipeline_input_done(
+        void *input_app_data)
+{
+    (void) input_app_data;
+
+#if (DATA_TRANSPORT_METHOD == XSCOPE_FILEIO)
+    xscope_fileio_rx_done();
 #endif
 }
 
@@ -47,6 +60,15 @@ int data_pipeline_output(
     return DATA_PIPELINE_FREE_FRAME;
 }
 
+void data_pipeline_tap_output(
+        const pipeline_tap_frame_t *frame,
+        size_t frame_bytes)
+{
+#if (DATA_TRANSPORT_METHOD == XSCOPE_FILEIO)
+    xscope_fileio_tap_output(frame, frame_bytes);
+#endif
+}
+
 void vApplicationMallocFailedHook(void)
 {
     rtos_printf("Malloc Failed on tile %d!\n", THIS_XCORE_TILE);
@@ -56,8 +78,11 @@ void vApplicationMallocFailedHook(void)
 
 static void mem_analysis(void)
 {
+	const frame_pool_t *pool = data_pipeline_frame_pool();
+
 	for (;;) {
 		rtos_printf("Tile[%d]:\n\tMinimum heap free: %d\n\tCurrent heap free: %d\n", THIS_XCORE_TILE, xPortGetMinimumEverFreeHeapSize(), xPortGetFreeHeapSize());
+		rtos_printf("\tFrame pool in use: %u\n\tFrame pool peak in use: %u of %u\n\tFrame pool empty: %u\n", frame_pool_in_use(pool), pool->peak_in_use, pool->count, pool->empty_count);
 		vTaskDelay(pdMS_TO_TICKS(5000));
 	}
 }
@@ -71,7 +96,14 @@ void startup_task(void *arg)
 #if (DATA_TRANSPORT_METHOD == XSCOPE_FILEIO)
 #if ON_TILE(XSCOPE_HOST_IO_TILE)
     xscope_fileio_tasks_create(appconfXSCOPE_IO_TASK_PRIORITY, NULL);
+#else
+    xscope_fileio_rx_init();
+    xscope_fileio_tap_tx_init(appconfXSCOPE_IO_TASK_PRIORITY);
+#endif
 #endif
+
+#if appconfFRAME_POOL_BENCHMARK
+    data_pipeline_frame_pool_benchmark();
 #endif
 
     data_pipeline_init(NULL, NULL);
@@ -0,0 +1,306 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "wav_convert.h"
+
+#define MSB16_MASK 0xffff0000
+#define MSB24_MASK 0xffffff00
+
+/* Walks a channel-major frame in the order of the interleaved samples */
+typedef struct {
+    int32_t *frame;
+    int32_t *p;
+    size_t stride;
+    unsigned channels;
+    unsigned c;
+    size_t t;
+} frame_cursor_t;
+
+static inline void cursor_init(frame_cursor_t *cur, int32_t *frame, size_t stride, unsigned channels)
+{
+    cur->frame = frame;
+    cur->p = frame;
+    cur->stride = stride;
+    cur->channels = channels;
+    cur->c = 0;
+    cur->t = 0;
+}
+
+/* Moves a cursor on to the first channel of sample t */
+static inline void cursor_seek(frame_cursor_t *cur, size_t t)
+{
+    cur->t = t;
+    cur->p = cur->frame + t;
+}
+
+static inline int32_t *cursor_next(frame_cursor_t *cur)
+{
+    int32_t *p = cur->p;
+
+    if (++cur->c == cur->channels) {
+        cur->c = 0;
+        cur->p = cur->frame + ++cur->t;
+    } else {
+        cur->p += cur->stride;
+    }
+    return p;
+}
+
+int wav_convert_supported(unsigned bit_depth)
+{
+    return bit_depth == 16 || bit_depth == 24 || bit_depth == 32;
+}
+
+/* Each word holds two 16 bit samples */
+static void to_q31_16(frame_cursor_t *cur, const uint32_t *src, size_t n)
+{
+    size_t i;
+
+    if (cur->channels == 1) {
+        int32_t *dst = cur->frame;
+
+        for (i = 0; i + 2 <= n; i += 2) {
+            uint32_t w = src[i / 2];
+            dst[i] = (int32_t) (w << 16);
+            dst[i + 1] = (int32_t) (w & MSB16_MASK);
+        }
+        cursor_seek(cur, i);
+    } else if (cur->channels == 2) {
+        /* Each word holds both channels of a frame */
+        int32_t *left = cur->frame;
+        int32_t *right = cur->frame + cur->stride;
+
+        for (i = 0; i + 2 <= n; i += 2) {
+            uint32_t w = src[i / 2];
+            left[i / 2] = (int32_t) (w << 16);
+            right[i / 2] = (int32_t) (w & MSB16_MASK);
+        }
+    } else {
+        for (i = 0; i + 2 <= n; i += 2) {
+            uint32_t w = src[i / 2];
+            *cursor_next(cur) = (int32_t) (w << 16);
+            *cursor_next(cur) = (int32_t) (w & MSB16_MASK);
+        }
+    }
+
+    if (i < n) {
+        const uint8_t *b = (const uint8_t *) src + 2 * i;
+        *cursor_next(cur) = (int32_t) (((uint32_t) b[0] << 16) | ((uint32_t) b[1] << 24));
+    }
+}
+
+/* Every three words hold four 24 bit samples */
+#define UNPACK24_0(w0, w1, w2) ((int32_t) ((w0) << 8))
+#define UNPACK24_1(w0, w1, w2) ((int32_t) ((((w0) >> 16) & 0x0000ff00) | ((w1) << 16)))
+#define UNPACK24_2(w0, w1, w2) ((int32_t) ((((w1) >> 8) & 0x00ffff00) | ((w2) << 24)))
+#define UNPACK24_3(w0, w1, w2) ((int32_t) ((w2) & MSB24_MASK))
+
+#define PACK24_0(s0, s1, s2, s3) (((s0) >> 8) | (((s1) << 16) & 0xff000000))
+#define PACK24_1(s0, s1, s2, s3) (((s1) >> 16) | (((s2) << 8) & MSB16_MASK))
+#define PACK24_2(s0, s1, s2, s3) (((s2) >> 24) | ((s3) & MSB24_MASK))
+
+static void to_q31_24(frame_cursor_t *cur, const uint32_t *src, size_t n)
+{
+    size_t i;
+
+    if (cur->channels == 1) {
+        int32_t *dst = cur->frame;
+
+        for (i = 0; i + 4 <= n; i += 4, src += 3) {
+            dst[i] = UNPACK24_0(src[0], src[1], src[2]);
+            dst[i + 1] = UNPACK24_1(src[0], src[1], src[2]);
+            dst[i + 2] = UNPACK24_2(src[0], src[1], src[2]);
+            dst[i + 3] = UNPACK24_3(src[0], src[1], src[2]);
+        }
+        cursor_seek(cur, i);
+    } else if (cur->channels == 2) {
+        /* Every three words hold two frames */
+        int32_t *left = cur->frame;
+        int32_t *right = cur->frame + cur->stride;
+
+        for (i = 0; i + 4 <= n; i += 4, src += 3) {
+            left[i / 2] = UNPACK24_0(src[0], src[1], src[2]);
+            right[i / 2] = UNPACK24_1(src[0], src[1], src[2]);
+            left[i / 2 + 1] = UNPACK24_2(src[0], src[1], src[2]);
+            right[i / 2 + 1] = UNPACK24_3(src[0], src[1], src[2]);
+        }
+        cursor_seek(cur, i / 2);
+    } else {
+        for (i = 0; i + 4 <= n; i += 4, src += 3) {
+            *cursor_next(cur) = UNPACK24_0(src[0], src[1], src[2]);
+            *cursor_next(cur) = UNPACK24_1(src[0], src[1], src[2]);
+            *cursor_next(cur) = UNPACK24_2(src[0], src[1], src[2]);
+            *cursor_next(cur) = UNPACK24_3(src[0], src[1], src[2]);
+        }
+    }
+
+    for (const uint8_t *b = (const uint8_t *) src; i < n; i++, b += 3) {
+        *cursor_next(cur) = (int32_t) (((uint32_t) b[0] << 8) |
+                                       ((uint32_t) b[1] << 16) |
+                                       ((uint32_t) b[2] << 24));
+    }
+}
+
+static void to_q31_32(frame_cursor_t *cur, const uint32_t *src, size_t n)
+{
+    if (cur->channels == 1) {
+        memcpy(cur->frame, src, n * sizeof(int32_t));
+    } else if (cur->channels == 2) {
+        int32_t *left = cur->frame;
+        int32_t *right = cur->frame + cur->stride;
+
+        for (size_t t = 0; t < n / 2; t++) {
+            left[t] = (int32_t) src[2 * t];
+            right[t] = (int32_t) src[2 * t + 1];
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            *cursor_next(cur) = (int32_t) src[i];
+        }
+    }
+}
+
+void wav_convert_to_q31(int32_t *dst,
+                        size_t dst_stride,
+                        const void *src,
+                        unsigned channels,
+                        unsigned bit_depth,
+                        size_t count)
+{
+    frame_cursor_t cur;
+    size_t n = count * channels;
+
+    cursor_init(&cur, dst, dst_stride, channels);
+
+    switch (bit_depth) {
+    case 16:
+        to_q31_16(&cur, src, n);
+        break;
+    case 24:
+        to_q31_24(&cur, src, n);
+        break;
+    case 32:
+        to_q31_32(&cur, src, n);
+        break;
+    }
+}
+
+static void from_q31_16(frame_cursor_t *cur, uint32_t *dst, size_t n)
+{
+    size_t i;
+
+    if (cur->channels == 1) {
+        const int32_t *src = cur->frame;
+
+        for (i = 0; i + 2 <= n; i += 2) {
+            dst[i / 2] = ((uint32_t) src[i] >> 16) | ((uint32_t) src[i + 1] & MSB16_MASK);
+        }
+        cursor_seek(cur, i);
+    } else if (cur->channels == 2) {
+        const int32_t *left = cur->frame;
+        const int32_t *right = cur->frame + cur->stride;
+
+        for (i = 0; i + 2 <= n; i += 2) {
+            dst[i / 2] = ((uint32_t) left[i / 2] >> 16) | ((uint32_t) right[i / 2] & MSB16_MASK);
+        }
+    } else {
+        for (i = 0; i + 2 <= n; i += 2) {
+            uint32_t s0 = (uint32_t) *cursor_next(cur);
+            uint32_t s1 = (uint32_t) *cursor_next(cur);
+            dst[i / 2] = (s0 >> 16) | (s1 & MSB16_MASK);
+        }
+    }
+
+    if (i < n) {
+        uint8_t *b = (uint8_t *) dst + 2 * i;
+        uint32_t s = (uint32_t) *cursor_next(cur);
+        b[0] = (uint8_t) (s >> 16);
+        b[1] = (uint8_t) (s >> 24);
+    }
+}
+
+static void from_q31_24(frame_cursor_t *cur, uint32_t *dst, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4, dst += 3) {
+        uint32_t s0, s1, s2, s3;
+
+        if (cur->channels == 2) {
+            const int32_t *left = cur->frame;
+            const int32_t *right = cur->frame + cur->stride;
+
+            s0 = (uint32_t) left[i / 2];
+            s1 = (uint32_t) right[i / 2];
+            s2 = (uint32_t) left[i / 2 + 1];
+            s3 = (uint32_t) right[i / 2 + 1];
+        } else {
+            s0 = (uint32_t) *cursor_next(cur);
+            s1 = (uint32_t) *cursor_next(cur);
+            s2 = (uint32_t) *cursor_next(cur);
+            s3 = (uint32_t) *cursor_next(cur);
+        }
+
+        dst[0] = PACK24_0(s0, s1, s2, s3);
+        dst[1] = PACK24_1(s0, s1, s2, s3);
+        dst[2] = PACK24_2(s0, s1, s2, s3);
+    }
+    if (cur->channels == 2) {
+        cursor_seek(cur, i / 2);
+    }
+
+    for (uint8_t *b = (uint8_t *) dst; i < n; i++, b += 3) {
+        uint32_t s = (uint32_t) *cursor_next(cur);
+        b[0] = (uint8_t) (s >> 8);
+        b[1] = (uint8_t) (s >> 16);
+        b[2] = (uint8_t) (s >> 24);
+    }
+}
+
+static void from_q31_32(frame_cursor_t *cur, uint32_t *dst, size_t n)
+{
+    if (cur->channels == 1) {
+        memcpy(dst, cur->frame, n * sizeof(int32_t));
+    } else if (cur->channels == 2) {
+        const int32_t *left = cur->frame;
+        const int32_t *right = cur->frame + cur->stride;
+
+        for (size_t t = 0; t < n / 2; t++) {
+            dst[2 * t] = (uint32_t) left[t];
+            dst[2 * t + 1] = (uint32_t) right[t];
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = (uint32_t) *cursor_next(cur);
+        }
+    }
+}
+
+void wav_convert_from_q31(void *dst,
+                          const int32_t *src,
+                          size_t src_stride,
+                          unsigned channels,
+                          unsigned bit_depth,
+                          size_t count)
+{
+    frame_cursor_t cur;
+    size_t n = count * channels;
+
+    /* The cursor is only read through in this direction */
+    cursor_init(&cur, (int32_t *) src, src_stride, channels);
+
+    switch (bit_depth) {
+    case 16:
+        from_q31_16(&cur, dst, n);
+        break;
+    case 24:
+        from_q31_24(&cur, dst, n);
+        break;
+    case 32:
+        from_q31_32(&cur, dst, n);
+        break;
+    }
+}
@@ -0,0 +1,44 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef WAV_CONVERT_H
+#define WAV_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Conversion between the interleaved PCM samples of a WAV file and the Q31,
+ * channel-major frames of the data pipeline.
+ *
+ * Samples are 16, 24 or 32 bit little endian. In a frame, sample t of channel
+ * c is at frame[c * stride + t]. 16 and 24 bit samples are shifted to the
+ * most significant bits of a Q31 sample, and Q31 samples are truncated to 16
+ * or 24 bits.
+ *
+ * The WAV sample buffers must be word aligned. They are converted a word at a
+ * time, so that each 32 bit load or store carries as many samples as it
+ * holds, rather than one byte at a time.
+ */
+
+/* Returns non-zero if samples of bit_depth bits can be converted */
+int wav_convert_supported(unsigned bit_depth);
+
+/* Converts count frames of interleaved samples, of channels channels, from
+ * src into a channel-major Q31 frame at dst */
+void wav_convert_to_q31(int32_t *dst,
+                        size_t dst_stride,
+                        const void *src,
+                        unsigned channels,
+                        unsigned bit_depth,
+                        size_t count);
+
+/* Converts count frames from a channel-major Q31 frame at src into
+ * interleaved samples, of channels channels, at dst */
+void wav_convert_from_q31(void *dst,
+                          const int32_t *src,
+                          size_t src_stride,
+                          unsigned channels,
+                          unsigned bit_depth,
+                          size_t count);
+
+#endif // WAV_CONVERT_H
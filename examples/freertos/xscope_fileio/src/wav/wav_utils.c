@@ -11,11 +11,15 @@
 #include "FreeRTOS.h"
 
 #include "wav_utils.h"
+#include "fileio/xscope_fileio_async.h"
 
 
 #define RIFF_SECTION_SIZE (12)
+#define SUBCHUNK_HEADER_SIZE (8)
 #define FMT_SUBCHUNK_MIN_SIZE (24)
 #define EXTENDED_FMT_GUID_SIZE (16)
+#define DS64_SUBCHUNK_SIZE (28)
+#define RF64_SIZE_IN_DS64 (0xffffffff)
 static const char wav_default_header[WAV_HEADER_BYTES] = {
         0x52, 0x49, 0x46, 0x46,
         0x00, 0x00, 0x00, 0x00,
@@ -32,9 +36,9 @@ static const char wav_default_header[WAV_HEADER_BYTES] = {
 
 int get_wav_header_details(xscope_file_t *input_file, wav_header *s, unsigned *header_size){
   //Assume file is already open here. First rewind.
-  xscope_fseek(input_file, 0, SEEK_SET);
+  xscope_fileio_seek(input_file, 0, SEEK_SET);
   //read riff header section (12 bytes)
-  xscope_fread(input_file, (uint8_t*)(&s->riff_header[0]), RIFF_SECTION_SIZE);
+  xscope_fileio_read(input_file, (uint8_t*)(&s->riff_header[0]), RIFF_SECTION_SIZE);
   if(memcmp(s->riff_header, "RIFF", sizeof(s->riff_header)) != 0)
   {
     rtos_printf("Error: couldn't find RIFF: 0x%x, 0x%x, 0x%x, 0x%x\n", s->riff_header[0], s->riff_header[1], s->riff_header[2], s->riff_header[3]);
@@ -47,12 +51,28 @@ int get_wav_header_details(xscope_file_t *input_file, wav_header *s, unsigned *h
     return 1;
   }
   
-  xscope_fread(input_file, (uint8_t*)&s->fmt_header[0], FMT_SUBCHUNK_MIN_SIZE);
-  if(memcmp(s->fmt_header, "fmt ", sizeof(s->fmt_header)) != 0)
+  //read subchunk headers (8 bytes), skipping any subchunk before fmt, such as the JUNK written by wav_writer_open()
+  if(xscope_fileio_read(input_file, (uint8_t*)&s->fmt_header[0], SUBCHUNK_HEADER_SIZE) != SUBCHUNK_HEADER_SIZE)
   {
-    rtos_printf("Error: couldn't find fmt: 0x%x, 0x%x, 0x%x, 0x%x\n", s->fmt_header[0], s->fmt_header[1], s->fmt_header[2], s->fmt_header[3]);
+    rtos_printf("Error: couldn't find fmt\n");
     return 1;
   }
+  while(memcmp(s->fmt_header, "fmt ", sizeof(s->fmt_header)) != 0)
+  {
+    if(memcmp(s->fmt_header, "JUNK", sizeof(s->fmt_header)) != 0)
+    {
+      rtos_printf("Error: couldn't find fmt: 0x%x, 0x%x, 0x%x, 0x%x\n", s->fmt_header[0], s->fmt_header[1], s->fmt_header[2], s->fmt_header[3]);
+      return 1;
+    }
+    //subchunks are padded to an even size
+    xscope_fileio_seek(input_file, s->fmt_chunk_size + (s->fmt_chunk_size & 1), SEEK_CUR);
+    if(xscope_fileio_read(input_file, (uint8_t*)&s->fmt_header[0], SUBCHUNK_HEADER_SIZE) != SUBCHUNK_HEADER_SIZE)
+    {
+      rtos_printf("Error: couldn't find fmt\n");
+      return 1;
+    }
+  }
+  xscope_fileio_read(input_file, (uint8_t*)&s->audio_format, FMT_SUBCHUNK_MIN_SIZE - SUBCHUNK_HEADER_SIZE);
   
   unsigned fmt_subchunk_actual_size = s->fmt_chunk_size + sizeof(s->fmt_header) + sizeof(s->fmt_chunk_size); //fmt_chunk_size doesn't include the fmt_header(4) and size(4) bytes
   unsigned fmt_subchunk_remaining_size = fmt_subchunk_actual_size - FMT_SUBCHUNK_MIN_SIZE;
@@ -60,16 +80,16 @@ int get_wav_header_details(xscope_file_t *input_file, wav_header *s, unsigned *h
   if(s->audio_format == (short)0xfffe)
   {
     //seek to the end of fmt subchunk and rewind 16bytes to the beginning of GUID
-    xscope_fseek(input_file, fmt_subchunk_remaining_size - EXTENDED_FMT_GUID_SIZE, SEEK_CUR);
+    xscope_fileio_seek(input_file, fmt_subchunk_remaining_size - EXTENDED_FMT_GUID_SIZE, SEEK_CUR);
     //The first 2 bytes of GUID is the audio_format.
-    xscope_fread(input_file, (uint8_t *)&s->audio_format, sizeof(s->audio_format));
+    xscope_fileio_read(input_file, (uint8_t *)&s->audio_format, sizeof(s->audio_format));
     //skip the rest of GUID
-    xscope_fseek(input_file, EXTENDED_FMT_GUID_SIZE - sizeof(s->audio_format), SEEK_CUR);
+    xscope_fileio_seek(input_file, EXTENDED_FMT_GUID_SIZE - sizeof(s->audio_format), SEEK_CUR);
   }
   else
   {
     //go to the end of fmt subchunk
-    xscope_fseek(input_file, fmt_subchunk_remaining_size, SEEK_CUR);
+    xscope_fileio_seek(input_file, fmt_subchunk_remaining_size, SEEK_CUR);
   }
   if(s->audio_format != 1)
   {
@@ -78,14 +98,14 @@ int get_wav_header_details(xscope_file_t *input_file, wav_header *s, unsigned *h
   }
   
   //read header (4 bytes) for the next subchunk
-  xscope_fread(input_file, (uint8_t*)&s->data_header[0], sizeof(s->data_header));
+  xscope_fileio_read(input_file, (uint8_t*)&s->data_header[0], sizeof(s->data_header));
   //if next subchunk is fact, read subchunk size and skip it
   if(memcmp(s->data_header, "fact", sizeof(s->data_header)) == 0)
   {
     uint32_t chunksize;
-    xscope_fread(input_file, (uint8_t *)&chunksize, sizeof(s->data_bytes));
-    xscope_fseek(input_file, chunksize, SEEK_CUR);
-    xscope_fread(input_file, (uint8_t*)(&s->data_header[0]), sizeof(s->data_header));
+    xscope_fileio_read(input_file, (uint8_t *)&chunksize, sizeof(s->data_bytes));
+    xscope_fileio_seek(input_file, chunksize, SEEK_CUR);
+    xscope_fileio_read(input_file, (uint8_t*)(&s->data_header[0]), sizeof(s->data_header));
   }
   //only thing expected at this point is the 'data' subchunk. Throw error if not found.
   if(memcmp(s->data_header, "data", sizeof(s->data_header)) != 0)
@@ -94,8 +114,8 @@ int get_wav_header_details(xscope_file_t *input_file, wav_header *s, unsigned *h
     return 1;
   }
   //read data subchunk size. 
-  xscope_fread(input_file, (uint8_t *)&s->data_bytes, sizeof(s->data_bytes));
-  *header_size = xscope_ftell(input_file); //total file size should be header_size + data_bytes
+  xscope_fileio_read(input_file, (uint8_t *)&s->data_bytes, sizeof(s->data_bytes));
+  *header_size = xscope_fileio_tell(input_file); //total file size should be header_size + data_bytes
   //No need to close file - handled by caller
 
   return 0;
@@ -137,3 +157,112 @@ int wav_get_num_frames(const wav_header *s){
 long wav_get_frame_start(const wav_header *s, unsigned frame_number, uint32_t wavheader_size){
     return wavheader_size + frame_number * wav_get_num_bytes_per_frame(s);
 }
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, (uint16_t) v);
+    put_u16(p + 2, (uint16_t) (v >> 16));
+}
+
+static void put_u64(uint8_t *p, uint64_t v)
+{
+    put_u32(p, (uint32_t) v);
+    put_u32(p + 4, (uint32_t) (v >> 32));
+}
+
+/* Forms the header of a file of data_bytes bytes of samples. The JUNK chunk
+ * becomes the ds64 chunk of an RF64 file once the sizes no longer fit in 32
+ * bits. */
+static void wav_writer_form_header(const wav_writer_t *writer,
+        uint8_t header[WAV_WRITER_HEADER_BYTES],
+        uint64_t data_bytes)
+{
+    unsigned bytes_per_frame = writer->num_channels * (writer->bit_depth / 8);
+    /* The data chunk is padded to an even size */
+    uint64_t riff_size = WAV_WRITER_HEADER_BYTES - 8 + data_bytes + (data_bytes & 1);
+    int rf64 = riff_size > UINT32_MAX;
+
+    memset(header, 0, WAV_WRITER_HEADER_BYTES);
+
+    memcpy(&header[0], rf64 ? "RF64" : "RIFF", 4);
+    put_u32(&header[4], rf64 ? RF64_SIZE_IN_DS64 : (uint32_t) riff_size);
+    memcpy(&header[8], "WAVE", 4);
+
+    memcpy(&header[12], rf64 ? "ds64" : "JUNK", 4);
+    put_u32(&header[16], DS64_SUBCHUNK_SIZE);
+    if (rf64) {
+        put_u64(&header[20], riff_size);
+        put_u64(&header[28], data_bytes);
+        put_u64(&header[36], data_bytes / bytes_per_frame);
+        /* No table of other chunk sizes */
+    }
+
+    memcpy(&header[48], "fmt ", 4);
+    put_u32(&header[52], 16);
+    put_u16(&header[56], writer->audio_format);
+    put_u16(&header[58], writer->num_channels);
+    put_u32(&header[60], writer->sample_rate);
+    put_u32(&header[64], writer->sample_rate * bytes_per_frame);
+    put_u16(&header[68], bytes_per_frame);
+    put_u16(&header[70], writer->bit_depth);
+
+    memcpy(&header[72], "data", 4);
+    put_u32(&header[76], rf64 ? RF64_SIZE_IN_DS64 : (uint32_t) data_bytes);
+}
+
+void wav_writer_open(wav_writer_t *writer,
+        xscope_file_t *file,
+        uint8_t *buf,
+        size_t size,
+        short audio_format,
+        short num_channels,
+        int sample_rate,
+        short bit_depth){
+    uint8_t header[WAV_WRITER_HEADER_BYTES];
+
+    writer->file = file;
+    writer->audio_format = audio_format;
+    writer->num_channels = num_channels;
+    writer->sample_rate = sample_rate;
+    writer->bit_depth = bit_depth;
+    writer->data_bytes = 0;
+
+    /* A file that is never closed is still a valid, if empty, WAV file */
+    wav_writer_form_header(writer, header, 0);
+    xscope_fileio_seek(file, 0, SEEK_SET);
+    xscope_fileio_write(file, header, sizeof(header));
+
+    xscope_fileio_stream_init(&writer->stream, file, buf, size);
+}
+
+void wav_writer_write(wav_writer_t *writer, const uint8_t *data, size_t len){
+    xscope_fileio_stream_write(&writer->stream, data, len);
+    writer->data_bytes += len;
+}
+
+void wav_writer_close(wav_writer_t *writer){
+    uint8_t header[WAV_WRITER_HEADER_BYTES];
+
+    if (writer->data_bytes & 1) {
+        const uint8_t pad = 0;
+        xscope_fileio_stream_write(&writer->stream, &pad, 1);
+    }
+    xscope_fileio_stream_flush(&writer->stream);
+
+    /* The stream has no requests outstanding, so the header is rewritten
+     * after all of the samples */
+    wav_writer_form_header(writer, header, writer->data_bytes);
+    xscope_fileio_seek(writer->file, 0, SEEK_SET);
+    xscope_fileio_write(writer->file, header, sizeof(header));
+}
+
+uint64_t wav_writer_num_frames(const wav_writer_t *writer){
+    unsigned bytes_per_frame = writer->num_channels * (writer->bit_depth / 8);
+    return writer->data_bytes / bytes_per_frame;
+}
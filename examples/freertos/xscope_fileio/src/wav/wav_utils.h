@@ -6,9 +6,14 @@
 #include <stdint.h>
 
 #include "xscope_io_device.h"
+#include "fileio/xscope_fileio_stream.h"
 
 #define WAV_HEADER_BYTES 44
 
+/* The header written by wav_writer_open(). It reserves room, in a JUNK chunk,
+ * for the ds64 chunk of an RF64 file. */
+#define WAV_WRITER_HEADER_BYTES 80
+
 typedef struct wav_header {
     // RIFF Header
     char riff_header[4];    // Should be "RIFF"
@@ -45,4 +50,43 @@ int wav_get_num_frames(const wav_header *s);
 
 long wav_get_frame_start(const wav_header *s, unsigned frame_number, uint32_t wavheader_size);
 
+/*
+ * Writes a WAV file whose length is not known in advance. A header with
+ * placeholder sizes is written when the writer is opened, the samples are
+ * appended through a xscope_fileio_stream in large batched writes, and the
+ * header is rewritten with the actual sizes when the writer is closed.
+ *
+ * A file whose sizes do not fit the 32 bit fields of a WAV file, once its
+ * data reaches 4 GB, is written as RF64 instead.
+ */
+typedef struct {
+    xscope_fileio_stream_t stream;
+    xscope_file_t *file;
+    short audio_format;
+    short num_channels;
+    int sample_rate;
+    short bit_depth;
+    uint64_t data_bytes;
+} wav_writer_t;
+
+/* Writes the placeholder header to the start of file. buf, of size bytes, is
+ * the stream's chunk buffer. */
+void wav_writer_open(wav_writer_t *writer,
+        xscope_file_t *file,
+        uint8_t *buf,
+        size_t size,
+        short audio_format,
+        short num_channels,
+        int sample_rate,
+        short bit_depth);
+
+/* Appends len bytes of samples */
+void wav_writer_write(wav_writer_t *writer, const uint8_t *data, size_t len);
+
+/* Writes any buffered samples and rewrites the header with the final sizes */
+void wav_writer_close(wav_writer_t *writer);
+
+/* The number of frames written so far */
+uint64_t wav_writer_num_frames(const wav_writer_t *writer);
+
 #endif // WAV_UTILS_H
@@ -1,11 +1,17 @@
 #**********************
 # Gather Sources
 #**********************
+set(SHARED_AUDIO_PIPELINE_DIR ${CMAKE_CURRENT_LIST_DIR}/../../shared/audio_pipeline)
+
 file(GLOB_RECURSE APP_SOURCES ${CMAKE_CURRENT_LIST_DIR}/src/*.c )
+list(APPEND APP_SOURCES
+    ${SHARED_AUDIO_PIPELINE_DIR}/frame_pool.c
+)
 set(APP_INCLUDES
     ${CMAKE_CURRENT_LIST_DIR}/src
     ${CMAKE_CURRENT_LIST_DIR}/src/wav
     ${CMAKE_CURRENT_LIST_DIR}/src/data_pipeline/api
+    ${SHARED_AUDIO_PIPELINE_DIR}
 )
 
 #**********************
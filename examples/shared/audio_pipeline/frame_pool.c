@@ -0,0 +1,67 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <xcore/assert.h>
+
+#include "frame_pool.h"
+
+/* Orders the ring accesses against the index updates that publish them */
+#define COMPILER_BARRIER()  __asm__ volatile("" ::: "memory")
+
+void frame_pool_init(frame_pool_t *pool,
+                     void *frames,
+                     size_t frame_size,
+                     unsigned count,
+                     void **ring)
+{
+    xassert(count > 0 && (count & (count - 1)) == 0);
+
+    pool->ring = ring;
+    pool->mask = count - 1;
+    pool->count = count;
+    pool->peak_in_use = 0;
+    pool->empty_count = 0;
+
+    for (unsigned i = 0; i < count; i++) {
+        ring[i] = (uint8_t *) frames + i * frame_size;
+    }
+    pool->tail = 0;
+    pool->head = count;
+}
+
+void *frame_pool_get(frame_pool_t *pool)
+{
+    uint32_t tail = pool->tail;
+    unsigned in_use;
+    void *frame;
+
+    if (pool->head == tail) {
+        pool->empty_count++;
+        return NULL;
+    }
+
+    frame = pool->ring[tail & pool->mask];
+    COMPILER_BARRIER();
+    pool->tail = tail + 1;
+
+    in_use = frame_pool_in_use(pool);
+    if (in_use > pool->peak_in_use) {
+        pool->peak_in_use = in_use;
+    }
+
+    return frame;
+}
+
+void frame_pool_put(frame_pool_t *pool, void *frame)
+{
+    uint32_t head = pool->head;
+
+    pool->ring[head & pool->mask] = frame;
+    COMPILER_BARRIER();
+    pool->head = head + 1;
+}
+
+unsigned frame_pool_in_use(const frame_pool_t *pool)
+{
+    return pool->count - (pool->head - pool->tail);
+}
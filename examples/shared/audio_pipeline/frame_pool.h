@@ -0,0 +1,51 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef FRAME_POOL_H_
+#define FRAME_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A fixed number of fixed size frames for a generic_pipeline, in place of a
+ * heap allocation per frame. The pipeline input takes a frame with
+ * frame_pool_get(), the frame is passed from stage to stage, and the pipeline
+ * output returns it with frame_pool_put() and tells the pipeline not to free
+ * it.
+ *
+ * The free frames are kept in a ring. It is lock free provided that only one
+ * task calls frame_pool_get() and only one task calls frame_pool_put(), which
+ * is the case for the input and output of a pipeline. Frames are not zeroed.
+ */
+typedef struct {
+    void **ring;                /* count entries */
+    uint32_t mask;
+    unsigned count;
+    volatile uint32_t head;     /* Only written by frame_pool_put() */
+    volatile uint32_t tail;     /* Only written by frame_pool_get() */
+
+    /* Statistics, only written by frame_pool_get() */
+    unsigned peak_in_use;
+    unsigned empty_count;
+} frame_pool_t;
+
+/* Initialises a pool of count frames of frame_size bytes each, stored
+ * contiguously at frames. count must be a power of two, and ring must have
+ * room for count entries. */
+void frame_pool_init(frame_pool_t *pool,
+                     void *frames,
+                     size_t frame_size,
+                     unsigned count,
+                     void **ring);
+
+/* Returns a free frame, or NULL if every frame is in use */
+void *frame_pool_get(frame_pool_t *pool);
+
+/* Returns a frame, taken with frame_pool_get(), to the pool */
+void frame_pool_put(frame_pool_t *pool, void *frame);
+
+/* The number of frames currently taken from the pool */
+unsigned frame_pool_in_use(const frame_pool_t *pool);
+
+#endif /* FRAME_POOL_H_ */
@@ -0,0 +1,263 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xmath/xmath.h"
+
+#include "gain_ramp.h"
+
+/* 10^(dB/20) for each whole dB from GAIN_RAMP_DB_MIN to GAIN_RAMP_DB_MAX,
+ * with the mantissas normalised */
+static const float_s32_t db_to_linear[GAIN_RAMP_DB_MAX - GAIN_RAMP_DB_MIN + 1] = {
+    {1099511628, -40}, /* -60 dB */
+    {1233672337, -40}, /* -59 dB */
+    {1384203129, -40}, /* -58 dB */
+    {1553101455, -40}, /* -57 dB */
+    {1742608494, -40}, /* -56 dB */
+    {1955238889, -40}, /* -55 dB */
+    {1096907058, -39}, /* -54 dB */
+    {1230749962, -39}, /* -53 dB */
+    {1380924170, -39}, /* -52 dB */
+    {1549422402, -39}, /* -51 dB */
+    {1738480529, -39}, /* -50 dB */
+    {1950607236, -39}, /* -49 dB */
+    {1094308658, -38}, /* -48 dB */
+    {1227834509, -38}, /* -47 dB */
+    {1377652978, -38}, /* -46 dB */
+    {1545752065, -38}, /* -45 dB */
+    {1734362342, -38}, /* -44 dB */
+    {1945986554, -38}, /* -43 dB */
+    {1091716413, -37}, /* -42 dB */
+    {1224925962, -37}, /* -41 dB */
+    {1374389535, -37}, /* -40 dB */
+    {1542090421, -37}, /* -39 dB */
+    {1730253911, -37}, /* -38 dB */
+    {1941376819, -37}, /* -37 dB */
+    {1089130309, -36}, /* -36 dB */
+    {1222024305, -36}, /* -35 dB */
+    {1371133822, -36}, /* -34 dB */
+    {1538437452, -36}, /* -33 dB */
+    {1726155212, -36}, /* -32 dB */
+    {1936778003, -36}, /* -31 dB */
+    {1086550331, -35}, /* -30 dB */
+    {1219129522, -35}, /* -29 dB */
+    {1367885822, -35}, /* -28 dB */
+    {1534793136, -35}, /* -27 dB */
+    {1722066222, -35}, /* -26 dB */
+    {1932190081, -35}, /* -25 dB */
+    {1083976464, -34}, /* -24 dB */
+    {1216241597, -34}, /* -23 dB */
+    {1364645516, -34}, /* -22 dB */
+    {1531157453, -34}, /* -21 dB */
+    {1717986918, -34}, /* -20 dB */
+    {1927613027, -34}, /* -19 dB */
+    {1081408694, -33}, /* -18 dB */
+    {1213360512, -33}, /* -17 dB */
+    {1361412886, -33}, /* -16 dB */
+    {1527530382, -33}, /* -15 dB */
+    {1713917278, -33}, /* -14 dB */
+    {1923046815, -33}, /* -13 dB */
+    {1078847007, -32}, /* -12 dB */
+    {1210486252, -32}, /* -11 dB */
+    {1358187913, -32}, /* -10 dB */
+    {1523911903, -32}, /* -9 dB */
+    {1709857278, -32}, /* -8 dB */
+    {1918491420, -32}, /* -7 dB */
+    {1076291389, -31}, /* -6 dB */
+    {1207618800, -31}, /* -5 dB */
+    {1354970580, -31}, /* -4 dB */
+    {1520301996, -31}, /* -3 dB */
+    {1705806895, -31}, /* -2 dB */
+    {1913946816, -31}, /* -1 dB */
+    {1073741824, -30}, /* +0 dB */
+    {1204758142, -30}, /* +1 dB */
+    {1351760868, -30}, /* +2 dB */
+    {1516700640, -30}, /* +3 dB */
+    {1701766107, -30}, /* +4 dB */
+    {1909412977, -30}, /* +5 dB */
+    {2142396597, -30}, /* +6 dB */
+    {1201904259, -29}, /* +7 dB */
+    {1348558759, -29}, /* +8 dB */
+    {1513107815, -29}, /* +9 dB */
+    {1697734891, -29}, /* +10 dB */
+    {1904889879, -29}, /* +11 dB */
+    {2137321597, -29}, /* +12 dB */
+    {1199057137, -28}, /* +13 dB */
+    {1345364236, -28}, /* +14 dB */
+    {1509523501, -28}, /* +15 dB */
+    {1693713225, -28}, /* +16 dB */
+    {1900377495, -28}, /* +17 dB */
+    {2132258619, -28}, /* +18 dB */
+    {1196216760, -27}, /* +19 dB */
+    {1342177280, -27}, /* +20 dB */
+    {1505947677, -27}, /* +21 dB */
+    {1689701085, -27}, /* +22 dB */
+    {1895875800, -27}, /* +23 dB */
+    {2127207634, -27}, /* +24 dB */
+    {1193383111, -26}, /* +25 dB */
+    {1338997873, -26}, /* +26 dB */
+    {1502380324, -26}, /* +27 dB */
+    {1685698449, -26}, /* +28 dB */
+    {1891384768, -26}, /* +29 dB */
+    {2122168614, -26}, /* +30 dB */
+    {1190556174, -25}, /* +31 dB */
+    {1335825998, -25}, /* +32 dB */
+    {1498821422, -25}, /* +33 dB */
+    {1681705295, -25}, /* +34 dB */
+    {1886904376, -25}, /* +35 dB */
+    {2117141531, -25}, /* +36 dB */
+    {1187735934, -24}, /* +37 dB */
+    {1332661637, -24}, /* +38 dB */
+    {1495270950, -24}, /* +39 dB */
+    {1677721600, -24}, /* +40 dB */
+    {1882434596, -24}, /* +41 dB */
+    {2112126356, -24}, /* +42 dB */
+    {1184922375, -23}, /* +43 dB */
+    {1329504771, -23}, /* +44 dB */
+    {1491728889, -23}, /* +45 dB */
+    {1673747342, -23}, /* +46 dB */
+    {1877975405, -23}, /* +47 dB */
+    {2107123061, -23}, /* +48 dB */
+    {1182115480, -22}, /* +49 dB */
+    {1326355384, -22}, /* +50 dB */
+    {1488195218, -22}, /* +51 dB */
+    {1669782498, -22}, /* +52 dB */
+    {1873526777, -22}, /* +53 dB */
+    {2102131619, -22}, /* +54 dB */
+    {1179315235, -21}, /* +55 dB */
+    {1323213457, -21}, /* +56 dB */
+    {1484669918, -21}, /* +57 dB */
+    {1665827046, -21}, /* +58 dB */
+    {1869088687, -21}, /* +59 dB */
+    {2097152000, -21}, /* +60 dB */
+};
+
+/* Shifts a positive gain so that its mantissa has a single bit of headroom,
+ * which leaves room to interpolate between two gains without overflow */
+static float_s32_t gain_normalise(float_s32_t gain)
+{
+    int shift = __builtin_clz((uint32_t) gain.mant) - 2;
+
+    if (shift > 0) {
+        gain.mant <<= shift;
+    } else {
+        gain.mant >>= -shift;
+    }
+    gain.exp -= shift;
+
+    return gain;
+}
+
+static int32_t gain_at_exp(float_s32_t gain, exponent_t exp)
+{
+    /* Only ever shifted right, as exp is the larger exponent */
+    return gain.mant >> (exp - gain.exp);
+}
+
+float_s32_t gain_ramp_db_to_linear(int gain_db)
+{
+    if (gain_db < GAIN_RAMP_DB_MIN) {
+        gain_db = GAIN_RAMP_DB_MIN;
+    } else if (gain_db > GAIN_RAMP_DB_MAX) {
+        gain_db = GAIN_RAMP_DB_MAX;
+    }
+
+    return db_to_linear[gain_db - GAIN_RAMP_DB_MIN];
+}
+
+void gain_ramp_init(gain_ramp_t *ramp,
+                    int32_t *frame_gains,
+                    unsigned frame_length,
+                    unsigned ramp_samples,
+                    int gain_db)
+{
+    float_s32_t gain = gain_normalise(gain_ramp_db_to_linear(gain_db));
+
+    ramp->gain_db = gain_db;
+    ramp->target = gain;
+    ramp->gain = gain.mant;
+    ramp->step = 0;
+    ramp->exp = gain.exp;
+    ramp->remaining = 0;
+    ramp->ramp_samples = ramp_samples > 0 ? ramp_samples : 1;
+    ramp->frame_gains = frame_gains;
+    ramp->frame_length = frame_length;
+}
+
+void gain_ramp_set_db(gain_ramp_t *ramp, int gain_db)
+{
+    if (gain_db == ramp->gain_db) {
+        return;
+    }
+
+    /* Ramp from wherever the gain is now, which may be part way through a
+     * previous ramp */
+    float_s32_t start = gain_normalise((float_s32_t) {ramp->gain, ramp->exp});
+    float_s32_t target = gain_normalise(gain_ramp_db_to_linear(gain_db));
+    exponent_t exp = start.exp > target.exp ? start.exp : target.exp;
+
+    ramp->gain_db = gain_db;
+    ramp->target = target;
+    ramp->exp = exp;
+    ramp->gain = gain_at_exp(start, exp);
+    ramp->step = (gain_at_exp(target, exp) - ramp->gain) / (int32_t) ramp->ramp_samples;
+    ramp->remaining = ramp->ramp_samples;
+}
+
+const int32_t *gain_ramp_next(gain_ramp_t *ramp, float_s32_t *gain)
+{
+    if (ramp->remaining == 0) {
+        *gain = ramp->target;
+        return NULL;
+    }
+
+    int32_t g = ramp->gain;
+    int32_t step = ramp->step;
+    exponent_t exp = ramp->exp;
+    unsigned n = ramp->remaining < ramp->frame_length ? ramp->remaining : ramp->frame_length;
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        g += step;
+        ramp->frame_gains[i] = g;
+    }
+    ramp->remaining -= n;
+
+    if (ramp->remaining == 0) {
+        /* Finish on the exact target, whatever the rounding of the step */
+        g = gain_at_exp(ramp->target, exp);
+        ramp->frame_gains[n - 1] = g;
+        ramp->gain = ramp->target.mant;
+        ramp->exp = ramp->target.exp;
+    } else {
+        ramp->gain = g;
+    }
+    for (; i < ramp->frame_length; i++) {
+        ramp->frame_gains[i] = g;
+    }
+
+    gain->mant = g;
+    gain->exp = exp;
+    return ramp->frame_gains;
+}
+
+void gain_ramp_apply(gain_ramp_t *ramp, bfp_s32_t *channels, unsigned channel_count)
+{
+    float_s32_t gain;
+    const int32_t *frame_gains = gain_ramp_next(ramp, &gain);
+
+    if (frame_gains == NULL) {
+        for (unsigned ch = 0; ch < channel_count; ch++) {
+            bfp_s32_scale(&channels[ch], &channels[ch], gain);
+        }
+        return;
+    }
+
+    bfp_s32_t gains;
+    bfp_s32_init(&gains, (int32_t *) frame_gains, gain.exp, ramp->frame_length, 1);
+    for (unsigned ch = 0; ch < channel_count; ch++) {
+        bfp_s32_mul(&channels[ch], &channels[ch], &gains);
+    }
+}
@@ -0,0 +1,66 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef GAIN_RAMP_H_
+#define GAIN_RAMP_H_
+
+#include <stdint.h>
+
+#include "xmath/xmath.h"
+
+/* The range of the dB to linear gain table. Gains outside it are clamped. */
+#define GAIN_RAMP_DB_MIN    -60
+#define GAIN_RAMP_DB_MAX     60
+
+/*
+ * A gain, set in whole dB, that moves to each new setting with a linear ramp
+ * over a fixed number of samples rather than in a single step between
+ * frames, which would be heard as a click or zipper noise.
+ *
+ * The linear gain for each setting is taken from a table, and the ramp is
+ * only recalculated when the setting changes. While a ramp is in progress
+ * the gain is applied a sample at a time, and once it is complete the frames
+ * are scaled by the constant gain.
+ */
+typedef struct {
+    int gain_db;
+    float_s32_t target;
+
+    /* The ramp, as mantissas at exponent exp */
+    int32_t gain;
+    int32_t step;
+    exponent_t exp;
+    unsigned remaining;
+    unsigned ramp_samples;
+
+    /* The gain for each sample of the current frame, while ramping */
+    int32_t *frame_gains;
+    unsigned frame_length;
+} gain_ramp_t;
+
+/* Returns the linear gain for a gain in dB */
+float_s32_t gain_ramp_db_to_linear(int gain_db);
+
+/* Initialises a gain at gain_db, with no ramp. frame_gains must have room for
+ * frame_length words. */
+void gain_ramp_init(gain_ramp_t *ramp,
+                    int32_t *frame_gains,
+                    unsigned frame_length,
+                    unsigned ramp_samples,
+                    int gain_db);
+
+/* Sets the gain, starting a ramp to it from the current gain if it has
+ * changed. Called once per frame with the latest setting. */
+void gain_ramp_set_db(gain_ramp_t *ramp, int gain_db);
+
+/* Returns the gain for each sample of the next frame, as mantissas at
+ * exponent gain->exp, while a ramp is in progress. Otherwise returns NULL,
+ * and the constant gain in gain. */
+const int32_t *gain_ramp_next(gain_ramp_t *ramp, float_s32_t *gain);
+
+/* Applies the gain to the next frame of each of the channels, which are
+ * frame_length long, leaving each channel with the exponent chosen by
+ * bfp_s32_scale() or bfp_s32_mul(). */
+void gain_ramp_apply(gain_ramp_t *ramp, bfp_s32_t *channels, unsigned channel_count);
+
+#endif /* GAIN_RAMP_H_ */